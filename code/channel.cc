@@ -0,0 +1,50 @@
+#include "channel.h"
+
+namespace CXS {
+
+int Select(const std::vector<ChannelBase *> &channels, uint64_t timeout_ms) {
+    uint64_t deadline = timeout_ms == ~0ull ? ~0ull : GetCurrentMS() + timeout_ms;
+    while (true) {
+        for (size_t i = 0; i < channels.size(); ++i) {
+            if (channels[i]->readable()) {
+                return i;
+            }
+        }
+        uint64_t left = ~0ull;
+        if (deadline != ~0ull) {
+            uint64_t now = GetCurrentMS();
+            if (now >= deadline) {
+                return -1;
+            }
+            left = deadline - now;
+        }
+        // 同一个等待者登记到所有通道，任意一个通道的发送或关闭都能唤醒它，且只唤醒一次
+        FiberWaiter::ptr waiter = FiberWaiter::Create();
+        size_t added = 0;
+        int ready = -1;
+        for (; added < channels.size(); ++added) {
+            // 扫描后、登记前有通道变为可读
+            if (!channels[added]->addRecvWaiter(waiter)) {
+                ready = added;
+                break;
+            }
+        }
+        if (ready == -1) {
+            waiter->park(left);
+        } else {
+            // 前面登记过的通道可能已取出本等待者并将要唤醒它，这次唤醒必须消费掉，否则会在之后误调度本协程
+            int expected = FiberWaiter::WAITING;
+            if (!waiter->state.compare_exchange_strong(expected, FiberWaiter::WOKEN)) {
+                waiter->park();
+            }
+        }
+        for (size_t i = 0; i < added; ++i) {
+            channels[i]->removeRecvWaiter(waiter);
+        }
+        if (ready != -1) {
+            return ready;
+        }
+    }
+}
+
+} // namespace CXS
@@ -0,0 +1,286 @@
+#ifndef __CXS_CHANNEL_H__
+#define __CXS_CHANNEL_H__
+
+#include <deque>
+#include <list>
+#include <memory>
+#include <stddef.h>
+#include <stdint.h>
+#include <utility>
+#include <vector>
+
+#include "fiber_sync.h"
+#include "macro.h"
+#include "noncopyable.h"
+#include "thread.h"
+#include "util.h"
+
+namespace CXS {
+
+// 通道的类型无关部分，供Select同时等待多个不同元素类型的通道
+class ChannelBase : public Noncopyable {
+public:
+    virtual ~ChannelBase() {}
+
+    // 有数据或已关闭时可读(recv不会挂起)
+    virtual bool readable() = 0;
+
+protected:
+    friend int Select(const std::vector<ChannelBase *> &channels, uint64_t timeout_ms);
+
+    // 已可读时不登记，返回false
+    virtual bool addRecvWaiter(FiberWaiter::ptr waiter) = 0;
+    // Select返回后移除，本等待者可能占用了一次唤醒而没有取走该通道的数据，此时转交给下一个接收者
+    virtual void removeRecvWaiter(FiberWaiter::ptr waiter) = 0;
+};
+
+// 等待多个通道中任意一个可读，返回其下标，超时返回-1
+// 返回后数据可能被其他接收者抢先取走，调用方用tryRecv取数据，失败时重新Select
+int Select(const std::vector<ChannelBase *> &channels, uint64_t timeout_ms = ~0ull);
+
+// 有界多生产者多消费者通道，元素只需可移动
+// 通道满时发送方、通道空时接收方挂起所在协程(不在调度器中时阻塞线程)，不占用工作线程
+// 关闭后发送失败，接收方取完剩余数据后失败
+template <class T>
+class Channel : public ChannelBase {
+public:
+    typedef std::shared_ptr<Channel> ptr;
+
+    Channel(size_t capacity) :
+        m_capacity(capacity) {
+        CXS_ASSERT(capacity > 0);
+    }
+
+    // 通道满时挂起，已关闭返回false，此时v不变
+    bool send(T &&v) {
+        Spinlock::Lock lock(m_lock);
+        while (!m_closed && m_items.size() >= m_capacity) {
+            FiberWaiter::ptr waiter = FiberWaiter::Create();
+            m_sendWaiters.push_back(waiter);
+            lock.unlock();
+            waiter->park();
+            lock.lock();
+        }
+        if (m_closed) {
+            return false;
+        }
+        m_items.push_back(std::move(v));
+        FiberWaiter::ptr waiter = FiberWaiter::Pop(m_recvWaiters);
+        lock.unlock();
+        if (waiter) {
+            waiter->wake();
+        }
+        return true;
+    }
+    bool send(const T &v) {
+        T tmp(v);
+        return send(std::move(tmp));
+    }
+
+    // 通道满或已关闭返回false，此时v不变
+    bool trySend(T &&v) {
+        Spinlock::Lock lock(m_lock);
+        if (m_closed || m_items.size() >= m_capacity) {
+            return false;
+        }
+        m_items.push_back(std::move(v));
+        FiberWaiter::ptr waiter = FiberWaiter::Pop(m_recvWaiters);
+        lock.unlock();
+        if (waiter) {
+            waiter->wake();
+        }
+        return true;
+    }
+
+    // 批量发送，有空间就尽量多放，一次加锁放入多个并唤醒同样多的接收者
+    // 返回发送的个数，发送的元素从items头部移除；只在通道关闭时少于items.size()
+    size_t send(std::vector<T> &items) {
+        size_t sent = 0;
+        std::vector<FiberWaiter::ptr> waiters;
+        Spinlock::Lock lock(m_lock);
+        while (sent < items.size()) {
+            while (!m_closed && m_items.size() >= m_capacity) {
+                FiberWaiter::ptr waiter = FiberWaiter::Create();
+                m_sendWaiters.push_back(waiter);
+                lock.unlock();
+                wakeAll(waiters);
+                waiter->park();
+                lock.lock();
+            }
+            if (m_closed) {
+                break;
+            }
+            while (sent < items.size() && m_items.size() < m_capacity) {
+                m_items.push_back(std::move(items[sent++]));
+                FiberWaiter::ptr waiter = FiberWaiter::Pop(m_recvWaiters);
+                if (waiter) {
+                    waiters.push_back(waiter);
+                }
+            }
+        }
+        lock.unlock();
+        wakeAll(waiters);
+        items.erase(items.begin(), items.begin() + sent);
+        return sent;
+    }
+
+    // 通道空时挂起，超时或已关闭且取完返回false
+    // 带超时的接收需要在IOManager中调用
+    bool recv(T &v, uint64_t timeout_ms = ~0ull) {
+        Spinlock::Lock lock(m_lock);
+        if (!waitItems(lock, timeout_ms)) {
+            return false;
+        }
+        v = std::move(m_items.front());
+        m_items.pop_front();
+        FiberWaiter::ptr waiter = FiberWaiter::Pop(m_sendWaiters);
+        lock.unlock();
+        if (waiter) {
+            waiter->wake();
+        }
+        return true;
+    }
+
+    bool tryRecv(T &v) {
+        Spinlock::Lock lock(m_lock);
+        if (m_items.empty()) {
+            return false;
+        }
+        v = std::move(m_items.front());
+        m_items.pop_front();
+        FiberWaiter::ptr waiter = FiberWaiter::Pop(m_sendWaiters);
+        lock.unlock();
+        if (waiter) {
+            waiter->wake();
+        }
+        return true;
+    }
+
+    // 批量接收，至少有一个元素时取走最多max个追加到out，一次加锁并唤醒同样多的发送者
+    // 返回接收的个数，超时或已关闭且取完返回0
+    size_t recv(std::vector<T> &out, size_t max, uint64_t timeout_ms = ~0ull) {
+        std::vector<FiberWaiter::ptr> waiters;
+        Spinlock::Lock lock(m_lock);
+        if (max == 0 || !waitItems(lock, timeout_ms)) {
+            return 0;
+        }
+        size_t count = 0;
+        while (count < max && !m_items.empty()) {
+            out.push_back(std::move(m_items.front()));
+            m_items.pop_front();
+            ++count;
+            FiberWaiter::ptr waiter = FiberWaiter::Pop(m_sendWaiters);
+            if (waiter) {
+                waiters.push_back(waiter);
+            }
+        }
+        lock.unlock();
+        wakeAll(waiters);
+        return count;
+    }
+
+    // 唤醒所有等待者，之后send失败，recv取完剩余数据后失败
+    void close() {
+        std::vector<FiberWaiter::ptr> waiters;
+        {
+            Spinlock::Lock lock(m_lock);
+            if (m_closed) {
+                return;
+            }
+            m_closed = true;
+            while (FiberWaiter::ptr waiter = FiberWaiter::Pop(m_sendWaiters)) {
+                waiters.push_back(waiter);
+            }
+            while (FiberWaiter::ptr waiter = FiberWaiter::Pop(m_recvWaiters)) {
+                waiters.push_back(waiter);
+            }
+        }
+        wakeAll(waiters);
+    }
+
+    bool isClosed() {
+        Spinlock::Lock lock(m_lock);
+        return m_closed;
+    }
+    size_t size() {
+        Spinlock::Lock lock(m_lock);
+        return m_items.size();
+    }
+    size_t getCapacity() const { return m_capacity; }
+
+    bool readable() override {
+        Spinlock::Lock lock(m_lock);
+        return !m_items.empty() || m_closed;
+    }
+
+protected:
+    bool addRecvWaiter(FiberWaiter::ptr waiter) override {
+        Spinlock::Lock lock(m_lock);
+        if (!m_items.empty() || m_closed) {
+            return false;
+        }
+        m_recvWaiters.push_back(waiter);
+        return true;
+    }
+
+    void removeRecvWaiter(FiberWaiter::ptr waiter) override {
+        FiberWaiter::ptr next;
+        {
+            Spinlock::Lock lock(m_lock);
+            m_recvWaiters.remove(waiter);
+            if (!m_items.empty()) {
+                next = FiberWaiter::Pop(m_recvWaiters);
+            }
+        }
+        if (next) {
+            next->wake();
+        }
+    }
+
+private:
+    // 持有lock时调用，等到有数据返回true，超时或已关闭且为空返回false
+    bool waitItems(Spinlock::Lock &lock, uint64_t timeout_ms) {
+        uint64_t deadline = timeout_ms == ~0ull ? ~0ull : GetCurrentMS() + timeout_ms;
+        while (m_items.empty()) {
+            if (m_closed) {
+                return false;
+            }
+            uint64_t left = ~0ull;
+            if (deadline != ~0ull) {
+                uint64_t now = GetCurrentMS();
+                if (now >= deadline) {
+                    return false;
+                }
+                left = deadline - now;
+            }
+            FiberWaiter::ptr waiter = FiberWaiter::Create();
+            m_recvWaiters.push_back(waiter);
+            lock.unlock();
+            bool woken = waiter->park(left);
+            lock.lock();
+            if (!woken) {
+                m_recvWaiters.remove(waiter);
+            }
+        }
+        return true;
+    }
+
+    static void wakeAll(std::vector<FiberWaiter::ptr> &waiters) {
+        for (auto &i : waiters) {
+            i->wake();
+        }
+        waiters.clear();
+    }
+
+private:
+    size_t m_capacity;
+    bool m_closed = false;
+    Spinlock m_lock;
+    std::deque<T> m_items;
+    std::list<FiberWaiter::ptr> m_sendWaiters;
+    std::list<FiberWaiter::ptr> m_recvWaiters;
+};
+
+} // namespace CXS
+
+#endif
@@ -2,7 +2,11 @@
 #include "hook.h"
 #include "thread.h"
 #include <asm-generic/socket.h>
+#include <atomic>
 namespace CXS {
+
+static std::atomic<uint64_t> s_fd_generation = {0};
+
 FdCtx::FdCtx(int fd) :
     m_isInit(false),
     m_isSocket(false),
@@ -11,9 +15,28 @@ FdCtx::FdCtx(int fd) :
     m_userNonblock(false),
     m_recvTimeout(-1),
     m_sendTimeout(-1),
-    m_fd(fd) {
+    m_fd(fd),
+    m_generation(++s_fd_generation) {
     init();
 }
+FdCtx::FdCtx(int fd, bool nonblock_socket) :
+    m_isInit(false),
+    m_isSocket(false),
+    m_sysNonbool(false),
+    m_isClose(false),
+    m_userNonblock(false),
+    m_recvTimeout(-1),
+    m_sendTimeout(-1),
+    m_fd(fd),
+    m_generation(++s_fd_generation) {
+    if (!nonblock_socket) {
+        init();
+        return;
+    }
+    m_isInit = true;
+    m_isSocket = true;
+    m_sysNonbool = true;
+}
 FdCtx::~FdCtx() {
 }
 bool FdCtx::init() {
@@ -102,6 +125,16 @@ FdCtx::ptr FdManager::get(int fd, bool auto_create) {
     return ctx;
 }
 
+FdCtx::ptr FdManager::addNonblockSocket(int fd) {
+    FdCtx::ptr ctx(new FdCtx(fd, true));
+    RWMutexType::WriteLock lock(m_mutex);
+    if (fd >= (int)m_datas.size()) {
+        m_datas.resize(fd * 1.5);
+    }
+    m_datas[fd] = ctx;
+    return ctx;
+}
+
 void FdManager::del(int fd) {
     RWMutexType::WriteLock lock(m_mutex);
     if ((int)m_datas.size() <= fd) {
@@ -109,4 +142,12 @@ void FdManager::del(int fd) {
     }
     m_datas[fd].reset();
 }
+
+uint64_t FdManager::getGeneration(int fd) {
+    RWMutexType::ReadLock lock(m_mutex);
+    if ((int)m_datas.size() <= fd || !m_datas[fd]) {
+        return 0;
+    }
+    return m_datas[fd]->getGeneration();
+}
 } // namespace CXS
\ No newline at end of file
@@ -12,6 +12,8 @@ class FdCtx : public std::enable_shared_from_this<FdCtx> {
 public:
     typedef std::shared_ptr<FdCtx> ptr;
     FdCtx(int fd);
+    // 已知是非阻塞socket(accept4带SOCK_NONBLOCK返回的)，不再fstat和fcntl
+    FdCtx(int fd, bool nonblock_socket);
     ~FdCtx();
     bool init();
     bool isInit() const {
@@ -42,6 +44,10 @@ public:
     bool isClose() const {
         return m_isClose;
     }
+    // 每个FdCtx唯一的代数(从1开始)，fd关闭后句柄号复用时新的FdCtx代数不同
+    uint64_t getGeneration() const {
+        return m_generation;
+    }
 
 private:
     //是否初始化
@@ -59,6 +65,7 @@ private:
     uint64_t m_sendTimeout;
     // 文件句柄
     int m_fd;
+    uint64_t m_generation;
 };
 
 class FdManager {
@@ -67,7 +74,11 @@ public:
     FdManager();
 
     FdCtx::ptr get(int fd, bool auto_create = false);
+    // 登记一个非阻塞socket，accept4返回的fd使用，省掉fstat和fcntl
+    FdCtx::ptr addNonblockSocket(int fd);
     void del(int ft);
+    // fd当前FdCtx的代数，没有登记时返回0
+    uint64_t getGeneration(int fd);
 
 private:
     RWMutexType m_mutex;
@@ -1,5 +1,6 @@
 #include "fiber.hpp"
 #include "scheduler.hpp"
+#include "stack_allocator.h"
 namespace CXS {
 // 全局协程id计数器
 static std::atomic<uint64_t> s_fiber_id(0);
@@ -17,34 +18,27 @@ static thread_local Fiber *t_fiber = nullptr;
 同时激活子协程的ucontext_t的上下文。
 子协程yield时，子协程让出执行权，从t_threadFiber获得主协程上下文恢复运行。*/
 static thread_local Fiber::ptr t_threadFiber = nullptr;
+// 本线程是否正在调度循环的栈上直接执行回调
+static thread_local bool t_runInline = false;
 // 约定协程栈的大小1MB
 static ConfigVar<uint32_t>::ptr g_fiber_stack_size =
     Config::Lookup<uint32_t>("fiber.stack_size", 1024 * 1024, "fiber stack size");
-class MallocStackAllocator {
-public:
-    static void *Alloc(size_t size) {
-        return malloc(size);
-    }
-    static void Dealloc(void *vp, size_t size) {
-        return free(vp);
-    }
-};
-
-using StackAllocator = MallocStackAllocator;
 
 // 协程构造函数
 // 初始化协程状态为 EXEC（执行中）
 // 设置当前线程的当前协程为 this
-// 使用 getcontext 初始化 m_ctx
+// ucontext实现下使用 getcontext 初始化 m_ctx，汇编实现下首次切出时才保存
 // 增加活跃协程计数
 Fiber::Fiber() {
     m_state = EXEC;
     // 设置当前协程
     SetThis(this);
+#ifndef CXS_FIBER_ASM_CONTEXT
     // 获取当前协程的上下文信息保存到m_ctx中
     if (getcontext(&m_ctx)) {
         CXS_ASSERT2(false, "getcontext");
     }
+#endif
     ++s_fiber_count;
 
     CXS_LOG_DEBUG(g_logger) << "Fiber::Fiber";
@@ -57,20 +51,11 @@ Fiber::Fiber(std::function<void()> cb, size_t stacksize, bool use_caller) :
     m_stacksize = stacksize ? stacksize : g_fiber_stack_size->getValue();
     // 获得协程运行指针
     m_stack = StackAllocator::Alloc(m_stacksize);
-    // 保存当前协程上下文信息到m_ctx中
-    if (getcontext(&m_ctx)) {
-        CXS_ASSERT2(false, "getcontext");
-    }
-
-    // uc_link为空，执行完当前context之后退出程序。
-    m_ctx.uc_link = nullptr;
-    m_ctx.uc_stack.ss_sp = m_stack;
-    m_ctx.uc_stack.ss_size = m_stacksize;
     // 指明该context入口函数
     if (!use_caller) {
-        makecontext(&m_ctx, &Fiber::MainFunc, 0);
+        makeContext(&Fiber::MainFunc);
     } else {
-        makecontext(&m_ctx, &Fiber::CallerMainFunc, 0);
+        makeContext(&Fiber::CallerMainFunc);
     }
     CXS_LOG_DEBUG(g_logger) << "Fiber::Fiber(p)   id: " << m_id;
 }
@@ -106,16 +91,34 @@ void Fiber::reset(std::function<void()> cb) {
     // 当前协程不在准备和运行态
     CXS_ASSERT(m_state == TERM || m_state == INIT || m_state == EXECEP);
     m_cb = cb;
+    makeContext(&Fiber::MainFunc);
+    m_state = INIT;
+}
+
+void Fiber::makeContext(void (*func)()) {
+#ifdef CXS_FIBER_ASM_CONTEXT
+    m_ctx = MakeFiberContext(m_stack, m_stacksize, func);
+#else
+    // 保存当前协程上下文信息到m_ctx中
     if (getcontext(&m_ctx)) {
         CXS_ASSERT2(false, "getcontext");
     }
-
+    // uc_link为空，执行完当前context之后退出程序。
     m_ctx.uc_link = nullptr;
     m_ctx.uc_stack.ss_sp = m_stack;
     m_ctx.uc_stack.ss_size = m_stacksize;
+    makecontext(&m_ctx, func, 0);
+#endif
+}
 
-    makecontext(&m_ctx, &Fiber::MainFunc, 0);
-    m_state = INIT;
+void Fiber::SwapContext(Fiber *from, Fiber *to) {
+#ifdef CXS_FIBER_ASM_CONTEXT
+    cxs_swap_context(&from->m_ctx, to->m_ctx);
+#else
+    if (swapcontext(&from->m_ctx, &to->m_ctx)) {
+        CXS_ASSERT2(false, "swapcontext");
+    }
+#endif
 }
 
 
@@ -124,37 +127,27 @@ void Fiber::swapIn() {
     SetThis(this);
     CXS_ASSERT(m_state != EXEC);
     m_state = EXEC;
-    if (swapcontext(&Scheduler::GetMainFiber()->m_ctx, &m_ctx)) {
-        CXS_ASSERT2(false, "swapIn_context");
-    }
+    SwapContext(Scheduler::GetMainFiber(), this);
 }
 
 // 从协程主协程切换到当前协程
 void Fiber::call() {
     SetThis(this);
     m_state = EXEC;
-    if (swapcontext(&t_threadFiber->m_ctx, &m_ctx)) {
-        CXS_ASSERT2(false, "swapcontext");
-    }
+    SwapContext(t_threadFiber.get(), this);
 }
 
 // 从当前协程切换到主协程
 void Fiber::back() {
     SetThis(t_threadFiber.get());
-    if (swapcontext(&m_ctx, &t_threadFiber->m_ctx)) {
-        CXS_ASSERT2(false, "swapcontext");
-    }
+    SwapContext(this, t_threadFiber.get());
 }
 
 // 从当前协程切换到调度器主协程
 void Fiber::swapOut() {
 
     SetThis(Scheduler::GetMainFiber());
-    if (swapcontext(&m_ctx, &Scheduler::GetMainFiber()->m_ctx)) {
-        perror("swapcontext failed");
-        printf("Error: %s\n", strerror(errno));
-        CXS_ASSERT2(false, "swapcontext");
-    }
+    SwapContext(this, Scheduler::GetMainFiber());
 }
 
 void Fiber::SetThis(Fiber *f) {
@@ -173,20 +166,31 @@ Fiber::ptr Fiber::GetThis() {
 }
 
 void Fiber::YieldToReady() {
+    CXS_ASSERT2(!t_runInline, "yield from a run-inline callback");
     Fiber::ptr cur = GetThis();
     cur->m_state = READY;
     cur->swapOut();
 }
 
 void Fiber::YieldToHold() {
+    CXS_ASSERT2(!t_runInline, "yield from a run-inline callback");
     Fiber::ptr cur = GetThis();
-    cur->m_state = HOLD;
+    // 状态保持EXEC，等上下文保存完、切回调度协程后再由调度器置为HOLD
+    // 否则事件在其他线程上提前触发时，会在本协程切出完成之前把它拉起
     cur->swapOut();
 }
 
 uint64_t Fiber::TotalFibers() {
     return s_fiber_count;
 }
+
+void Fiber::SetRunInline(bool v) {
+    t_runInline = v;
+}
+
+bool Fiber::IsRunInline() {
+    return t_runInline;
+}
 void Fiber::MainFunc() {
     Fiber::ptr cur = GetThis();
     CXS_ASSERT(cur);
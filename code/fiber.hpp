@@ -3,7 +3,7 @@
 
 #include <functional>
 #include <memory>
-#include <ucontext.h>
+#include "fiber_context.h"
 #include "thread.h"
 #include "log.h"
 
@@ -70,12 +70,21 @@ public:
     static void YieldToHold();
     // 总协程数
     static uint64_t TotalFibers();
+    // 标记本线程正在调度循环的栈上直接执行回调(Scheduler::scheduleInline)，此时不能让出
+    static void SetRunInline(bool v);
+    static bool IsRunInline();
 
     static void MainFunc();
     static void CallerMainFunc();
     // 获取协程id
     static uint64_t GetFiberId();
 
+private:
+    // 在协程栈上初始化上下文，入口为func
+    void makeContext(void (*func)());
+    // 保存from的上下文并切换到to
+    static void SwapContext(Fiber *from, Fiber *to);
+
 private:
     // 协程id
     uint64_t m_id = 0;
@@ -85,7 +94,12 @@ private:
     // 协程状态
     State m_state = INIT;
     // 协程上下文
+#ifdef CXS_FIBER_ASM_CONTEXT
+    // 切出时保存的栈顶，寄存器都保存在该栈上
+    void *m_ctx = nullptr;
+#else
     ucontext_t m_ctx;
+#endif
     // 协程栈指针
     void *m_stack = nullptr;
     // 协程执行方法
@@ -0,0 +1,106 @@
+#include "fiber_context.h"
+#include <stdint.h>
+
+#ifdef CXS_FIBER_ASM_CONTEXT
+
+#if defined(__x86_64__)
+// System V ABI 被调用者保存寄存器: rbp rbx r12-r15，外加MXCSR和x87控制字
+// 栈布局(低地址到高地址): [mxcsr|fpucw] r15 r14 r13 r12 rbx rbp ret
+asm(R"(
+    .text
+    .globl cxs_swap_context
+    .type cxs_swap_context,@function
+    .align 16
+cxs_swap_context:
+    pushq %rbp
+    pushq %rbx
+    pushq %r12
+    pushq %r13
+    pushq %r14
+    pushq %r15
+    subq $8, %rsp
+    stmxcsr (%rsp)
+    fnstcw 4(%rsp)
+    movq %rsp, (%rdi)
+    movq %rsi, %rsp
+    ldmxcsr (%rsp)
+    fldcw 4(%rsp)
+    addq $8, %rsp
+    popq %r15
+    popq %r14
+    popq %r13
+    popq %r12
+    popq %rbx
+    popq %rbp
+    ret
+    .size cxs_swap_context,.-cxs_swap_context
+)");
+#elif defined(__aarch64__)
+// AAPCS64 被调用者保存寄存器: x19-x28, fp(x29), lr(x30), d8-d15
+asm(R"(
+    .text
+    .globl cxs_swap_context
+    .type cxs_swap_context,%function
+    .align 4
+cxs_swap_context:
+    sub sp, sp, #0xa0
+    stp x19, x20, [sp, #0x00]
+    stp x21, x22, [sp, #0x10]
+    stp x23, x24, [sp, #0x20]
+    stp x25, x26, [sp, #0x30]
+    stp x27, x28, [sp, #0x40]
+    stp x29, x30, [sp, #0x50]
+    stp d8, d9, [sp, #0x60]
+    stp d10, d11, [sp, #0x70]
+    stp d12, d13, [sp, #0x80]
+    stp d14, d15, [sp, #0x90]
+    mov x9, sp
+    str x9, [x0]
+    mov sp, x1
+    ldp x19, x20, [sp, #0x00]
+    ldp x21, x22, [sp, #0x10]
+    ldp x23, x24, [sp, #0x20]
+    ldp x25, x26, [sp, #0x30]
+    ldp x27, x28, [sp, #0x40]
+    ldp x29, x30, [sp, #0x50]
+    ldp d8, d9, [sp, #0x60]
+    ldp d10, d11, [sp, #0x70]
+    ldp d12, d13, [sp, #0x80]
+    ldp d14, d15, [sp, #0x90]
+    add sp, sp, #0xa0
+    ret
+    .size cxs_swap_context,.-cxs_swap_context
+)");
+#endif
+
+namespace CXS {
+
+void *MakeFiberContext(void *stack, size_t size, void (*entry)()) {
+    // 栈顶按16字节对齐
+    uintptr_t top = ((uintptr_t)stack + size) & ~(uintptr_t)15;
+#if defined(__x86_64__)
+    uint64_t *sp = (uint64_t *)top;
+    // 入口函数看起来像是被call进来的: 返回地址槽位于16n-8处，返回地址为0以终止回溯
+    *--sp = 0;
+    *--sp = (uint64_t)entry;
+    // rbp rbx r12 r13 r14 r15
+    for (int i = 0; i < 6; ++i) {
+        *--sp = 0;
+    }
+    // MXCSR 默认值0x1F80, x87控制字默认值0x037F
+    *--sp = ((uint64_t)0x037F << 32) | 0x1F80;
+    return sp;
+#elif defined(__aarch64__)
+    uint64_t *sp = (uint64_t *)(top - 0xa0);
+    for (int i = 0; i < 0xa0 / 8; ++i) {
+        sp[i] = 0;
+    }
+    // ret从x30(lr)返回，即跳到entry
+    sp[11] = (uint64_t)entry;
+    return sp;
+#endif
+}
+
+} // namespace CXS
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef __CXS_FIBER_CONTEXT_H__
+#define __CXS_FIBER_CONTEXT_H__
+
+#include <cstddef>
+
+// 协程上下文切换实现在构建时选择:
+// x86_64/aarch64 默认使用汇编只保存被调用者保存寄存器，不需要像swapcontext那样调用rt_sigprocmask
+// 其他平台或定义了CXS_FIBER_UCONTEXT时回退到ucontext
+#if !defined(CXS_FIBER_UCONTEXT) && (defined(__x86_64__) || defined(__aarch64__))
+#define CXS_FIBER_ASM_CONTEXT 1
+#endif
+
+#ifdef CXS_FIBER_ASM_CONTEXT
+extern "C" {
+// 把当前寄存器压到当前栈上，栈顶保存到*from，然后切换到to指向的栈并恢复寄存器
+void cxs_swap_context(void **from, void *to);
+}
+
+namespace CXS {
+// 在协程栈顶构造初始帧，返回值作为首次切入时的上下文，切入后从entry开始执行
+void *MakeFiberContext(void *stack, size_t size, void (*entry)());
+} // namespace CXS
+#else
+#include <ucontext.h>
+#endif
+
+#endif
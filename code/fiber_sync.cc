@@ -0,0 +1,338 @@
+#include "fiber_sync.h"
+#include "iomanager.h"
+#include "macro.h"
+#include "scheduler.hpp"
+#include "util.h"
+#include <vector>
+
+namespace CXS {
+
+// 竞争时挂起前自旋尝试的次数，锁通常很快释放，挂起再调度的开销远大于短暂自旋
+static const int SPIN_COUNT = 64;
+
+static inline void CpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+}
+
+FiberWaiter::ptr FiberWaiter::Create() {
+    // run-inline回调在调度循环的栈上执行，看起来像不在协程中，等待会阻塞整个工作线程
+    CXS_ASSERT2(!Fiber::IsRunInline(), "wait from a run-inline callback");
+    FiberWaiter::ptr waiter(new FiberWaiter);
+    Scheduler *scheduler = Scheduler::GetThis();
+    if (scheduler) {
+        Fiber::ptr fiber = Fiber::GetThis();
+        if (fiber.get() != Scheduler::GetMainFiber()) {
+            waiter->scheduler = scheduler;
+            waiter->fiber = fiber;
+        }
+    }
+    return waiter;
+}
+
+FiberWaiter::ptr FiberWaiter::Pop(std::list<FiberWaiter::ptr> &waiters) {
+    while (!waiters.empty()) {
+        FiberWaiter::ptr waiter = waiters.front();
+        waiters.pop_front();
+        int expected = WAITING;
+        if (waiter->state.compare_exchange_strong(expected, WOKEN)) {
+            return waiter;
+        }
+    }
+    return nullptr;
+}
+
+void FiberWaiter::wake() {
+    if (scheduler) {
+        scheduler->schedule(fiber);
+    } else {
+        sem.notify();
+    }
+}
+
+bool FiberWaiter::park(uint64_t timeout_ms) {
+    Timer::ptr timer;
+    if (timeout_ms != ~0ull) {
+        IOManager *iom = IOManager::GetThis();
+        CXS_ASSERT2(iom && scheduler, "timed wait must run in an IOManager fiber");
+        std::weak_ptr<FiberWaiter> weak(shared_from_this());
+        timer = iom->addTimer(timeout_ms, [weak]() {
+            FiberWaiter::ptr waiter = weak.lock();
+            int expected = WAITING;
+            if (waiter && waiter->state.compare_exchange_strong(expected, TIMEOUT)) {
+                waiter->wake();
+            }
+        });
+    }
+    // 唤醒可能早于挂起，调度器发现协程仍在EXEC时会稍后再执行它
+    if (scheduler) {
+        Fiber::YieldToHold();
+    } else {
+        sem.wait();
+    }
+    if (timer) {
+        timer->cancel();
+    }
+    return state != TIMEOUT;
+}
+
+void FiberMutex::lock() {
+    for (int i = 0; i < SPIN_COUNT; ++i) {
+        if (tryLock()) {
+            return;
+        }
+        CpuRelax();
+    }
+    Spinlock::Lock l(m_lock);
+    // 先登记再检查m_locked，与unlock中先释放再检查m_waiting配对，不会漏掉唤醒
+    ++m_waiting;
+    while (!tryLock()) {
+        FiberWaiter::ptr waiter = FiberWaiter::Create();
+        m_waiters.push_back(waiter);
+        l.unlock();
+        waiter->park();
+        l.lock();
+    }
+    --m_waiting;
+}
+
+bool FiberMutex::tryLock() {
+    bool expected = false;
+    return m_locked.compare_exchange_strong(expected, true);
+}
+
+void FiberMutex::unlock() {
+    m_locked = false;
+    if (m_waiting == 0) {
+        return;
+    }
+    FiberWaiter::ptr waiter;
+    {
+        Spinlock::Lock l(m_lock);
+        waiter = FiberWaiter::Pop(m_waiters);
+    }
+    if (waiter) {
+        waiter->wake();
+    }
+}
+
+void FiberCondition::wait(FiberMutex &mutex) {
+    wait(mutex, ~0ull);
+}
+
+bool FiberCondition::wait(FiberMutex &mutex, uint64_t timeout_ms) {
+    FiberWaiter::ptr waiter = FiberWaiter::Create();
+    {
+        Spinlock::Lock l(m_lock);
+        m_waiters.push_back(waiter);
+    }
+    // 先排队再释放mutex，持有mutex的notify不会错过本等待者
+    mutex.unlock();
+    bool rt = waiter->park(timeout_ms);
+    if (!rt) {
+        Spinlock::Lock l(m_lock);
+        m_waiters.remove(waiter);
+    }
+    mutex.lock();
+    return rt;
+}
+
+void FiberCondition::notify() {
+    FiberWaiter::ptr waiter;
+    {
+        Spinlock::Lock l(m_lock);
+        waiter = FiberWaiter::Pop(m_waiters);
+    }
+    if (waiter) {
+        waiter->wake();
+    }
+}
+
+void FiberCondition::notifyAll() {
+    std::vector<FiberWaiter::ptr> waiters;
+    {
+        Spinlock::Lock l(m_lock);
+        while (FiberWaiter::ptr waiter = FiberWaiter::Pop(m_waiters)) {
+            waiters.push_back(waiter);
+        }
+    }
+    for (auto &i : waiters) {
+        i->wake();
+    }
+}
+
+FiberSemaphore::FiberSemaphore(uint32_t count) :
+    m_count(count) {
+}
+
+void FiberSemaphore::wait() {
+    wait(~0ull);
+}
+
+bool FiberSemaphore::wait(uint64_t timeout_ms) {
+    for (int i = 0; i < SPIN_COUNT; ++i) {
+        if (tryWait()) {
+            return true;
+        }
+        CpuRelax();
+    }
+    uint64_t deadline = timeout_ms == ~0ull ? ~0ull : GetCurrentMS() + timeout_ms;
+    Spinlock::Lock l(m_lock);
+    while (!tryWait()) {
+        uint64_t left = ~0ull;
+        if (deadline != ~0ull) {
+            uint64_t now = GetCurrentMS();
+            if (now >= deadline) {
+                return false;
+            }
+            left = deadline - now;
+        }
+        FiberWaiter::ptr waiter = FiberWaiter::Create();
+        m_waiters.push_back(waiter);
+        l.unlock();
+        bool woken = waiter->park(left);
+        l.lock();
+        if (!woken) {
+            m_waiters.remove(waiter);
+        }
+    }
+    return true;
+}
+
+bool FiberSemaphore::tryWait() {
+    uint32_t count = m_count;
+    while (count > 0) {
+        if (m_count.compare_exchange_weak(count, count - 1)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void FiberSemaphore::notify() {
+    FiberWaiter::ptr waiter;
+    {
+        Spinlock::Lock l(m_lock);
+        ++m_count;
+        waiter = FiberWaiter::Pop(m_waiters);
+    }
+    if (waiter) {
+        waiter->wake();
+    }
+}
+
+void FiberRWMutex::rdlock() {
+    for (int i = 0; i < SPIN_COUNT; ++i) {
+        if (tryRdlock()) {
+            return;
+        }
+        CpuRelax();
+    }
+    Spinlock::Lock l(m_lock);
+    while (m_writer || m_waitingWriters) {
+        FiberWaiter::ptr waiter = FiberWaiter::Create();
+        m_readWaiters.push_back(waiter);
+        l.unlock();
+        waiter->park();
+        l.lock();
+    }
+    ++m_readers;
+}
+
+void FiberRWMutex::wrlock() {
+    for (int i = 0; i < SPIN_COUNT; ++i) {
+        if (tryWrlock()) {
+            return;
+        }
+        CpuRelax();
+    }
+    Spinlock::Lock l(m_lock);
+    ++m_waitingWriters;
+    while (m_writer || m_readers) {
+        FiberWaiter::ptr waiter = FiberWaiter::Create();
+        m_writeWaiters.push_back(waiter);
+        l.unlock();
+        waiter->park();
+        l.lock();
+    }
+    --m_waitingWriters;
+    m_writer = true;
+}
+
+bool FiberRWMutex::tryRdlock() {
+    Spinlock::Lock l(m_lock);
+    if (m_writer || m_waitingWriters) {
+        return false;
+    }
+    ++m_readers;
+    return true;
+}
+
+bool FiberRWMutex::tryWrlock() {
+    Spinlock::Lock l(m_lock);
+    if (m_writer || m_readers) {
+        return false;
+    }
+    m_writer = true;
+    return true;
+}
+
+void FiberRWMutex::unlock() {
+    std::vector<FiberWaiter::ptr> waiters;
+    {
+        Spinlock::Lock l(m_lock);
+        if (m_writer) {
+            m_writer = false;
+        } else {
+            CXS_ASSERT(m_readers > 0);
+            --m_readers;
+        }
+        if (m_readers == 0) {
+            // 优先交给一个写者，没有写者等待时唤醒所有读者
+            FiberWaiter::ptr waiter = FiberWaiter::Pop(m_writeWaiters);
+            if (waiter) {
+                waiters.push_back(waiter);
+            } else {
+                while ((waiter = FiberWaiter::Pop(m_readWaiters))) {
+                    waiters.push_back(waiter);
+                }
+            }
+        }
+    }
+    for (auto &i : waiters) {
+        i->wake();
+    }
+}
+
+void WaitGroup::add(int64_t n) {
+    // 计数减到0和取出等待者在同一把锁内完成，wait返回后本对象可以立即析构，解锁之后不能再访问成员
+    std::vector<FiberWaiter::ptr> waiters;
+    {
+        Spinlock::Lock l(m_lock);
+        int64_t count = m_count += n;
+        CXS_ASSERT2(count >= 0, "WaitGroup counter is negative");
+        if (count != 0) {
+            return;
+        }
+        while (FiberWaiter::ptr waiter = FiberWaiter::Pop(m_waiters)) {
+            waiters.push_back(waiter);
+        }
+    }
+    for (auto &i : waiters) {
+        i->wake();
+    }
+}
+
+void WaitGroup::wait() {
+    Spinlock::Lock l(m_lock);
+    while (m_count != 0) {
+        FiberWaiter::ptr waiter = FiberWaiter::Create();
+        m_waiters.push_back(waiter);
+        l.unlock();
+        waiter->park();
+        l.lock();
+    }
+}
+
+} // namespace CXS
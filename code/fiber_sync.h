@@ -0,0 +1,133 @@
+#ifndef __CXS_FIBER_SYNC_H__
+#define __CXS_FIBER_SYNC_H__
+
+#include <atomic>
+#include <list>
+#include <memory>
+#include <stdint.h>
+
+#include "fiber.hpp"
+#include "noncopyable.h"
+#include "thread.h"
+
+namespace CXS {
+
+class Scheduler;
+
+// 协程同步原语的等待者
+// 在调度器中等待时挂起协程，释放时通过Scheduler::schedule重新调度；不在调度器中的线程阻塞在信号量上
+struct FiberWaiter : public std::enable_shared_from_this<FiberWaiter> {
+    typedef std::shared_ptr<FiberWaiter> ptr;
+    enum State {
+        WAITING,
+        WOKEN,
+        TIMEOUT,
+    };
+    // 唤醒与超时竞争，谁先把WAITING改掉谁生效
+    std::atomic<int> state = {WAITING};
+    Scheduler *scheduler = nullptr;
+    Fiber::ptr fiber;
+    Semaphore sem;
+
+    // 为当前执行流创建等待者，在调度器的任务协程中挂起协程，否则阻塞线程
+    static FiberWaiter::ptr Create();
+    // 调用方持有等待队列的锁，取出第一个仍在等待的等待者(状态改为WOKEN)，已超时的直接丢弃
+    static FiberWaiter::ptr Pop(std::list<FiberWaiter::ptr> &waiters);
+    // 不持有等待队列的锁时调用，协程放回它等待时所在的调度器
+    void wake();
+    // 已放入等待队列并释放锁后调用，挂起直到被唤醒或超时
+    // 超时返回false，此时等待者仍在队列中，由调用方加锁移除；带超时的等待需要在IOManager中调用
+    bool park(uint64_t timeout_ms = ~0ull);
+};
+
+// 协程互斥量，竞争时先自旋一小段时间，拿不到再挂起协程，不阻塞工作线程
+class FiberMutex : public Noncopyable {
+public:
+    typedef ScopedLockImpl<FiberMutex> Lock;
+
+    void lock();
+    bool tryLock();
+    void unlock();
+
+private:
+    std::atomic<bool> m_locked = {false};
+    // 排队或正在排队的等待者数，为0时unlock不需要加锁检查等待队列
+    std::atomic<uint32_t> m_waiting = {0};
+    Spinlock m_lock;
+    std::list<FiberWaiter::ptr> m_waiters;
+};
+
+// 协程条件变量，配合FiberMutex使用
+class FiberCondition : public Noncopyable {
+public:
+    // 释放mutex并挂起，被唤醒后重新持有mutex再返回，可能虚假唤醒，调用方需循环检查条件
+    void wait(FiberMutex &mutex);
+    // 超时返回false，需要在IOManager中调用
+    bool wait(FiberMutex &mutex, uint64_t timeout_ms);
+    void notify();
+    void notifyAll();
+
+private:
+    Spinlock m_lock;
+    std::list<FiberWaiter::ptr> m_waiters;
+};
+
+// 协程信号量
+class FiberSemaphore : public Noncopyable {
+public:
+    FiberSemaphore(uint32_t count = 0);
+
+    void wait();
+    // 超时返回false，需要在IOManager中调用
+    bool wait(uint64_t timeout_ms);
+    bool tryWait();
+    void notify();
+
+    uint32_t getCount() const { return m_count; }
+
+private:
+    std::atomic<uint32_t> m_count;
+    Spinlock m_lock;
+    std::list<FiberWaiter::ptr> m_waiters;
+};
+
+// 协程读写锁，写优先: 有写者等待时新的读者也排队，避免写者饿死
+class FiberRWMutex : public Noncopyable {
+public:
+    typedef ReadScopedLockImpl<FiberRWMutex> ReadLock;
+    typedef WriteScopedLockImpl<FiberRWMutex> WriteLock;
+
+    void rdlock();
+    void wrlock();
+    bool tryRdlock();
+    bool tryWrlock();
+    void unlock();
+
+private:
+    Spinlock m_lock;
+    // 持有读锁的数量
+    uint32_t m_readers = 0;
+    // 是否有写者持有
+    bool m_writer = false;
+    // 等待中的写者数
+    uint32_t m_waitingWriters = 0;
+    std::list<FiberWaiter::ptr> m_readWaiters;
+    std::list<FiberWaiter::ptr> m_writeWaiters;
+};
+
+// 等待一组任务完成: 派发前add，每个任务结束时done，wait挂起直到计数归零
+class WaitGroup : public Noncopyable {
+public:
+    void add(int64_t n = 1);
+    void done() { add(-1); }
+    void wait();
+
+private:
+    std::atomic<int64_t> m_count = {0};
+    Spinlock m_lock;
+    std::list<FiberWaiter::ptr> m_waiters;
+};
+
+} // namespace CXS
+
+#endif
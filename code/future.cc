@@ -0,0 +1,71 @@
+#include "future.h"
+
+namespace CXS {
+
+void FutureStateBase::wait() {
+    if (m_ready) {
+        return;
+    }
+    Spinlock::Lock lock(m_lock);
+    while (!m_ready) {
+        FiberWaiter::ptr waiter = FiberWaiter::Create();
+        m_waiters.push_back(waiter);
+        lock.unlock();
+        waiter->park();
+        lock.lock();
+    }
+}
+
+bool FutureStateBase::wait(uint64_t timeout_ms) {
+    if (m_ready) {
+        return true;
+    }
+    Spinlock::Lock lock(m_lock);
+    if (!m_ready) {
+        FiberWaiter::ptr waiter = FiberWaiter::Create();
+        m_waiters.push_back(waiter);
+        lock.unlock();
+        bool woken = waiter->park(timeout_ms);
+        lock.lock();
+        if (!woken) {
+            m_waiters.remove(waiter);
+        }
+    }
+    return m_ready;
+}
+
+void FutureStateBase::onReady(std::function<void()> cb) {
+    {
+        Spinlock::Lock lock(m_lock);
+        if (!m_ready) {
+            m_callbacks.push_back(std::move(cb));
+            return;
+        }
+    }
+    cb();
+}
+
+void FutureStateBase::setException(std::exception_ptr e) {
+    m_exception = e;
+    markReady();
+}
+
+void FutureStateBase::markReady() {
+    std::list<FiberWaiter::ptr> waiters;
+    std::vector<std::function<void()>> callbacks;
+    {
+        Spinlock::Lock lock(m_lock);
+        CXS_ASSERT2(!m_ready, "future already has a result");
+        m_ready = true;
+        waiters.swap(m_waiters);
+        callbacks.swap(m_callbacks);
+    }
+    while (FiberWaiter::ptr waiter = FiberWaiter::Pop(waiters)) {
+        waiter->wake();
+    }
+    for (auto &i : callbacks) {
+        i();
+    }
+}
+
+} // namespace CXS
@@ -0,0 +1,265 @@
+#ifndef __CXS_FUTURE_H__
+#define __CXS_FUTURE_H__
+
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <list>
+#include <memory>
+#include <new>
+#include <stddef.h>
+#include <stdint.h>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "fiber_sync.h"
+#include "macro.h"
+#include "noncopyable.h"
+#include "scheduler.hpp"
+#include "thread.h"
+
+namespace CXS {
+
+// Future的共享状态，完成前get的协程挂起(不在调度器中时阻塞线程)，完成后依次执行回调
+class FutureStateBase : public Noncopyable {
+public:
+    virtual ~FutureStateBase() {}
+
+    bool isReady() const { return m_ready; }
+    void wait();
+    // 超时返回false，需要在IOManager中调用
+    bool wait(uint64_t timeout_ms);
+    // cb在完成它的线程上直接执行，已完成时立即执行，应很短且不挂起
+    void onReady(std::function<void()> cb);
+    void setException(std::exception_ptr e);
+
+    // 产生结果的调度器，then的后续任务也调度到这里
+    Scheduler *getScheduler() const { return m_scheduler; }
+    void setScheduler(Scheduler *v) { m_scheduler = v; }
+
+protected:
+    // 结果写入后调用，只能调用一次
+    void markReady();
+    void rethrow() {
+        if (m_exception) {
+            std::rethrow_exception(m_exception);
+        }
+    }
+
+private:
+    Spinlock m_lock;
+    std::atomic<bool> m_ready = {false};
+    std::exception_ptr m_exception;
+    Scheduler *m_scheduler = nullptr;
+    std::list<FiberWaiter::ptr> m_waiters;
+    std::vector<std::function<void()>> m_callbacks;
+};
+
+template <class T>
+class FutureState : public FutureStateBase {
+public:
+    ~FutureState() {
+        if (m_hasValue) {
+            value().~T();
+        }
+    }
+
+    template <class V>
+    void setValue(V &&v) {
+        new (&m_storage) T(std::forward<V>(v));
+        m_hasValue = true;
+        markReady();
+    }
+
+    T &get() {
+        wait();
+        rethrow();
+        return value();
+    }
+
+private:
+    T &value() { return *reinterpret_cast<T *>(&m_storage); }
+
+private:
+    // 结果就地存放，不要求T可默认构造，也不额外分配内存
+    typename std::aligned_storage<sizeof(T), alignof(T)>::type m_storage;
+    bool m_hasValue = false;
+};
+
+template <>
+class FutureState<void> : public FutureStateBase {
+public:
+    void setValue() { markReady(); }
+
+    void get() {
+        wait();
+        rethrow();
+    }
+};
+
+template <class T, class F>
+void FutureInvoke(FutureState<T> &state, F &cb) {
+    state.setValue(cb());
+}
+
+template <class F>
+void FutureInvoke(FutureState<void> &state, F &cb) {
+    cb();
+    state.setValue();
+}
+
+// 调度执行的回调与其结果放在一起，make_shared一次分配
+// 入队前持有自身的引用，调度队列中只放裸指针，std::function可以就地存放不再分配内存
+template <class T, class F>
+class AsyncTask : public FutureState<T> {
+public:
+    typedef std::shared_ptr<AsyncTask> ptr;
+
+    AsyncTask(F &&cb) :
+        m_cb(std::move(cb)) {
+    }
+
+    static ptr Create(F &&cb) {
+        ptr task = std::make_shared<AsyncTask>(std::move(cb));
+        task->m_self = task;
+        return task;
+    }
+
+    void run() {
+        ptr self = std::move(m_self);
+        try {
+            FutureInvoke(*this, m_cb);
+        } catch (...) {
+            this->setException(std::current_exception());
+        }
+    }
+
+    // 放入scheduler执行，scheduler为空时在当前线程直接执行
+    static void Submit(AsyncTask *task, Scheduler *scheduler, int thread = -1) {
+        if (scheduler) {
+            scheduler->schedule([task]() { task->run(); }, thread);
+        } else {
+            task->run();
+        }
+    }
+
+private:
+    F m_cb;
+    ptr m_self;
+};
+
+template <class T, class F>
+struct ThenResult {
+    typedef decltype(std::declval<F &>()(std::declval<T &>())) type;
+};
+
+template <class F>
+struct ThenResult<void, F> {
+    typedef decltype(std::declval<F &>()()) type;
+};
+
+// 协程友好的Future，get挂起当前协程而不阻塞工作线程，可以拷贝，多个Future共享同一结果
+template <class T>
+class Future {
+public:
+    typedef FutureState<T> State;
+    typedef typename std::add_lvalue_reference<T>::type Reference;
+
+    Future() {}
+    Future(std::shared_ptr<State> state) :
+        m_state(std::move(state)) {
+    }
+
+    bool valid() const { return m_state != nullptr; }
+    bool isReady() const { return m_state->isReady(); }
+    void wait() const { m_state->wait(); }
+    // 超时返回false，需要在IOManager中调用
+    bool wait(uint64_t timeout_ms) const { return m_state->wait(timeout_ms); }
+
+    // 等待完成并返回结果，回调抛出的异常在这里重新抛出，返回的引用在共享状态存在期间有效
+    Reference get() const { return m_state->get(); }
+
+    // 完成后在完成它的线程上直接执行cb，应很短且不挂起
+    void onReady(std::function<void()> cb) const { m_state->onReady(std::move(cb)); }
+
+    // 完成后把cb(结果)调度到产生结果的调度器上执行，前一步的异常传递给返回的Future
+    template <class F>
+    Future<typename ThenResult<T, F>::type> then(F cb) const {
+        typedef typename ThenResult<T, F>::type R;
+        std::shared_ptr<State> parent = m_state;
+        auto next = [parent, cb]() mutable -> R { return Then(*parent, cb); };
+        auto task = AsyncTask<R, decltype(next)>::Create(std::move(next));
+        Scheduler *scheduler = parent->getScheduler() ? parent->getScheduler() : Scheduler::GetThis();
+        task->setScheduler(scheduler);
+        auto raw = task.get();
+        parent->onReady([raw, scheduler]() { AsyncTask<R, decltype(next)>::Submit(raw, scheduler); });
+        return Future<R>(task);
+    }
+
+private:
+    template <class V, class F>
+    static typename ThenResult<V, F>::type Then(FutureState<V> &parent, F &cb) {
+        return cb(parent.get());
+    }
+    template <class F>
+    static typename ThenResult<void, F>::type Then(FutureState<void> &parent, F &cb) {
+        parent.get();
+        return cb();
+    }
+
+private:
+    std::shared_ptr<State> m_state;
+};
+
+template <class F>
+auto Scheduler::async(F cb, int thread) -> Future<decltype(cb())> {
+    typedef decltype(cb()) R;
+    auto task = AsyncTask<R, F>::Create(std::move(cb));
+    task->setScheduler(this);
+    AsyncTask<R, F>::Submit(task.get(), this, thread);
+    return Future<R>(task);
+}
+
+// 全部完成(包括抛出异常)后完成，各自的结果仍从原Future取
+template <class T>
+Future<void> whenAll(const std::vector<Future<T>> &futures) {
+    struct State : public FutureState<void> {
+        std::atomic<size_t> left;
+    };
+    std::shared_ptr<State> state = std::make_shared<State>();
+    state->left = futures.size();
+    if (futures.empty()) {
+        state->setValue();
+    }
+    for (auto &i : futures) {
+        i.onReady([state]() {
+            if (--state->left == 0) {
+                state->setValue();
+            }
+        });
+    }
+    return Future<void>(state);
+}
+
+// 任意一个完成后完成，结果为最先完成的下标
+template <class T>
+Future<size_t> whenAny(const std::vector<Future<T>> &futures) {
+    struct State : public FutureState<size_t> {
+        std::atomic<bool> done = {false};
+    };
+    CXS_ASSERT(!futures.empty());
+    std::shared_ptr<State> state = std::make_shared<State>();
+    for (size_t i = 0; i < futures.size(); ++i) {
+        futures[i].onReady([state, i]() {
+            if (!state->done.exchange(true)) {
+                state->setValue(i);
+            }
+        });
+    }
+    return Future<size_t>(state);
+}
+
+} // namespace CXS
+
+#endif
@@ -0,0 +1,113 @@
+#ifndef __CXS_HISTOGRAM_H__
+#define __CXS_HISTOGRAM_H__
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "noncopyable.h"
+
+namespace CXS {
+
+// 无锁直方图，按2的幂分桶，多个线程同时记录、读取都不加锁，用于记录微秒级延迟等
+// 第0个桶只记0，第i个桶记[2^(i-1), 2^i)，超出范围的记入最后一个桶
+class Histogram : public Noncopyable {
+public:
+    static const size_t BUCKETS = 40;
+
+    Histogram() {
+        reset();
+    }
+
+    void record(uint64_t v) {
+        size_t i = v ? 64 - __builtin_clzll(v) : 0;
+        if (i >= BUCKETS) {
+            i = BUCKETS - 1;
+        }
+        m_buckets[i].fetch_add(1, std::memory_order_relaxed);
+        m_count.fetch_add(1, std::memory_order_relaxed);
+        m_sum.fetch_add(v, std::memory_order_relaxed);
+        uint64_t max = m_max.load(std::memory_order_relaxed);
+        while (v > max && !m_max.compare_exchange_weak(max, v, std::memory_order_relaxed)) {
+        }
+    }
+
+    // 读取时其他线程可能仍在记录，各字段之间不保证是同一时刻的值
+    uint64_t getCount() const {
+        return m_count.load(std::memory_order_relaxed);
+    }
+    uint64_t getSum() const {
+        return m_sum.load(std::memory_order_relaxed);
+    }
+    uint64_t getMax() const {
+        return m_max.load(std::memory_order_relaxed);
+    }
+    uint64_t getBucket(size_t i) const {
+        return m_buckets[i].load(std::memory_order_relaxed);
+    }
+    // 第i个桶的上界(含)
+    static uint64_t BucketUpper(size_t i) {
+        return i == 0 ? 0 : (1ull << i) - 1;
+    }
+
+    // 累加另一个直方图，用于汇总各线程的直方图
+    void merge(const Histogram &other) {
+        for (size_t i = 0; i < BUCKETS; ++i) {
+            m_buckets[i].fetch_add(other.getBucket(i), std::memory_order_relaxed);
+        }
+        m_count.fetch_add(other.getCount(), std::memory_order_relaxed);
+        m_sum.fetch_add(other.getSum(), std::memory_order_relaxed);
+        uint64_t v = other.getMax();
+        uint64_t max = m_max.load(std::memory_order_relaxed);
+        while (v > max && !m_max.compare_exchange_weak(max, v, std::memory_order_relaxed)) {
+        }
+    }
+
+    // q(0~1)分位所在桶的上界，不超过记录到的最大值，没有记录时返回0
+    uint64_t percentile(double q) const {
+        std::vector<uint64_t> buckets(BUCKETS);
+        uint64_t total = 0;
+        for (size_t i = 0; i < BUCKETS; ++i) {
+            buckets[i] = getBucket(i);
+            total += buckets[i];
+        }
+        if (total == 0) {
+            return 0;
+        }
+        uint64_t rank = (uint64_t)(q * total);
+        if (rank >= total) {
+            rank = total - 1;
+        }
+        uint64_t seen = 0;
+        size_t i = 0;
+        for (; i < BUCKETS - 1; ++i) {
+            seen += buckets[i];
+            if (seen > rank) {
+                break;
+            }
+        }
+        uint64_t upper = BucketUpper(i);
+        uint64_t max = getMax();
+        return upper < max ? upper : max;
+    }
+
+    void reset() {
+        for (size_t i = 0; i < BUCKETS; ++i) {
+            m_buckets[i].store(0, std::memory_order_relaxed);
+        }
+        m_count.store(0, std::memory_order_relaxed);
+        m_sum.store(0, std::memory_order_relaxed);
+        m_max.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<uint64_t> m_buckets[BUCKETS];
+    std::atomic<uint64_t> m_count;
+    std::atomic<uint64_t> m_sum;
+    std::atomic<uint64_t> m_max;
+};
+
+} // namespace CXS
+
+#endif
@@ -22,6 +22,10 @@
 #include "log.h"
 #include "util.h"
 #include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#include <poll.h>
+#include <string.h>
+#include <linux/io_uring.h>
 CXS::Logger::ptr g_logger = CXS_LOG_NAME("system");
 
 namespace CXS {
@@ -36,6 +40,7 @@ static thread_local bool t_hook_enable = false;
     XX(socket)       \
     XX(connect)      \
     XX(accept)       \
+    XX(accept4)      \
     XX(read)         \
     XX(readv)        \
     XX(recv)         \
@@ -46,6 +51,7 @@ static thread_local bool t_hook_enable = false;
     XX(send)         \
     XX(sendto)       \
     XX(sendmsg)      \
+    XX(sendfile)     \
     XX(close)        \
     XX(fcntl)        \
     XX(ioctl)        \
@@ -88,6 +94,19 @@ struct timer_info {
     int cancelled = 0;
 };
 
+/*
+ * 协程挂起后可能在其他线程上恢复，而glibc把__errno_location声明为const，
+ * 编译器会复用挂起前取到的errno地址，读写到原线程的errno上。
+ * 挂起前后都要访问errno的函数通过这两个不内联的函数重新取地址
+ */
+static __attribute__((noinline)) int get_errno() {
+    return errno;
+}
+
+static __attribute__((noinline)) void set_errno(int e) {
+    errno = e;
+}
+
 /*
  * 	fd 			 	文件描述符
  * 	fun				原始函数
@@ -132,13 +151,13 @@ retry:
     // CXS_LOG_DEBUG(g_logger) << "do_io <" << hook_fun_name << ">"
     //                         << " n = " << n;
     // 若中断则重试
-    while (n == -1 && errno == EINTR) {
+    while (n == -1 && get_errno() == EINTR) {
         n = fun(fd, std::forward<Args>(args)...);
     }
     // 若为阻塞状态
-    if (n == -1 && errno == EAGAIN) {
+    if (n == -1 && get_errno() == EAGAIN) {
         // 重置EAGIN(errno = 11)，此处已处理，不在向上返回该错误
-        errno = 0;
+        set_errno(0);
         // 获得当前IO调度器
         CXS::IOManager *iom = CXS::IOManager::GetThis();
         // 定时器
@@ -172,13 +191,19 @@ retry:
                 timer->cancel();
             }
             return -1;
+        } else if (rt == 1) {
+            // 持久注册模式下fd在EAGAIN之后已经就绪，直接重试
+            if (timer) {
+                timer->cancel();
+            }
+            goto retry;
         } else {
             CXS::Fiber::YieldToHold();
             if (timer) {
                 timer->cancel();
             }
             if (tinfo->cancelled) {
-                errno = tinfo->cancelled;
+                set_errno(tinfo->cancelled);
                 return -1;
             }
             goto retry;
@@ -186,6 +211,145 @@ retry:
     }
     return n;
 }
+
+/*
+ * io_uring后端: 先直接调用一次，EAGAIN时提交prep构造的完成式操作并挂起，
+ * 完成结果就是本次调用的结果，不需要再注册事件、等待可读写后二次调用
+ * 内核对非阻塞fd不等待(返回EAGAIN)或操作被主动取消时，回退到do_io
+ */
+template <typename OriginFun, typename PrepFun, typename... Args>
+static ssize_t do_uring_io(int fd, OriginFun fun, const char *hook_fun_name,
+                           uint32_t event, int timeout_so, PrepFun prep, Args &&...args) {
+    CXS::IOManager *iom = CXS::t_hook_enable ? CXS::IOManager::GetThis() : nullptr;
+    if (!iom || !iom->hasUring()) {
+        return do_io(fd, fun, hook_fun_name, event, timeout_so, std::forward<Args>(args)...);
+    }
+    CXS::FdCtx::ptr ctx = CXS::FdMgr::GetInstance()->get(fd);
+    if (!ctx || ctx->isClose() || !ctx->isSocket() || ctx->getUserNonblock()) {
+        return do_io(fd, fun, hook_fun_name, event, timeout_so, std::forward<Args>(args)...);
+    }
+
+    ssize_t n = fun(fd, args...);
+    while (n == -1 && errno == EINTR) {
+        n = fun(fd, args...);
+    }
+    if (n != -1 || errno != EAGAIN) {
+        return n;
+    }
+
+    io_uring_sqe sqe;
+    memset(&sqe, 0, sizeof(sqe));
+    sqe.fd = fd;
+    prep(sqe);
+    int res = iom->submitUring(fd, (CXS::IOManager::Event)event, sqe, ctx->getTimeout(timeout_so));
+    if (res == -EAGAIN || res == -ECANCELED || res == CXS::IOManager::URING_SUBMIT_FAILED) {
+        return do_io(fd, fun, hook_fun_name, event, timeout_so, std::forward<Args>(args)...);
+    }
+    if (res < 0) {
+        set_errno(-res);
+        return -1;
+    }
+    return res;
+}
+
+// 等待非阻塞connect完成(socket可写)后取SO_ERROR
+static int wait_connect(CXS::IOManager *iom, int sockfd, uint64_t timeout_ms) {
+    CXS::Timer::ptr timer;
+
+    std::shared_ptr<CXS::timer_info> tinfo(new CXS::timer_info);
+    std::weak_ptr<CXS::timer_info> winfo(tinfo);
+
+    if (timeout_ms != (uint64_t)-1) {
+        timer = iom->addConditionTImer(
+            timeout_ms, [winfo, sockfd, iom]() {
+                auto t = winfo.lock();
+                if (!t || t->cancelled) {
+                    return;
+                }
+                t->cancelled = ETIMEDOUT;
+                iom->cancelEvent(sockfd, CXS::IOManager::WRITE);
+            },
+            winfo);
+    }
+
+    int rt = iom->addEvent(sockfd, CXS::IOManager::WRITE);
+    if (rt == 0) {
+        CXS::Fiber::YieldToHold();
+        if (timer) {
+            timer->cancel();
+        }
+        if (tinfo->cancelled) {
+            CXS::set_errno(tinfo->cancelled);
+            return -1;
+        }
+    } else if (rt == 1) {
+        if (timer) {
+            timer->cancel();
+        }
+    } else {
+        if (timer) {
+            timer->cancel();
+        }
+        CXS_LOG_ERROR(g_logger) << "connect addEvent (" << sockfd << ") failed, errno = " << strerror(errno);
+    }
+    int error = 0;
+    socklen_t len = sizeof(int);
+    if (-1 == getsockopt(sockfd, SOL_SOCKET, SO_ERROR, &error, &len)) {
+        return -1;
+    }
+    if (!error) {
+        return 0;
+    } else {
+        CXS::set_errno(error);
+        return -1;
+    }
+}
+
+// io_uring后端的connect: 直接提交IORING_OP_CONNECT，
+// 内核对非阻塞socket不等待连接完成时，改为等待可写再取SO_ERROR
+// 提交失败时回退到epoll
+static int connect_with_uring(CXS::IOManager *iom, int sockfd, const struct sockaddr *addr,
+                              socklen_t addrlen, uint64_t timeout_ms) {
+    io_uring_sqe sqe;
+    memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode = IORING_OP_CONNECT;
+    sqe.fd = sockfd;
+    sqe.addr = (uint64_t)(uintptr_t)addr;
+    sqe.off = addrlen;
+    int res = iom->submitUring(sockfd, CXS::IOManager::WRITE, sqe, timeout_ms);
+    if (res == CXS::IOManager::URING_SUBMIT_FAILED) {
+        int n = connect_f(sockfd, addr, addrlen);
+        if (n == 0) {
+            return 0;
+        } else if (n != -1 || errno != EINPROGRESS) {
+            return n;
+        }
+        return wait_connect(iom, sockfd, timeout_ms);
+    }
+    if (res == -EINPROGRESS || res == -EALREADY || res == -EAGAIN) {
+        memset(&sqe, 0, sizeof(sqe));
+        sqe.opcode = IORING_OP_POLL_ADD;
+        sqe.fd = sockfd;
+        sqe.poll32_events = POLLOUT;
+        res = iom->submitUring(sockfd, CXS::IOManager::WRITE, sqe, timeout_ms);
+        if (res == CXS::IOManager::URING_SUBMIT_FAILED) {
+            return wait_connect(iom, sockfd, timeout_ms);
+        }
+        if (res >= 0) {
+            int error = 0;
+            socklen_t len = sizeof(int);
+            if (-1 == getsockopt(sockfd, SOL_SOCKET, SO_ERROR, &error, &len)) {
+                return -1;
+            }
+            res = -error;
+        }
+    }
+    if (res < 0) {
+        set_errno(-res);
+        return -1;
+    }
+    return 0;
+}
 } // namespace CXS
 
 extern "C" {
@@ -249,8 +413,36 @@ int socket(int domain, int type, int protocol) {
     return fd;
 }
 
+// 返回的fd带SOCK_NONBLOCK时直接登记为非阻塞socket，不再fstat和fcntl
+int accept4(int s, struct sockaddr *addr, socklen_t *addr_len, int flags) {
+    int fd = do_uring_io(
+        s, accept4_f, "accept4", CXS::IOManager::READ, SO_RCVTIMEO,
+        [addr, addr_len, flags](io_uring_sqe &sqe) {
+            sqe.opcode = IORING_OP_ACCEPT;
+            sqe.addr = (uint64_t)(uintptr_t)addr;
+            sqe.addr2 = (uint64_t)(uintptr_t)addr_len;
+            sqe.accept_flags = flags;
+        },
+        addr, addr_len, flags);
+    if (fd >= 0) {
+        if (flags & SOCK_NONBLOCK) {
+            CXS::FdMgr::GetInstance()->addNonblockSocket(fd);
+        } else {
+            CXS::FdMgr::GetInstance()->get(fd, true);
+        }
+    }
+    return fd;
+}
+
 int accept(int s, struct sockaddr *addr, socklen_t *addr_len) {
-    int fd = do_io(s, accept_f, "accept", CXS::IOManager::READ, SO_RCVTIMEO, addr, addr_len);
+    int fd = do_uring_io(
+        s, accept_f, "accept", CXS::IOManager::READ, SO_RCVTIMEO,
+        [addr, addr_len](io_uring_sqe &sqe) {
+            sqe.opcode = IORING_OP_ACCEPT;
+            sqe.addr = (uint64_t)(uintptr_t)addr;
+            sqe.addr2 = (uint64_t)(uintptr_t)addr_len;
+        },
+        addr, addr_len);
     if (fd >= 0) {
         CXS::FdMgr::GetInstance()->get(fd, true);
     }
@@ -273,6 +465,11 @@ int connect_with_timeout(int sockfd, const struct sockaddr *addr, socklen_t addr
         return connect_f(sockfd, addr, addrlen);
     }
 
+    CXS::IOManager *uring_iom = CXS::IOManager::GetThis();
+    if (uring_iom && uring_iom->hasUring()) {
+        return CXS::connect_with_uring(uring_iom, sockfd, addr, addrlen, timeout_ms);
+    }
+
     int n = connect_f(sockfd, addr, addrlen);
 
     if (n == 0) {
@@ -281,52 +478,7 @@ int connect_with_timeout(int sockfd, const struct sockaddr *addr, socklen_t addr
         return n;
     }
 
-    CXS::IOManager *iom = CXS::IOManager::GetThis();
-    CXS::Timer::ptr timer;
-
-    std::shared_ptr<CXS::timer_info> tinfo(new CXS::timer_info);
-    std::weak_ptr<CXS::timer_info> winfo(tinfo);
-
-    if (timeout_ms != (uint64_t)-1) {
-        timer = iom->addConditionTImer(
-            timeout_ms, [winfo, sockfd, iom]() {
-                auto t = winfo.lock();
-                if (!t || t->cancelled) {
-                    return;
-                }
-                t->cancelled = ETIMEDOUT;
-                iom->cancelEvent(sockfd, CXS::IOManager::WRITE);
-            },
-            winfo);
-    }
-
-    int rt = iom->addEvent(sockfd, CXS::IOManager::WRITE);
-    if (rt == 0) {
-        CXS::Fiber::YieldToHold();
-        if (timer) {
-            timer->cancel();
-        }
-        if (tinfo->cancelled) {
-            errno = tinfo->cancelled;
-            return -1;
-        }
-    } else {
-        if (timer) {
-            timer->cancel();
-        }
-        CXS_LOG_ERROR(g_logger) << "connect addEvent (" << sockfd << ") failed, errno = " << strerror(errno);
-    }
-    int error = 0;
-    socklen_t len = sizeof(int);
-    if (-1 == getsockopt(sockfd, SOL_SOCKET, SO_ERROR, &error, &len)) {
-        return -1;
-    }
-    if (!error) {
-        return 0;
-    } else {
-        errno = error;
-        return -1;
-    }
+    return CXS::wait_connect(CXS::IOManager::GetThis(), sockfd, timeout_ms);
 }
 
 int connect(int sockfd, const struct sockaddr *addr, socklen_t addrlen) {
@@ -334,15 +486,38 @@ int connect(int sockfd, const struct sockaddr *addr, socklen_t addrlen) {
 }
 
 ssize_t read(int fd, void *buf, size_t count) {
-    return do_io(fd, read_f, "read", CXS::IOManager::READ, SO_RCVTIMEO, buf, count);
+    return do_uring_io(
+        fd, read_f, "read", CXS::IOManager::READ, SO_RCVTIMEO,
+        [buf, count](io_uring_sqe &sqe) {
+            sqe.opcode = IORING_OP_RECV;
+            sqe.addr = (uint64_t)(uintptr_t)buf;
+            sqe.len = count;
+        },
+        buf, count);
 }
 
 ssize_t readv(int fd, const struct iovec *iov, int iovcnt) {
-    return do_io(fd, readv_f, "readv", CXS::IOManager::READ, SO_RCVTIMEO, iov, iovcnt);
+    return do_uring_io(
+        fd, readv_f, "readv", CXS::IOManager::READ, SO_RCVTIMEO,
+        [iov, iovcnt](io_uring_sqe &sqe) {
+            sqe.opcode = IORING_OP_READV;
+            sqe.addr = (uint64_t)(uintptr_t)iov;
+            sqe.len = iovcnt;
+            sqe.off = (uint64_t)-1;
+        },
+        iov, iovcnt);
 }
 
 ssize_t recv(int sockfd, void *buf, size_t len, int flags) {
-    return do_io(sockfd, recv_f, "recv", CXS::IOManager::READ, SO_RCVTIMEO, buf, len, flags);
+    return do_uring_io(
+        sockfd, recv_f, "recv", CXS::IOManager::READ, SO_RCVTIMEO,
+        [buf, len, flags](io_uring_sqe &sqe) {
+            sqe.opcode = IORING_OP_RECV;
+            sqe.addr = (uint64_t)(uintptr_t)buf;
+            sqe.len = len;
+            sqe.msg_flags = flags;
+        },
+        buf, len, flags);
 }
 
 ssize_t recvfrom(int sockfd, void *buf, size_t len, int flags, struct sockaddr *src_addr, socklen_t *addrlen) {
@@ -350,34 +525,73 @@ ssize_t recvfrom(int sockfd, void *buf, size_t len, int flags, struct sockaddr *
 }
 
 ssize_t recvmsg(int sockfd, struct msghdr *msg, int flags) {
-    return do_io(sockfd, recvmsg_f, "recvmsg", CXS::IOManager::READ, SO_RCVTIMEO, msg, flags);
+    return do_uring_io(
+        sockfd, recvmsg_f, "recvmsg", CXS::IOManager::READ, SO_RCVTIMEO,
+        [msg, flags](io_uring_sqe &sqe) {
+            sqe.opcode = IORING_OP_RECVMSG;
+            sqe.addr = (uint64_t)(uintptr_t)msg;
+            sqe.msg_flags = flags;
+        },
+        msg, flags);
 }
 ssize_t write(int fd, const void *buf, size_t n) {
-    return do_io(fd, write_f, "write", CXS::IOManager::WRITE, SO_SNDTIMEO, buf, n);
+    return do_uring_io(
+        fd, write_f, "write", CXS::IOManager::WRITE, SO_SNDTIMEO,
+        [buf, n](io_uring_sqe &sqe) {
+            sqe.opcode = IORING_OP_SEND;
+            sqe.addr = (uint64_t)(uintptr_t)buf;
+            sqe.len = n;
+        },
+        buf, n);
 }
 ssize_t writev(int fd, const struct iovec *iov, int iovcnt) {
-    return do_io(fd, writev_f, "writev", CXS::IOManager::WRITE, SO_SNDTIMEO, iov, iovcnt);
+    return do_uring_io(
+        fd, writev_f, "writev", CXS::IOManager::WRITE, SO_SNDTIMEO,
+        [iov, iovcnt](io_uring_sqe &sqe) {
+            sqe.opcode = IORING_OP_WRITEV;
+            sqe.addr = (uint64_t)(uintptr_t)iov;
+            sqe.len = iovcnt;
+            sqe.off = (uint64_t)-1;
+        },
+        iov, iovcnt);
 }
 ssize_t send(int sockfd, const void *buf, size_t len, int flags) {
-    return do_io(sockfd, send_f, "send", CXS::IOManager::WRITE, SO_SNDTIMEO, buf, len, flags);
+    return do_uring_io(
+        sockfd, send_f, "send", CXS::IOManager::WRITE, SO_SNDTIMEO,
+        [buf, len, flags](io_uring_sqe &sqe) {
+            sqe.opcode = IORING_OP_SEND;
+            sqe.addr = (uint64_t)(uintptr_t)buf;
+            sqe.len = len;
+            sqe.msg_flags = flags;
+        },
+        buf, len, flags);
 }
 ssize_t sendto(int sockfd, const void *buf, size_t len, int flags, const struct sockaddr *dest_addr, socklen_t addrlen) {
     return do_io(sockfd, sendto_f, "sendto", CXS::IOManager::WRITE, SO_SNDTIMEO, buf, len, flags, dest_addr, addrlen);
 }
 ssize_t sendmsg(int sockfd, const struct msghdr *msg, int flags) {
-    return do_io(sockfd, sendmsg_f, "sendmsg", CXS::IOManager::WRITE, SO_SNDTIMEO, msg, flags);
+    return do_uring_io(
+        sockfd, sendmsg_f, "sendmsg", CXS::IOManager::WRITE, SO_SNDTIMEO,
+        [msg, flags](io_uring_sqe &sqe) {
+            sqe.opcode = IORING_OP_SENDMSG;
+            sqe.addr = (uint64_t)(uintptr_t)msg;
+            sqe.msg_flags = flags;
+        },
+        msg, flags);
+}
+// io_uring没有对应的sendfile操作，走epoll等待可写
+ssize_t sendfile(int out_fd, int in_fd, off_t *offset, size_t count) {
+    return do_io(out_fd, sendfile_f, "sendfile", CXS::IOManager::WRITE, SO_SNDTIMEO, in_fd, offset, count);
 }
 
 int close(int fd) {
-    if (!CXS::t_hook_enable) {
-        return close_f(fd);
-    }
     CXS::FdCtx::ptr ctx = CXS::FdMgr::GetInstance()->get(fd);
     if (ctx) {
-        auto iom = CXS::IOManager::GetThis();
+        auto iom = CXS::t_hook_enable ? CXS::IOManager::GetThis() : nullptr;
         if (iom) {
             iom->cancelAll(fd);
         }
+        // 不论是否hook都要删除，fd复用后其他IOManager凭代数变化发现持久注册已失效
         CXS::FdMgr::GetInstance()->del(fd);
     }
     return close_f(fd);
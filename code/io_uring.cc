@@ -0,0 +1,220 @@
+#include "io_uring.h"
+#include "log.h"
+#include "macro.h"
+#include <algorithm>
+#include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#define CXS_HAVE_IO_URING 1
+#endif
+#endif
+
+namespace CXS {
+
+static CXS::Logger::ptr g_logger = CXS_LOG_NAME("system");
+
+// 提交队列空间不足时进入内核刷出残留sqe的最多次数，仍不足则提交失败，由调用方回退到epoll
+static const int MAX_FLUSH_RETRIES = 4;
+
+#ifdef CXS_HAVE_IO_URING
+
+IOUring *IOUring::Create(uint32_t entries) {
+    IOUring *ring = new IOUring;
+    if (!ring->init(entries)) {
+        delete ring;
+        return nullptr;
+    }
+    return ring;
+}
+
+bool IOUring::init(uint32_t entries) {
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    m_fd = syscall(__NR_io_uring_setup, entries, &params);
+    if (m_fd < 0) {
+        CXS_LOG_WARN(g_logger) << "io_uring_setup entries=" << entries << " errno=" << errno
+                               << " errstr=" << strerror(errno);
+        return false;
+    }
+
+    m_sqRingSize = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+    m_cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single_mmap) {
+        m_sqRingSize = m_cqRingSize = std::max(m_sqRingSize, m_cqRingSize);
+    }
+
+    m_sqRing = mmap(nullptr, m_sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQ_RING);
+    if (m_sqRing == MAP_FAILED) {
+        m_sqRing = nullptr;
+        CXS_LOG_WARN(g_logger) << "io_uring mmap sq ring errno=" << errno << " errstr=" << strerror(errno);
+        return false;
+    }
+    if (single_mmap) {
+        m_cqRing = m_sqRing;
+    } else {
+        m_cqRing = mmap(nullptr, m_cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_CQ_RING);
+        if (m_cqRing == MAP_FAILED) {
+            m_cqRing = nullptr;
+            CXS_LOG_WARN(g_logger) << "io_uring mmap cq ring errno=" << errno << " errstr=" << strerror(errno);
+            return false;
+        }
+    }
+    m_sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    void *sqes = mmap(nullptr, m_sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        CXS_LOG_WARN(g_logger) << "io_uring mmap sqes errno=" << errno << " errstr=" << strerror(errno);
+        return false;
+    }
+    m_sqes = (io_uring_sqe *)sqes;
+
+    char *sq = (char *)m_sqRing;
+    m_sqHead = (uint32_t *)(sq + params.sq_off.head);
+    m_sqTail = (uint32_t *)(sq + params.sq_off.tail);
+    m_sqMask = (uint32_t *)(sq + params.sq_off.ring_mask);
+    m_sqFlags = (uint32_t *)(sq + params.sq_off.flags);
+    m_sqArray = (uint32_t *)(sq + params.sq_off.array);
+    m_sqEntries = params.sq_entries;
+
+    char *cq = (char *)m_cqRing;
+    m_cqHead = (uint32_t *)(cq + params.cq_off.head);
+    m_cqTail = (uint32_t *)(cq + params.cq_off.tail);
+    m_cqMask = (uint32_t *)(cq + params.cq_off.ring_mask);
+    m_cqes = cq + params.cq_off.cqes;
+    return true;
+}
+
+IOUring::~IOUring() {
+    if (m_sqes) {
+        munmap(m_sqes, m_sqesSize);
+    }
+    if (m_cqRing && m_cqRing != m_sqRing) {
+        munmap(m_cqRing, m_cqRingSize);
+    }
+    if (m_sqRing) {
+        munmap(m_sqRing, m_sqRingSize);
+    }
+    if (m_fd >= 0) {
+        close(m_fd);
+    }
+}
+
+int IOUring::enter(uint32_t to_submit, uint32_t min_complete, uint32_t flags) {
+    return syscall(__NR_io_uring_enter, m_fd, to_submit, min_complete, flags, nullptr, 0);
+}
+
+bool IOUring::submit(const io_uring_sqe *sqes, size_t count) {
+    CXS_ASSERT2(count <= m_sqEntries, "io_uring submit count exceeds sq entries");
+    Mutex::Lock lock(m_submitMutex);
+    uint32_t tail = *m_sqTail;
+    // 没有SQPOLL，提交队列只在本函数内由内核同步消费，剩余空间不足时先把残留的提交掉
+    // 完成队列溢出时内核返回EBUSY，要等收割后才能恢复，不在这里忙等
+    int retries = 0;
+    while (tail - __atomic_load_n(m_sqHead, __ATOMIC_ACQUIRE) + count > m_sqEntries) {
+        if (retries++ >= MAX_FLUSH_RETRIES) {
+            CXS_LOG_WARN(g_logger) << "io_uring submission queue full, pending="
+                                   << tail - __atomic_load_n(m_sqHead, __ATOMIC_ACQUIRE);
+            return false;
+        }
+        int rt = enter(tail - __atomic_load_n(m_sqHead, __ATOMIC_ACQUIRE), 0, 0);
+        if (rt < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+            CXS_LOG_ERROR(g_logger) << "io_uring_enter errno=" << errno << " errstr=" << strerror(errno);
+            return false;
+        }
+    }
+    uint32_t start = tail;
+    for (size_t i = 0; i < count; ++i) {
+        uint32_t index = tail & *m_sqMask;
+        m_sqes[index] = sqes[i];
+        m_sqArray[index] = index;
+        ++tail;
+    }
+    __atomic_store_n(m_sqTail, tail, __ATOMIC_RELEASE);
+
+    while (true) {
+        uint32_t to_submit = tail - __atomic_load_n(m_sqHead, __ATOMIC_ACQUIRE);
+        if (to_submit == 0) {
+            break;
+        }
+        int rt = enter(to_submit, 0, 0);
+        if (rt > 0 || (rt < 0 && errno == EINTR)) {
+            continue;
+        }
+        if (rt < 0) {
+            if (errno == EAGAIN || errno == EBUSY) {
+                // 完成队列溢出或内核资源不足
+                CXS_LOG_WARN(g_logger) << "io_uring_enter busy errno=" << errno << " pending=" << to_submit;
+            } else {
+                CXS_LOG_ERROR(g_logger) << "io_uring_enter errno=" << errno << " errstr=" << strerror(errno);
+            }
+        }
+        if ((int32_t)(__atomic_load_n(m_sqHead, __ATOMIC_ACQUIRE) - start) > 0) {
+            // 本次的sqe已有一部分被内核取走，剩下的留在队列中由下次提交带上，完成时照常唤醒
+            break;
+        }
+        // 本次的sqe一个都没被内核取走，撤回，调用方据此认为提交失败，不会等待完成事件
+        // 没有其他地方会再提交它们，留在队列中等待的协程永远不会被唤醒
+        // 排在前面的残留sqe属于其他仍在等待的操作，保留
+        __atomic_store_n(m_sqTail, start, __ATOMIC_RELEASE);
+        return false;
+    }
+    return true;
+}
+
+size_t IOUring::reap(Completion *out, size_t max) {
+    Spinlock::Lock lock(m_reapMutex);
+    if (__atomic_load_n(m_sqFlags, __ATOMIC_RELAXED) & IORING_SQ_CQ_OVERFLOW) {
+        // 内核暂存了溢出的完成事件，需要进入内核刷回完成队列
+        enter(0, 0, IORING_ENTER_GETEVENTS);
+    }
+    uint32_t head = *m_cqHead;
+    uint32_t tail = __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE);
+    size_t n = 0;
+    io_uring_cqe *cqes = (io_uring_cqe *)m_cqes;
+    while (head != tail && n < max) {
+        io_uring_cqe &cqe = cqes[head & *m_cqMask];
+        out[n].user_data = cqe.user_data;
+        out[n].res = cqe.res;
+        ++n;
+        ++head;
+    }
+    __atomic_store_n(m_cqHead, head, __ATOMIC_RELEASE);
+    return n;
+}
+
+#else
+
+IOUring *IOUring::Create(uint32_t entries) {
+    CXS_LOG_WARN(g_logger) << "io_uring not supported on this platform";
+    return nullptr;
+}
+
+bool IOUring::init(uint32_t entries) {
+    return false;
+}
+
+IOUring::~IOUring() {
+}
+
+int IOUring::enter(uint32_t to_submit, uint32_t min_complete, uint32_t flags) {
+    errno = ENOSYS;
+    return -1;
+}
+
+bool IOUring::submit(const io_uring_sqe *sqes, size_t count) {
+    return false;
+}
+
+size_t IOUring::reap(Completion *out, size_t max) {
+    return 0;
+}
+
+#endif
+
+} // namespace CXS
@@ -0,0 +1,73 @@
+#ifndef __CXS_IO_URING_H__
+#define __CXS_IO_URING_H__
+
+#include "thread.h"
+#include <memory>
+#include <stddef.h>
+#include <stdint.h>
+
+struct io_uring_sqe;
+
+namespace CXS {
+
+// io_uring 提交/完成队列的最小封装(直接使用系统调用，不依赖liburing)
+// 只负责把sqe放入提交队列和从完成队列取出结果，协程的挂起和唤醒由IOManager完成
+class IOUring {
+public:
+    typedef std::unique_ptr<IOUring> ptr;
+
+    // 完成事件
+    struct Completion {
+        uint64_t user_data;
+        int32_t res;
+    };
+
+    // 创建io_uring实例，内核不支持时返回nullptr
+    static IOUring *Create(uint32_t entries);
+    ~IOUring();
+
+    // 用于加入epoll，有完成事件时可读
+    int getFd() const { return m_fd; }
+
+    // 把count个sqe(可以通过IOSQE_IO_LINK链接)放入提交队列并提交给内核
+    // count不能超过提交队列长度；内核一个都没有取走(出错、EAGAIN/EBUSY或队列满)时返回false，
+    // 此时这些sqe不在提交队列中，不会产生完成事件
+    bool submit(const io_uring_sqe *sqes, size_t count);
+
+    // 取出最多max个完成事件，返回取出的数量
+    size_t reap(Completion *out, size_t max);
+
+private:
+    IOUring() {}
+    bool init(uint32_t entries);
+    int enter(uint32_t to_submit, uint32_t min_complete, uint32_t flags);
+
+private:
+    int m_fd = -1;
+    // 提交队列
+    void *m_sqRing = nullptr;
+    size_t m_sqRingSize = 0;
+    io_uring_sqe *m_sqes = nullptr;
+    size_t m_sqesSize = 0;
+    uint32_t *m_sqHead = nullptr;
+    uint32_t *m_sqTail = nullptr;
+    uint32_t *m_sqMask = nullptr;
+    uint32_t *m_sqFlags = nullptr;
+    uint32_t *m_sqArray = nullptr;
+    uint32_t m_sqEntries = 0;
+    // 完成队列
+    void *m_cqRing = nullptr;
+    size_t m_cqRingSize = 0;
+    uint32_t *m_cqHead = nullptr;
+    uint32_t *m_cqTail = nullptr;
+    uint32_t *m_cqMask = nullptr;
+    void *m_cqes = nullptr;
+
+    // 提交时可能进入内核，使用互斥锁
+    Mutex m_submitMutex;
+    Spinlock m_reapMutex;
+};
+
+} // namespace CXS
+
+#endif
@@ -5,14 +5,39 @@
 #include <errno.h>
 #include <string>
 #include <memory>
+#include <algorithm>
 
 #include "macro.h"
 #include "log.h"
+#include "config.hpp"
+#include "util.h"
 #include "iomanager.h"
+#include "fd_manager.h"
+#include "io_uring.h"
+#include <linux/io_uring.h>
 namespace CXS
 {
     static CXS::Logger::ptr g_logger = CXS_LOG_NAME("system");
 
+    static ConfigVar<std::string>::ptr g_iomanager_backend =
+        Config::Lookup<std::string>("iomanager.backend", "epoll", "iomanager backend: epoll or io_uring");
+    static ConfigVar<bool>::ptr g_iomanager_persistent_events =
+        Config::Lookup<bool>("iomanager.persistent_events", false, "register fds once with EPOLLIN|EPOLLOUT|EPOLLET and track readiness");
+    // 忙时轮询默认关闭。任务队列可能长时间不空(CPU密集的回调多)时打开，例如:
+    // iomanager:
+    //   busy_poll:
+    //     tasks: 64
+    //     us: 500
+    static ConfigVar<uint32_t>::ptr g_iomanager_busy_poll_tasks =
+        Config::Lookup<uint32_t>("iomanager.busy_poll.tasks", 0, "poll io and timers after this many tasks without idling, 0 to disable");
+    static ConfigVar<uint64_t>::ptr g_iomanager_busy_poll_us =
+        Config::Lookup<uint64_t>("iomanager.busy_poll.us", 0, "poll io and timers after this many microseconds without idling, 0 to disable");
+    static ConfigVar<uint32_t>::ptr g_io_uring_entries =
+        Config::Lookup<uint32_t>("iomanager.io_uring.entries", 1024, "io_uring submission queue entries");
+
+    // 不需要处理完成事件的sqe(链接的超时、取消请求)使用的user_data
+    static const uint64_t URING_IGNORE = 1;
+
     // epoll use
     // epoll_create创建epoll实例
     // epoll_ctl
@@ -21,6 +46,8 @@ namespace CXS
     {
         m_epfd = epoll_create(5000);
         CXS_ASSERT(m_epfd > 0);
+        m_persistentEvents = g_iomanager_persistent_events->getValue();
+        setBusyPoll(g_iomanager_busy_poll_tasks->getValue(), g_iomanager_busy_poll_us->getValue());
 
         int rt = pipe(m_tickleFds);
         CXS_ASSERT(!rt);
@@ -36,6 +63,28 @@ namespace CXS
         rt = epoll_ctl(m_epfd, EPOLL_CTL_ADD, m_tickleFds[0], &event);
         CXS_ASSERT(!rt);
 
+        if (g_iomanager_backend->getValue() == "io_uring")
+        {
+            m_uring.reset(IOUring::Create(g_io_uring_entries->getValue()));
+            if (m_uring)
+            {
+                // 完成队列有事件时io_uring的fd可读，由idle统一收割
+                memset(&event, 0, sizeof(epoll_event));
+                event.events = EPOLLIN | EPOLLET;
+                event.data.fd = m_uring->getFd();
+                rt = epoll_ctl(m_epfd, EPOLL_CTL_ADD, m_uring->getFd(), &event);
+                if (rt)
+                {
+                    CXS_LOG_WARN(g_logger) << "epoll_ctl io_uring fd errno=" << errno << " errstr=" << strerror(errno);
+                    m_uring.reset();
+                }
+            }
+            if (!m_uring)
+            {
+                CXS_LOG_WARN(g_logger) << "name=" << name << " io_uring unavailable, fallback to epoll";
+            }
+        }
+
         contextResize(32);
 
         start();
@@ -75,12 +124,23 @@ namespace CXS
         ctx.cb = nullptr;
     }
 
-    void IOManager::FdContext::triggerEvent(Event event)
+    void IOManager::FdContext::triggerEvent(Event event, TaskBatch *batch)
     {
         CXS_ASSERT(events & event);
         events = (Event)(events & ~event);
         EventContext &ctx = getContext(event);
-        if (ctx.cb)
+        if (batch)
+        {
+            if (ctx.cb)
+            {
+                batch->add(ctx.scheduler, &ctx.cb);
+            }
+            else
+            {
+                batch->add(ctx.scheduler, &ctx.fiber);
+            }
+        }
+        else if (ctx.cb)
         {
             ctx.scheduler->schedule(&ctx.cb);
         }
@@ -92,6 +152,31 @@ namespace CXS
         return;
     }
 
+    std::vector<Scheduler::FiberAndThread> &IOManager::TaskBatch::get(Scheduler *scheduler)
+    {
+        // 目标调度器通常只有一两个，线性查找即可
+        for (auto &i : groups)
+        {
+            if (i.first == scheduler)
+            {
+                return i.second;
+            }
+        }
+        groups.emplace_back(scheduler, std::vector<Scheduler::FiberAndThread>());
+        return groups.back().second;
+    }
+
+    void IOManager::TaskBatch::submit()
+    {
+        for (auto &i : groups)
+        {
+            if (!i.second.empty())
+            {
+                i.first->schedule(i.second);
+            }
+        }
+    }
+
     void IOManager::contextResize(size_t size)
     {
         m_fdContexts.resize(size);
@@ -105,23 +190,55 @@ namespace CXS
             }
         }
     }
-    // 1 success|| 0 retry ||-1 error
-    int IOManager::addEvent(int fd, Event event, std::function<void()> cb)
+    IOManager::FdContext *IOManager::getFdContext(int fd)
     {
-        FdContext *fd_ctx = nullptr;
         RWMutexType::ReadLock lock(m_mutex);
         if ((int)m_fdContexts.size() > fd)
         {
-            fd_ctx = m_fdContexts[fd];
-            lock.unlock();
+            return m_fdContexts[fd];
         }
-        else
+        lock.unlock();
+        RWMutexType::WriteLock lock2(m_mutex);
+        if ((int)m_fdContexts.size() <= fd)
         {
-            lock.unlock();
-            RWMutexType::WriteLock lock2(m_mutex);
             contextResize(fd * 1.5);
-            fd_ctx = m_fdContexts[fd];
         }
+        return m_fdContexts[fd];
+    }
+
+    void IOManager::setExclusive(int fd)
+    {
+        FdContext *fd_ctx = getFdContext(fd);
+        FdContext::MutexType::Lock lock(fd_ctx->mutex);
+        checkGeneration(fd_ctx);
+        fd_ctx->exclusive = true;
+    }
+
+    void IOManager::checkGeneration(FdContext *fd_ctx)
+    {
+        // 只在本IOManager上cancelAll才会清掉这些状态，fd在其他IOManager、普通线程上关闭时
+        // 本地的registered仍为true，fd复用后会跳过EPOLL_CTL_ADD，等待者永远等不到事件
+        uint64_t generation = FdMgr::GetInstance()->getGeneration(fd_ctx->fd);
+        if (generation == fd_ctx->generation)
+        {
+            return;
+        }
+        fd_ctx->registered = false;
+        fd_ctx->ready = NONE;
+        fd_ctx->exclusive = false;
+        fd_ctx->generation = generation;
+    }
+
+    int IOManager::epollCtl(int op, int fd, epoll_event *event)
+    {
+        ++m_epollCtlCount;
+        return epoll_ctl(m_epfd, op, fd, event);
+    }
+
+    // 0 success || 1 事件已就绪，调用方直接重试(仅持久注册模式下无回调时) || -1 error
+    int IOManager::addEvent(int fd, Event event, std::function<void()> cb)
+    {
+        FdContext *fd_ctx = getFdContext(fd);
 
         FdContext::MutexType::Lock lock2(fd_ctx->mutex);
 
@@ -133,19 +250,64 @@ namespace CXS
             CXS_ASSERT(!(fd_ctx->events & event));
         }
 
-        int op = fd_ctx->events ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
-        epoll_event epevent;
-        epevent.events = EPOLLET | fd_ctx->events | event;
-        epevent.data.ptr = fd_ctx;
+        if (m_persistentEvents)
+        {
+            checkGeneration(fd_ctx);
+            if (fd_ctx->ready & event)
+            {
+                // 上次边沿到达时没有等待者，调用方EAGAIN之后又有了新的就绪，不需要挂起
+                fd_ctx->ready = (Event)(fd_ctx->ready & ~event);
+                ++m_readyHits;
+                if (!cb)
+                {
+                    return 1;
+                }
+                Scheduler *scheduler = Scheduler::GetThis();
+                (scheduler ? scheduler : this)->schedule(&cb);
+                return 0;
+            }
+            if (!fd_ctx->registered)
+            {
+                epoll_event epevent;
+                epevent.events = EPOLLET | EPOLLIN | EPOLLOUT | (fd_ctx->exclusive ? EPOLLEXCLUSIVE : 0);
+                epevent.data.ptr = fd_ctx;
+                int rt = epollCtl(EPOLL_CTL_ADD, fd, &epevent);
+                if (rt && errno == EEXIST)
+                {
+                    // cancelAll后fd未关闭又重新等待
+                    rt = epollCtl(EPOLL_CTL_MOD, fd, &epevent);
+                }
+                if (rt)
+                {
+                    CXS_LOG_ERROR(g_logger) << "epoll_clt (" << m_epfd << ","
+                                            << EPOLL_CTL_ADD << "," << fd << "," << epevent.events << "),"
+                                            << rt << " ( " << errno << ") (" << strerror(errno) << ")";
+                    return -1;
+                }
+                fd_ctx->registered = true;
+            }
+        }
+        else
+        {
+            int op = fd_ctx->events ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+            epoll_event epevent;
+            epevent.events = EPOLLET | fd_ctx->events | event;
+            // EPOLLEXCLUSIVE只能在ADD时设置，监听socket只有读事件，触发后DEL，每次等待都是ADD
+            if (fd_ctx->exclusive && op == EPOLL_CTL_ADD)
+            {
+                epevent.events |= EPOLLEXCLUSIVE;
+            }
+            epevent.data.ptr = fd_ctx;
 
-        int rt = epoll_ctl(m_epfd, op, fd, &epevent);
+            int rt = epollCtl(op, fd, &epevent);
 
-        if (rt)
-        {
-            CXS_LOG_ERROR(g_logger) << "epoll_clt (" << m_epfd << ","
-                                    << op << "," << fd << "," << epevent.events << "),"
-                                    << rt << " ( " << errno << ") (" << strerror(errno) << ")";
-            return -1;
+            if (rt)
+            {
+                CXS_LOG_ERROR(g_logger) << "epoll_clt (" << m_epfd << ","
+                                        << op << "," << fd << "," << epevent.events << "),"
+                                        << rt << " ( " << errno << ") (" << strerror(errno) << ")";
+                return -1;
+            }
         }
 
         ++m_pendingEventCount;
@@ -181,18 +343,21 @@ namespace CXS
         }
 
         Event new_events = (Event)(fd_ctx->events & ~event);
-        int op = new_events ? EPOLL_CTL_MOD : EPOLL_CTL_DEL;
-        epoll_event epevent;
-        epevent.events = EPOLLET | new_events;
-        epevent.data.ptr = fd_ctx;
-
-        int rt = epoll_ctl(m_epfd, op, fd, &epevent);
-        if (rt)
+        if (!m_persistentEvents)
         {
-            CXS_LOG_ERROR(g_logger) << "epoll_clt (" << m_epfd << ","
-                                    << op << "," << fd << "," << epevent.events << "),"
-                                    << rt << " ( " << errno << ") (" << strerror(errno) << ")";
-            return false;
+            int op = new_events ? EPOLL_CTL_MOD : EPOLL_CTL_DEL;
+            epoll_event epevent;
+            epevent.events = EPOLLET | new_events;
+            epevent.data.ptr = fd_ctx;
+
+            int rt = epollCtl(op, fd, &epevent);
+            if (rt)
+            {
+                CXS_LOG_ERROR(g_logger) << "epoll_clt (" << m_epfd << ","
+                                        << op << "," << fd << "," << epevent.events << "),"
+                                        << rt << " ( " << errno << ") (" << strerror(errno) << ")";
+                return false;
+            }
         }
         fd_ctx->events = new_events;
         FdContext::EventContext &event_ctx = fd_ctx->getContext(event);
@@ -213,24 +378,28 @@ namespace CXS
         lock.unlock();
 
         FdContext::MutexType::Lock lock2(fd_ctx->mutex);
+        bool uring_cancelled = cancelUringOps(fd_ctx, event);
         if (!(fd_ctx->events & event))
         {
-            return false;
+            return uring_cancelled;
         }
 
-        Event new_events = (Event)(fd_ctx->events & ~event);
-        int op = new_events ? EPOLL_CTL_MOD : EPOLL_CTL_DEL;
-        epoll_event epevent;
-        epevent.events = EPOLLET | new_events;
-        epevent.data.ptr = fd_ctx;
-
-        int rt = epoll_ctl(m_epfd, op, fd, &epevent);
-        if (rt)
+        if (!m_persistentEvents)
         {
-            CXS_LOG_ERROR(g_logger) << "epoll_clt (" << m_epfd << ","
-                                    << op << "," << fd << "," << epevent.events << "),"
-                                    << rt << " ( " << errno << ") (" << strerror(errno) << ")";
-            return false;
+            Event new_events = (Event)(fd_ctx->events & ~event);
+            int op = new_events ? EPOLL_CTL_MOD : EPOLL_CTL_DEL;
+            epoll_event epevent;
+            epevent.events = EPOLLET | new_events;
+            epevent.data.ptr = fd_ctx;
+
+            int rt = epollCtl(op, fd, &epevent);
+            if (rt)
+            {
+                CXS_LOG_ERROR(g_logger) << "epoll_clt (" << m_epfd << ","
+                                        << op << "," << fd << "," << epevent.events << "),"
+                                        << rt << " ( " << errno << ") (" << strerror(errno) << ")";
+                return false;
+            }
         }
         fd_ctx->triggerEvent(event);
         --m_pendingEventCount;
@@ -248,23 +417,31 @@ namespace CXS
         lock.unlock();
 
         FdContext::MutexType::Lock lock2(fd_ctx->mutex);
+        bool uring_cancelled = cancelUringOps(fd_ctx, (Event)(READ | WRITE));
+        // cancelAll之后fd通常会被关闭，关闭时内核自动从epoll中移除，fd复用时需重新加入
+        fd_ctx->registered = false;
+        fd_ctx->ready = NONE;
+        fd_ctx->exclusive = false;
         if (!fd_ctx->events)
         {
-            return false;
+            return uring_cancelled;
         }
 
-        int op = EPOLL_CTL_DEL;
-        epoll_event epevent;
-        epevent.events = 0;
-        epevent.data.ptr = fd_ctx;
-
-        int rt = epoll_ctl(m_epfd, op, fd, &epevent);
-        if (rt)
+        if (!m_persistentEvents)
         {
-            CXS_LOG_ERROR(g_logger) << "epoll_clt (" << m_epfd << ","
-                                    << op << "," << fd << "," << epevent.events << "),"
-                                    << rt << " ( " << errno << ") (" << strerror(errno) << ")";
-            return false;
+            int op = EPOLL_CTL_DEL;
+            epoll_event epevent;
+            epevent.events = 0;
+            epevent.data.ptr = fd_ctx;
+
+            int rt = epollCtl(op, fd, &epevent);
+            if (rt)
+            {
+                CXS_LOG_ERROR(g_logger) << "epoll_clt (" << m_epfd << ","
+                                        << op << "," << fd << "," << epevent.events << "),"
+                                        << rt << " ( " << errno << ") (" << strerror(errno) << ")";
+                return false;
+            }
         }
 
         if (fd_ctx->events & READ)
@@ -281,6 +458,129 @@ namespace CXS
         return true;
     }
 
+    int IOManager::submitUring(int fd, Event event, io_uring_sqe &sqe, uint64_t timeout_ms)
+    {
+        CXS_ASSERT(m_uring);
+        FdContext *fd_ctx = getFdContext(fd);
+
+        // 操作对象放在协程栈上，完成事件被收割前协程不会返回
+        UringOp op;
+        op.scheduler = Scheduler::GetThis();
+        op.fiber = Fiber::GetThis();
+        op.event = event;
+
+        io_uring_sqe sqes[2];
+        size_t count = 1;
+        sqes[0] = sqe;
+        sqes[0].user_data = (uint64_t)(uintptr_t)&op;
+        // 链接超时在提交时由内核拷贝，放在栈上即可
+        __kernel_timespec ts;
+        if (timeout_ms != ~0ull)
+        {
+            ts.tv_sec = timeout_ms / 1000;
+            ts.tv_nsec = (timeout_ms % 1000) * 1000 * 1000;
+            sqes[0].flags |= IOSQE_IO_LINK;
+            memset(&sqes[1], 0, sizeof(io_uring_sqe));
+            sqes[1].opcode = IORING_OP_LINK_TIMEOUT;
+            sqes[1].fd = -1;
+            sqes[1].addr = (uint64_t)(uintptr_t)&ts;
+            sqes[1].len = 1;
+            sqes[1].user_data = URING_IGNORE;
+            count = 2;
+        }
+
+        {
+            FdContext::MutexType::Lock lock(fd_ctx->mutex);
+            if (!m_uring->submit(sqes, count))
+            {
+                return URING_SUBMIT_FAILED;
+            }
+            fd_ctx->uring_ops.push_back(&op);
+            ++m_pendingEventCount;
+        }
+
+        Fiber::YieldToHold();
+
+        {
+            FdContext::MutexType::Lock lock(fd_ctx->mutex);
+            auto &ops = fd_ctx->uring_ops;
+            ops.erase(std::find(ops.begin(), ops.end(), &op));
+        }
+        if (op.res == -ECANCELED && !op.cancelled && timeout_ms != ~0ull)
+        {
+            return -ETIMEDOUT;
+        }
+        return op.res;
+    }
+
+    // 调用方持有fd_ctx->mutex
+    bool IOManager::cancelUringOps(FdContext *fd_ctx, Event event)
+    {
+        if (!m_uring || fd_ctx->uring_ops.empty())
+        {
+            return false;
+        }
+        std::vector<io_uring_sqe> sqes;
+        for (auto op : fd_ctx->uring_ops)
+        {
+            if (!(op->event & event) || op->cancelled)
+            {
+                continue;
+            }
+            op->cancelled = true;
+            io_uring_sqe sqe;
+            memset(&sqe, 0, sizeof(sqe));
+            sqe.opcode = IORING_OP_ASYNC_CANCEL;
+            sqe.fd = -1;
+            sqe.addr = (uint64_t)(uintptr_t)op;
+            sqe.user_data = URING_IGNORE;
+            sqes.push_back(sqe);
+        }
+        if (sqes.empty())
+        {
+            return false;
+        }
+        return m_uring->submit(&sqes[0], sqes.size());
+    }
+
+    void IOManager::reapUring(TaskBatch &batch)
+    {
+        static const size_t MAX_COMPLETIONS = 64;
+        IOUring::Completion completions[MAX_COMPLETIONS];
+        while (true)
+        {
+            size_t n = m_uring->reap(completions, MAX_COMPLETIONS);
+            for (size_t i = 0; i < n; ++i)
+            {
+                if (completions[i].user_data == URING_IGNORE)
+                {
+                    continue;
+                }
+                UringOp *op = (UringOp *)(uintptr_t)completions[i].user_data;
+                op->res = completions[i].res;
+                Scheduler *scheduler = op->scheduler;
+                --m_pendingEventCount;
+                // 协程被唤醒后op随时可能失效，放入batch之后不能再访问
+                batch.add(scheduler, &op->fiber);
+            }
+            if (n < MAX_COMPLETIONS)
+            {
+                break;
+            }
+        }
+    }
+
+    IOManager::EventStats IOManager::getEventStats() const
+    {
+        EventStats stats;
+        stats.epoll_ctl = m_epollCtlCount;
+        stats.epoll_wait = m_epollWaitCount;
+        stats.ready_hits = m_readyHits;
+        stats.busy_poll = m_busyPollCount;
+        stats.tickles = m_tickleCount;
+        return stats;
+    }
+
     IOManager *IOManager::GetThis()
     {
         return dynamic_cast<IOManager *>(Scheduler::GetThis());
@@ -288,10 +588,12 @@ namespace CXS
 
     void IOManager::tickle()
     {
-        if (hasIdleThreads())
+        // 没有线程阻塞在epoll_wait上，不需要唤醒
+        if (!hasIdleThreads())
         {
             return;
         }
+        ++m_tickleCount;
         int rt = write(m_tickleFds[1], "T", 1);
         CXS_ASSERT(rt == 1);
     }
@@ -404,11 +706,117 @@ namespace CXS
     {
         tickle();
     }
+    void IOManager::collectTimers(TaskBatch &batch)
+    {
+        std::vector<std::function<void()>> cbs;
+        listExpiredTimer(cbs);
+        for (auto &cb : cbs)
+        {
+            batch.add(this, &cb);
+        }
+    }
+
+    bool IOManager::processEvents(epoll_event *events, int n, TaskBatch &batch)
+    {
+        bool tickled = false;
+        for (int i = 0; i < n; ++i)
+        {
+            epoll_event &event = events[i];
+            if (event.data.fd == m_tickleFds[0])
+            {
+                uint8_t dummy;
+                while (read(m_tickleFds[0], &dummy, 1) == 1)
+                    ;
+                tickled = true;
+                continue;
+            }
+            if (m_uring && event.data.fd == m_uring->getFd())
+            {
+                reapUring(batch);
+                continue;
+            }
+
+            FdContext *fd_ctx = (FdContext *)event.data.ptr;
+            FdContext::MutexType::Lock lock(fd_ctx->mutex);
+            if (event.events & (EPOLLERR | EPOLLHUP))
+            {
+                event.events |= EPOLLIN | EPOLLOUT;
+            }
+            int real_events = NONE;
+            if (event.events & EPOLLIN)
+            {
+                real_events |= READ;
+            }
+            if (event.events & EPOLLOUT)
+            {
+                real_events |= WRITE;
+            }
+
+            if (m_persistentEvents)
+            {
+                // 没有等待者的方向记下就绪状态，下次addEvent时直接返回
+                fd_ctx->ready = (Event)(fd_ctx->ready | (real_events & ~fd_ctx->events));
+            }
+            // EPOLLERR/EPOLLHUP会同时置上读写，只触发已注册的事件
+            real_events &= fd_ctx->events;
+            if (real_events == NONE)
+            {
+                continue;
+            }
+
+            if (!m_persistentEvents)
+            {
+                int left_events = (fd_ctx->events & ~real_events);
+                int op = left_events ? EPOLL_CTL_MOD : EPOLL_CTL_DEL;
+                event.events = EPOLLET | left_events;
+
+                int rt2 = epollCtl(op, fd_ctx->fd, &event);
+                if (rt2)
+                {
+                    CXS_LOG_ERROR(g_logger) << "epoll_ctl(" << m_epfd << ", "
+                                            << op << "," << fd_ctx->fd << "," << event.events << "):"
+                                            << rt2 << " (" << errno << ") (" << strerror(errno) << ")";
+                    continue;
+                }
+            }
+
+            if (real_events & READ)
+            {
+                fd_ctx->triggerEvent(READ, &batch);
+                --m_pendingEventCount;
+            }
+            if (real_events & WRITE)
+            {
+                fd_ctx->triggerEvent(WRITE, &batch);
+                --m_pendingEventCount;
+            }
+        }
+        return tickled;
+    }
+
+    void IOManager::busyPoll()
+    {
+        static thread_local epoll_event events[64];
+        ++m_busyPollCount;
+        ++m_epollWaitCount;
+        int rt = epoll_wait(m_epfd, events, 64, 0);
+        TaskBatch batch;
+        batch.now = GetCurrentUS();
+        collectTimers(batch);
+        // 忙线程取走了给空闲线程的tickle，再写一次，空闲线程仍能被唤醒来窃取任务
+        if (rt > 0 && processEvents(events, rt, batch) && hasIdleThreads())
+        {
+            tickle();
+        }
+        batch.submit();
+    }
+
     void IOManager::idle()
     {
         epoll_event *events = new epoll_event[64]();
         std::shared_ptr<epoll_event> shared_events(events, [](epoll_event *ptr)
                                                    { delete[] ptr; });
+        TaskBatch batch;
 
         while (true)
         {
@@ -417,6 +825,8 @@ namespace CXS
             if (stopping(next_timeout))
             {
                 CXS_LOG_INFO(g_logger) << "name=" << getName() << " idle stopping exit";
+                // stop()的tickle可能在其他线程进入epoll_wait之前就发出了，最后一个任务结束后依次唤醒它们退出
+                tickle();
                 break;
             }
 
@@ -432,7 +842,15 @@ namespace CXS
                 {
                     next_timeout = MAX_TIMEOUT;
                 }
+                // 进入idle前有任务被放入队列(此时调度方可能没看到空闲线程而没有tickle)，不阻塞
+                if (hasPendingTasks())
+                {
+                    next_timeout = 0;
+                }
+                ++m_epollWaitCount;
+                uint64_t wait_begin = GetCurrentUS();
                 rt = epoll_wait(m_epfd, events, 64, (int)next_timeout);
+                m_epollWaitTime.record(GetCurrentUS() - wait_begin);
                 if (rt < 0 && errno == EINTR)
                 {
                 }
@@ -441,72 +859,13 @@ namespace CXS
                     break;
                 }
             } while (true);
+            m_epollBatch.record(rt > 0 ? rt : 0);
 
-            std::vector<std::function<void()>> cbs;
-            listExpiredTimer(cbs);
-
-            if (!cbs.empty())
-            {
-                schedule(cbs.begin(), cbs.end());
-                cbs.clear();
-            }
-
-            for (int i = 0; i < rt; ++i)
-            {
-                epoll_event &event = events[i];
-                if (event.data.fd == m_tickleFds[0])
-                {
-                    uint8_t dummy;
-                    while (read(m_tickleFds[0], &dummy, 1) == 1)
-                        ;
-                    continue;
-                }
-
-                FdContext *fd_ctx = (FdContext *)event.data.ptr;
-                FdContext::MutexType::Lock lock(fd_ctx->mutex);
-                if (event.events & (EPOLLERR | EPOLLHUP))
-                {
-                    event.events |= EPOLLIN | EPOLLOUT;
-                }
-                int real_events = NONE;
-                if (event.events & EPOLLIN)
-                {
-                    real_events |= READ;
-                }
-                if (event.events & EPOLLOUT)
-                {
-                    real_events |= WRITE;
-                }
-
-                if ((fd_ctx->events & real_events) == NONE)
-                {
-                    continue;
-                }
-
-                int left_events = (fd_ctx->events & ~real_events);
-                int op = left_events ? EPOLL_CTL_MOD : EPOLL_CTL_DEL;
-                event.events = EPOLLET | left_events;
-
-                int rt2 = epoll_ctl(m_epfd, op, fd_ctx->fd, &event);
-                if (rt2)
-                {
-                    CXS_LOG_ERROR(g_logger) << "epoll_ctl(" << m_epfd << ", "
-                                            << op << "," << fd_ctx->fd << "," << event.events << "):"
-                                            << rt2 << " (" << errno << ") (" << strerror(errno) << ")";
-                    continue;
-                }
-
-                if (real_events & READ)
-                {
-                    fd_ctx->triggerEvent(READ);
-                    --m_pendingEventCount;
-                }
-                if (real_events & WRITE)
-                {
-                    fd_ctx->triggerEvent(WRITE);
-                    --m_pendingEventCount;
-                }
-            }
+            // 到期定时器和就绪事件唤醒的任务都先放入batch，处理完这一轮后每个调度器批量调度一次
+            batch.now = GetCurrentUS();
+            collectTimers(batch);
+            processEvents(events, rt, batch);
+            batch.submit();
 
             Fiber::ptr cur = Fiber::GetThis();
             auto raw_ptr = cur.get();
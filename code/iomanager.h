@@ -2,8 +2,14 @@
 #define __CXS_IOMANAGER_H__
 #include "timer.h"
 #include "scheduler.hpp"
+
+struct io_uring_sqe;
+struct epoll_event;
+
 namespace CXS
 {
+    class IOUring;
+
     class IOManager : public Scheduler,public TimerManager
     {
     public:
@@ -19,37 +25,100 @@ namespace CXS
             WRITE = 0x4,
         };
 
+        // submitUring提交失败的返回值，不在-errno的范围内
+        static const int URING_SUBMIT_FAILED = -4096;
+
     public:
+        // io_uring后端上的一次操作，挂在FdContext上以便cancelEvent/cancelAll取消
+        struct UringOp
+        {
+            Scheduler *scheduler = nullptr; // 完成后唤醒协程的scheduler
+            Fiber::ptr fiber;               // 等待完成的协程
+            Event event = NONE;             // 操作的读写方向
+            int res = 0;                    // 完成结果，负数为-errno
+            bool cancelled = false;         // 是否已被主动取消
+        };
+
+        // idle中一轮epoll_wait唤醒的协程和回调，按目标调度器分组，整批处理完后每个调度器只调度一次
+        struct TaskBatch
+        {
+            // 本轮epoll_wait返回的时间，记为任务的就绪时间
+            uint64_t now = 0;
+            std::vector<std::pair<Scheduler *, std::vector<Scheduler::FiberAndThread>>> groups;
+            std::vector<Scheduler::FiberAndThread> &get(Scheduler *scheduler);
+            // fc为Fiber::ptr*或std::function<void()>*，内容被移入batch
+            template <class FiberOrCb>
+            void add(Scheduler *scheduler, FiberOrCb fc)
+            {
+                std::vector<Scheduler::FiberAndThread> &tasks = get(scheduler);
+                tasks.emplace_back(fc, -1);
+                tasks.back().ready_us = now;
+            }
+            void submit();
+        };
+
         struct FdContext
         {
             typedef Mutex MutexType;
 
             struct EventContext
             {
-                Scheduler *scheduler;     // 事件执行的scheduler
-                Fiber::ptr fiber;         // 事件协程
-                std::function<void()> cb; // 事件回调函数
+                Scheduler *scheduler = nullptr; // 事件执行的scheduler
+                Fiber::ptr fiber;               // 事件协程
+                std::function<void()> cb;       // 事件回调函数
             };
             int fd = 0;         // 事件关联的句柄
             EventContext read;  // 读事件
             EventContext write; // 写事件
             EventContext &getContext(Event event);
             void resetContext(EventContext &ctx);
-            void triggerEvent(Event Event);
+            // batch不为空时唤醒的任务放入batch，由调用方统一调度
+            void triggerEvent(Event Event, TaskBatch *batch = nullptr);
             Event events = NONE; // 已注册的事件
+            Event ready = NONE;  // 持久注册模式下，边沿到达时没有等待者的就绪事件
+            bool registered = false; // 持久注册模式下是否已加入epoll
+            uint64_t generation = 0; // registered/ready/exclusive所属fd的FdCtx代数，不同说明fd已关闭并复用
+            bool exclusive = false;  // 加入epoll时带EPOLLEXCLUSIVE
+            std::vector<UringOp *> uring_ops; // 进行中的io_uring操作
             MutexType mutex;
         };
 
+        // 事件统计
+        struct EventStats
+        {
+            uint64_t epoll_ctl;  // epoll_ctl调用次数
+            uint64_t epoll_wait; // epoll_wait调用次数
+            uint64_t ready_hits; // 持久注册模式下addEvent时已就绪、无需挂起的次数
+            uint64_t busy_poll;  // 任务队列不空时忙时轮询的次数
+            uint64_t tickles;    // 写tickle管道唤醒空闲线程的次数
+        };
+
     public:
         IOManager(size_t threads = 1, bool use_caller = true, const std::string &name = "");
         ~IOManager();
 
-        // 1 success|| 0 retry ||-1 error
+        // 0 success || 1 事件已就绪，调用方直接重试(仅持久注册模式下无回调时) || -1 error
         int addEvent(int fd, Event event, std::function<void()> cb = nullptr);
         bool delEvent(int fd, Event event);
         bool cancelEvent(int fd, Event event);
 
         bool cancelAll(int fd);
+        // 之后fd加入epoll时带EPOLLEXCLUSIVE，多个IOManager等待同一个fd时事件到达只唤醒其中一个
+        // 只用于只等待读事件的监听socket，cancelAll后失效
+        void setExclusive(int fd);
+
+        // 是否启用了io_uring后端(iomanager.backend配置为io_uring且内核支持)
+        bool hasUring() const { return m_uring != nullptr; }
+        // 通过io_uring提交sqe并挂起当前协程直到完成，返回操作结果(负数为-errno)
+        // timeout_ms不为~0ull时链接一个超时，超时返回-ETIMEDOUT，被cancelEvent/cancelAll取消返回-ECANCELED
+        // 提交失败时操作没有交给内核，返回URING_SUBMIT_FAILED，调用方应回退到epoll
+        int submitUring(int fd, Event event, io_uring_sqe &sqe, uint64_t timeout_ms = ~0ull);
+
+        EventStats getEventStats() const;
+        // idle中每次epoll_wait返回的事件数
+        const Histogram &getEpollBatchSize() const { return m_epollBatch; }
+        // idle中每次epoll_wait阻塞的时间(微秒)
+        const Histogram &getEpollWaitTime() const { return m_epollWaitTime; }
 
         static IOManager *GetThis();
 
@@ -60,12 +129,35 @@ namespace CXS
         void idle() override;
         void contextResize(size_t size);
         void onTimerInsertedAtFront() override;
+        void busyPoll() override;
+    private:
+        FdContext *getFdContext(int fd);
+        int epollCtl(int op, int fd, epoll_event *event);
+        // fd在别处关闭并复用后，清掉上一个fd留下的持久注册状态，调用方持有fd_ctx->mutex
+        void checkGeneration(FdContext *fd_ctx);
+        bool cancelUringOps(FdContext *fd_ctx, Event event);
+        void reapUring(TaskBatch &batch);
+        // 到期定时器的回调放入batch
+        void collectTimers(TaskBatch &batch);
+        // 处理epoll_wait返回的n个事件，唤醒的任务放入batch，返回是否有tickle
+        bool processEvents(epoll_event *events, int n, TaskBatch &batch);
+
     private:
         int m_epfd = 0;
         int m_tickleFds[2];
         std::atomic<size_t> m_pendingEventCount = {0};
         RWMutexType m_mutex;
         std::vector<FdContext *> m_fdContexts;
+        std::unique_ptr<IOUring> m_uring;
+        // fd一次性以EPOLLIN|EPOLLOUT|EPOLLET加入epoll，之后不再MOD/DEL
+        bool m_persistentEvents = false;
+        std::atomic<uint64_t> m_epollCtlCount = {0};
+        std::atomic<uint64_t> m_epollWaitCount = {0};
+        std::atomic<uint64_t> m_readyHits = {0};
+        std::atomic<uint64_t> m_busyPollCount = {0};
+        std::atomic<uint64_t> m_tickleCount = {0};
+        Histogram m_epollBatch;
+        Histogram m_epollWaitTime;
     };
 }
 
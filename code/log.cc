@@ -3,7 +3,13 @@
 #include <map>
 #include <functional>
 #include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sched.h>
+#include <errno.h>
+#include <string.h>
 #include "config.hpp"
+#include "macro.h"
 namespace CXS
 {
     const char *LogLevelToString(LogLevel level)
@@ -66,26 +72,199 @@ namespace CXS
 
     void LogEvent::format(const char *fmt, va_list al)
     {
-        char *buf = nullptr;
-        int len = vasprintf(&buf, fmt, al);
-        if (len != -1)
+        // 直接格式化到内容缓冲区末尾，空间不够时扩容后重来一次
+        std::string &buf = m_ss.buffer();
+        size_t old_size = buf.size();
+        size_t avail = std::max<size_t>(buf.capacity() - old_size, 128);
+        va_list copy;
+        va_copy(copy, al);
+        buf.resize(old_size + avail);
+        int len = vsnprintf(&buf[old_size], avail, fmt, al);
+        if (len < 0)
         {
-            m_ss << std::string(buf, len);
-            free(buf);
+            buf.resize(old_size);
         }
+        else if ((size_t)len >= avail)
+        {
+            buf.resize(old_size + len + 1);
+            vsnprintf(&buf[old_size], len + 1, fmt, copy);
+            buf.resize(old_size + len);
+        }
+        else
+        {
+            buf.resize(old_size + len);
+        }
+        va_end(copy);
+    }
+
+    LogStream::LogStream()
+        : std::ostream(&m_buf)
+    {
+        m_flags = flags();
+    }
+
+    void LogStream::reset()
+    {
+        m_buf.str.clear();
+        clear();
+        flags(m_flags);
+        precision(6);
+        width(0);
+        fill(' ');
+    }
+
+    LogStream::int_type LogStream::StringBuf::overflow(int_type c)
+    {
+        if (c != traits_type::eof())
+        {
+            str.push_back((char)c);
+        }
+        return c;
+    }
+
+    std::streamsize LogStream::StringBuf::xsputn(const char *s, std::streamsize n)
+    {
+        str.append(s, n);
+        return n;
+    }
+
+    // 每个线程缓存用完的日志事件和格式化缓冲区
+    struct LogThreadCache
+    {
+        std::vector<LogEvent::ptr> events;
+        std::string buffer;
+    };
+
+    static const size_t MAX_CACHED_EVENTS = 16;
+    // 缓冲区超过这个大小用完后释放，避免一条超长日志一直占用内存
+    static const size_t MAX_CACHED_BUFFER = 64 * 1024;
+
+    static thread_local LogThreadCache *t_log_cache = nullptr;
+    static thread_local bool t_log_cache_exited = false;
+
+    struct LogThreadCacheHolder
+    {
+        ~LogThreadCacheHolder()
+        {
+            LogThreadCache *cache = t_log_cache;
+            t_log_cache = nullptr;
+            t_log_cache_exited = true;
+            delete cache;
+        }
+    };
+
+    static thread_local LogThreadCacheHolder t_log_cache_holder;
+
+    // 线程退出过程中(线程局部变量已析构)返回nullptr
+    static LogThreadCache *GetLogThreadCache()
+    {
+        if (CXS_UNLIKLY(!t_log_cache))
+        {
+            if (t_log_cache_exited)
+            {
+                return nullptr;
+            }
+            (void)&t_log_cache_holder;
+            t_log_cache = new LogThreadCache;
+        }
+        return t_log_cache;
+    }
+
+    // 线程本地的格式化缓冲区，线程退出过程中退化为局部变量
+    class LogBuffer
+    {
+    public:
+        LogBuffer()
+        {
+            LogThreadCache *cache = GetLogThreadCache();
+            m_buf = cache ? &cache->buffer : &m_local;
+            m_buf->clear();
+        }
+        ~LogBuffer()
+        {
+            if (m_buf->capacity() > MAX_CACHED_BUFFER)
+            {
+                std::string().swap(*m_buf);
+            }
+        }
+        std::string &get() { return *m_buf; }
+
+    private:
+        std::string *m_buf;
+        std::string m_local;
+    };
+
+    LogEvent::ptr LogEvent::Create(const char *filename, uint32_t line, uint32_t elapse, uint32_t threadId,
+                                   uint32_t fiberId, uint64_t time, const std::shared_ptr<Logger> &logger,
+                                   LogLevel level, const std::string &thread_name)
+    {
+        LogThreadCache *cache = GetLogThreadCache();
+        if (!cache || cache->events.empty())
+        {
+            return LogEvent::ptr(new LogEvent((char *)filename, line, elapse, threadId, fiberId, time,
+                                              logger, level, thread_name));
+        }
+        LogEvent::ptr event = std::move(cache->events.back());
+        cache->events.pop_back();
+        event->m_file = filename;
+        event->m_line = line;
+        event->m_elapse = elapse;
+        event->m_threadId = threadId;
+        event->m_fiberId = fiberId;
+        event->m_time = time;
+        event->m_logger = logger;
+        event->m_level = level;
+        event->m_threadName = thread_name;
+        return event;
+    }
+
+    void LogEvent::Recycle(LogEvent::ptr &event)
+    {
+        // appender可能还持有事件
+        if (event.use_count() != 1)
+        {
+            return;
+        }
+        LogThreadCache *cache = GetLogThreadCache();
+        if (!cache || cache->events.size() >= MAX_CACHED_EVENTS)
+        {
+            return;
+        }
+        event->m_ss.reset();
+        if (event->m_ss.buffer().capacity() > MAX_CACHED_BUFFER)
+        {
+            std::string().swap(event->m_ss.buffer());
+        }
+        event->m_logger.reset();
+        cache->events.push_back(std::move(event));
     }
 
     LogEventWrap::LogEventWrap(LogEvent::ptr e)
-        : m_event(e) {}
+        : m_event(std::move(e)) {}
     LogEventWrap::~LogEventWrap()
     {
         m_event->getLogger()->log(m_event->GetLevel(), m_event);
+        LogEvent::Recycle(m_event);
     }
-    std::stringstream &LogEventWrap::getSS()
+    std::ostream &LogEventWrap::getSS()
     {
         return m_event->getStringStream();
     }
 
+    // 追加无符号整数，不经过ostream
+    static void AppendUInt(std::string &buf, uint64_t v)
+    {
+        char tmp[24];
+        char *end = tmp + sizeof(tmp);
+        char *p = end;
+        do
+        {
+            *--p = '0' + v % 10;
+            v /= 10;
+        } while (v);
+        buf.append(p, end - p);
+    }
+
     Logger::Logger(const std::string &name)
     {
         m_name = name;
@@ -119,9 +298,9 @@ namespace CXS
     {
     public:
         MessageFormatItem(const std::string &fmt = ""){};
-        void format(std::ostream &os, std::shared_ptr<Logger> logger, LogLevel level, LogEvent::ptr event) override
+        void format(std::string &buf, const std::shared_ptr<Logger> &logger, LogLevel level, const LogEvent::ptr &event) override
         {
-            os << event->getContent();
+            buf.append(event->getContent());
         }
     };
 
@@ -129,9 +308,9 @@ namespace CXS
     {
     public:
         LevelFormatItem(const std::string &fmt = ""){};
-        void format(std::ostream &os, std::shared_ptr<Logger> logger, LogLevel level, LogEvent::ptr event) override
+        void format(std::string &buf, const std::shared_ptr<Logger> &logger, LogLevel level, const LogEvent::ptr &event) override
         {
-            os << LogLevelToString(level);
+            buf.append(LogLevelToString(level));
         }
     };
 
@@ -139,9 +318,9 @@ namespace CXS
     {
     public:
         ElapseFormatItem(const std::string &fmt = ""){};
-        void format(std::ostream &os, std::shared_ptr<Logger> logger, LogLevel level, LogEvent::ptr event) override
+        void format(std::string &buf, const std::shared_ptr<Logger> &logger, LogLevel level, const LogEvent::ptr &event) override
         {
-            os << event->getElapse();
+            AppendUInt(buf, event->getElapse());
         }
     };
 
@@ -149,9 +328,9 @@ namespace CXS
     {
     public:
         NameFormatItem(const std::string &fmt = ""){};
-        void format(std::ostream &os, std::shared_ptr<Logger> logger, LogLevel level, LogEvent::ptr event) override
+        void format(std::string &buf, const std::shared_ptr<Logger> &logger, LogLevel level, const LogEvent::ptr &event) override
         {
-            os << event->getLogger()->getName();
+            buf.append(event->getLogger()->getName());
         }
     };
 
@@ -159,18 +338,18 @@ namespace CXS
     {
     public:
         ThreadIdFormatItem(const std::string &fmt = ""){};
-        void format(std::ostream &os, std::shared_ptr<Logger> logger, LogLevel level, LogEvent::ptr event) override
+        void format(std::string &buf, const std::shared_ptr<Logger> &logger, LogLevel level, const LogEvent::ptr &event) override
         {
-            os << event->getThread();
+            AppendUInt(buf, event->getThread());
         }
     };
     class FiberIdFormatItem : public LogFormatter::FormatItem
     {
     public:
         FiberIdFormatItem(const std::string &fmt = ""){};
-        void format(std::ostream &os, std::shared_ptr<Logger> logger, LogLevel level, LogEvent::ptr event) override
+        void format(std::string &buf, const std::shared_ptr<Logger> &logger, LogLevel level, const LogEvent::ptr &event) override
         {
-            os << event->getFiber();
+            AppendUInt(buf, event->getFiber());
         }
     };
 
@@ -178,44 +357,172 @@ namespace CXS
     {
     public:
         ThreadNameFormatItem(const std::string &str = ""){};
-        void format(std::ostream &os, std::shared_ptr<Logger> logger, LogLevel level, LogEvent::ptr event) override
+        void format(std::string &buf, const std::shared_ptr<Logger> &logger, LogLevel level, const LogEvent::ptr &event) override
         {
-            os << event->getThreadName();
+            buf.append(event->getThreadName());
         }
     };
 
+    // 每个线程缓存最近几个时间格式最后一次格式化的结果，同一秒内直接复制
+    struct DateTimeCache
+    {
+        uint64_t id;
+        time_t sec;
+        uint32_t len;
+        char str[64];
+    };
+    static const int DATE_CACHE_SIZE = 4;
+    static thread_local DateTimeCache t_date_cache[DATE_CACHE_SIZE];
+    static thread_local int t_date_cache_next = 0;
 
     class DateTimeFormatItem : public LogFormatter::FormatItem
     {
     public:
         DateTimeFormatItem(const std::string &format = "%Y-%m-%d %H:%M:%S") : m_format(format)
         {
+            static std::atomic<uint64_t> s_id(0);
+            m_id = ++s_id;
             if (m_format.empty())
             {
                 m_format = "%Y-%m-%d %H:%M:%S";
             }
+            compile();
         };
-        void format(std::ostream &os, std::shared_ptr<Logger> logger, LogLevel level, LogEvent::ptr event) override
+        void format(std::string &buf, const std::shared_ptr<Logger> &logger, LogLevel level, const LogEvent::ptr &event) override
         {
-            struct tm tm;
             time_t time = event->getTime();
+            DateTimeCache *cache = nullptr;
+            for (int i = 0; i < DATE_CACHE_SIZE; ++i)
+            {
+                if (t_date_cache[i].id == m_id)
+                {
+                    cache = &t_date_cache[i];
+                    break;
+                }
+            }
+            if (!cache)
+            {
+                cache = &t_date_cache[t_date_cache_next];
+                t_date_cache_next = (t_date_cache_next + 1) % DATE_CACHE_SIZE;
+                cache->id = m_id;
+                cache->sec = -1;
+            }
+            if (cache->sec != time)
+            {
+                cache->sec = time;
+                cache->len = render(time, cache->str, sizeof(cache->str));
+            }
+            buf.append(cache->str, cache->len);
+        }
+
+    private:
+        // 把常用的%Y %m %d %H %M %S预先解析成追加操作，其余格式交给strftime
+        void compile()
+        {
+            m_compiled = true;
+            std::string literal;
+            for (size_t i = 0; i < m_format.size(); ++i)
+            {
+                if (m_format[i] != '%' || i + 1 == m_format.size())
+                {
+                    literal.push_back(m_format[i]);
+                    continue;
+                }
+                char c = m_format[++i];
+                if (c == '%')
+                {
+                    literal.push_back('%');
+                    continue;
+                }
+                if (!strchr("YmdHMS", c))
+                {
+                    m_compiled = false;
+                    return;
+                }
+                if (!literal.empty())
+                {
+                    m_ops.push_back(std::make_pair(0, literal));
+                    literal.clear();
+                }
+                m_ops.push_back(std::make_pair((int)c, std::string()));
+            }
+            if (!literal.empty())
+            {
+                m_ops.push_back(std::make_pair(0, literal));
+            }
+        }
+
+        uint32_t render(time_t time, char *out, size_t size)
+        {
+            struct tm tm;
             localtime_r(&time, &tm);
-            char buf[64];
-            strftime(buf, sizeof(buf), m_format.c_str(), &tm);
-            os << buf;
+            if (!m_compiled)
+            {
+                return strftime(out, size, m_format.c_str(), &tm);
+            }
+            size_t pos = 0;
+            auto put = [&](const char *str, size_t len)
+            {
+                len = std::min(len, size - 1 - pos);
+                memcpy(out + pos, str, len);
+                pos += len;
+            };
+            auto put_num = [&](int v, int width)
+            {
+                char tmp[8];
+                for (int i = width - 1; i >= 0; --i)
+                {
+                    tmp[i] = '0' + v % 10;
+                    v /= 10;
+                }
+                put(tmp, width);
+            };
+            for (auto &op : m_ops)
+            {
+                switch (op.first)
+                {
+                case 0:
+                    put(op.second.data(), op.second.size());
+                    break;
+                case 'Y':
+                    put_num(tm.tm_year + 1900, 4);
+                    break;
+                case 'm':
+                    put_num(tm.tm_mon + 1, 2);
+                    break;
+                case 'd':
+                    put_num(tm.tm_mday, 2);
+                    break;
+                case 'H':
+                    put_num(tm.tm_hour, 2);
+                    break;
+                case 'M':
+                    put_num(tm.tm_min, 2);
+                    break;
+                case 'S':
+                    put_num(tm.tm_sec, 2);
+                    break;
+                }
+            }
+            out[pos] = '\0';
+            return pos;
         }
 
     private:
         std::string m_format;
+        uint64_t m_id = 0;
+        bool m_compiled = false;
+        // first为0时是字面量，否则是格式字符
+        std::vector<std::pair<int, std::string>> m_ops;
     };
 
     class FilenameFormatItem : public LogFormatter::FormatItem
     {
     public:
         FilenameFormatItem(const std::string &fmt = ""){};
-        void format(std::ostream &os, std::shared_ptr<Logger> logger, LogLevel level, LogEvent::ptr event) override
+        void format(std::string &buf, const std::shared_ptr<Logger> &logger, LogLevel level, const LogEvent::ptr &event) override
         {
-            os << event->getFile();
+            buf.append(event->getFile());
         }
     };
 
@@ -223,9 +530,9 @@ namespace CXS
     {
     public:
         LineFormatItem(const std::string &fmt = ""){};
-        void format(std::ostream &os, std::shared_ptr<Logger> logger, LogLevel level, LogEvent::ptr event) override
+        void format(std::string &buf, const std::shared_ptr<Logger> &logger, LogLevel level, const LogEvent::ptr &event) override
         {
-            os << event->getline();
+            AppendUInt(buf, event->getline());
         }
     };
 
@@ -233,9 +540,9 @@ namespace CXS
     {
     public:
         NewLineFormatItem(const std::string &str){};
-        void format(std::ostream &os, std::shared_ptr<Logger> logger, LogLevel level, LogEvent::ptr event) override
+        void format(std::string &buf, const std::shared_ptr<Logger> &logger, LogLevel level, const LogEvent::ptr &event) override
         {
-            os << std::endl;
+            buf.push_back('\n');
         }
     };
 
@@ -243,9 +550,9 @@ namespace CXS
     {
     public:
         StringFormatItem(const std::string &str) : m_string(str){};
-        void format(std::ostream &os, std::shared_ptr<Logger> logger, LogLevel level, LogEvent::ptr event) override
+        void format(std::string &buf, const std::shared_ptr<Logger> &logger, LogLevel level, const LogEvent::ptr &event) override
         {
-            os << m_string;
+            buf.append(m_string);
         }
 
     private:
@@ -256,9 +563,9 @@ namespace CXS
     {
     public:
         TabFormatItem(const std::string &str){};
-        void format(std::ostream &os, std::shared_ptr<Logger> logger, LogLevel level, LogEvent::ptr event) override
+        void format(std::string &buf, const std::shared_ptr<Logger> &logger, LogLevel level, const LogEvent::ptr &event) override
         {
-            os << '\t';
+            buf.push_back('\t');
         }
     };
 
@@ -391,8 +698,10 @@ namespace CXS
     {
         if (level >= m_level)
         {
+            LogBuffer buf;
             MutexType::Lock lock(m_mutex);
-            std::cout << m_formatter->format(logger, level, event);
+            m_formatter->format(buf.get(), logger, level, event);
+            std::cout.write(buf.get().data(), buf.get().size());
         }
     }
 
@@ -432,8 +741,10 @@ namespace CXS
     {
         if (level >= m_level)
         {
+            LogBuffer buf;
             MutexType::Lock lock(m_mutex);
-            m_filestream << m_formatter->format(logger, level, event);
+            m_formatter->format(buf.get(), logger, level, event);
+            m_filestream.write(buf.get().data(), buf.get().size());
         }
     }
     std::string FileLogAppender::toYamlString()
@@ -452,6 +763,227 @@ namespace CXS
         return ss.str();
     }
 
+    AsyncLogAppender::AsyncLogAppender(const std::string &filename, size_t capacity,
+                                       OverflowPolicy policy, uint32_t sample_rate)
+        : m_filename(filename), m_queue(capacity), m_policy(policy),
+          m_sampleRate(sample_rate ? sample_rate : 1)
+    {
+        if (m_filename.empty())
+        {
+            m_fd = STDOUT_FILENO;
+        }
+        else
+        {
+            reopen();
+        }
+        m_thread.reset(new Thread(std::bind(&AsyncLogAppender::run, this), "log_flush"));
+    }
+
+    AsyncLogAppender::~AsyncLogAppender()
+    {
+        m_stopping = true;
+        m_semaphore.notify();
+        m_thread->join();
+        if (m_fd > STDERR_FILENO)
+        {
+            close(m_fd);
+        }
+    }
+
+    bool AsyncLogAppender::reopen()
+    {
+        if (m_filename.empty())
+        {
+            return true;
+        }
+        int fd = open(m_filename.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (fd < 0)
+        {
+            std::cout << "AsyncLogAppender open file=" << m_filename << " errno=" << errno
+                      << " errstr=" << strerror(errno) << std::endl;
+            return false;
+        }
+        MutexType::Lock lock(m_mutex);
+        if (m_fd < 0)
+        {
+            m_fd = fd;
+            return true;
+        }
+        // dup2原子替换，后台线程正在写的fd不会失效
+        dup2(fd, m_fd);
+        close(fd);
+        return true;
+    }
+
+    void AsyncLogAppender::log(std::shared_ptr<Logger> logger, LogLevel level, LogEvent::ptr event)
+    {
+        if (level < m_level)
+        {
+            return;
+        }
+        LogFormatter::ptr formatter = getFormatter();
+        if (m_policy == OverflowPolicy::SAMPLE && m_queue.size() >= m_queue.capacity() / 4 * 3 && m_sampleCount++ % m_sampleRate != 0)
+        {
+            ++m_dropped;
+            return;
+        }
+        LogBuffer buf;
+        std::string &str = buf.get();
+        formatter->format(str, logger, level, event);
+        // 入队时与槽位中的旧字符串交换，缓冲区在生产者和后台线程之间循环使用
+        if (!m_queue.tryPush(str))
+        {
+            if (m_policy != OverflowPolicy::BLOCK)
+            {
+                ++m_dropped;
+                return;
+            }
+            ++m_blocked;
+            do
+            {
+                wake();
+                sched_yield();
+            } while (!m_queue.tryPush(str));
+        }
+        ++m_pushed;
+        wake();
+    }
+
+    void AsyncLogAppender::wake()
+    {
+        // 与run中设置m_sleeping后检查队列配对，保证不会漏掉唤醒
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (m_sleeping.load(std::memory_order_relaxed) && m_sleeping.exchange(false))
+        {
+            m_semaphore.notify();
+        }
+    }
+
+    void AsyncLogAppender::flush()
+    {
+        uint64_t target = m_pushed;
+        while (m_written < target)
+        {
+            wake();
+            usleep(100);
+        }
+    }
+
+    void AsyncLogAppender::writeAll(const std::string &buf)
+    {
+        size_t offset = 0;
+        while (offset < buf.size())
+        {
+            ssize_t rt = write(m_fd, buf.data() + offset, buf.size() - offset);
+            if (rt < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                return;
+            }
+            offset += rt;
+        }
+    }
+
+    void AsyncLogAppender::run()
+    {
+        static const size_t MAX_BATCH_BYTES = 64 * 1024;
+        static const size_t MAX_BATCH_COUNT = 1024;
+        std::string buf;
+        buf.reserve(MAX_BATCH_BYTES * 2);
+        std::string record;
+        while (true)
+        {
+            buf.clear();
+            size_t count = 0;
+            while (count < MAX_BATCH_COUNT && buf.size() < MAX_BATCH_BYTES && m_queue.tryPop(record))
+            {
+                buf.append(record);
+                ++count;
+            }
+            if (count)
+            {
+                writeAll(buf);
+                m_written += count;
+                continue;
+            }
+            if (m_stopping)
+            {
+                break;
+            }
+            m_sleeping = true;
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (!m_queue.empty() || m_stopping)
+            {
+                m_sleeping = false;
+                continue;
+            }
+            m_semaphore.wait();
+        }
+    }
+
+    AsyncLogAppender::Stats AsyncLogAppender::getStats() const
+    {
+        Stats stats;
+        stats.written = m_written;
+        stats.dropped = m_dropped;
+        stats.blocked = m_blocked;
+        return stats;
+    }
+
+    AsyncLogAppender::OverflowPolicy AsyncLogAppender::PolicyFromString(const std::string &str)
+    {
+        if (str == "drop")
+        {
+            return OverflowPolicy::DROP;
+        }
+        if (str == "sample")
+        {
+            return OverflowPolicy::SAMPLE;
+        }
+        return OverflowPolicy::BLOCK;
+    }
+
+    const char *AsyncLogAppender::PolicyToString(OverflowPolicy policy)
+    {
+        switch (policy)
+        {
+        case OverflowPolicy::DROP:
+            return "drop";
+        case OverflowPolicy::SAMPLE:
+            return "sample";
+        default:
+            return "block";
+        }
+    }
+
+    std::string AsyncLogAppender::toYamlString()
+    {
+        MutexType::Lock lock(m_mutex);
+        YAML::Node node;
+        node["type"] = "AsyncLogAppender";
+        if (!m_filename.empty())
+        {
+            node["file"] = m_filename;
+        }
+        node["level"] = LogLevelToString(m_level);
+        node["overflow"] = PolicyToString(m_policy);
+        node["buffer_size"] = m_queue.capacity();
+        if (m_policy == OverflowPolicy::SAMPLE)
+        {
+            node["sample_rate"] = m_sampleRate;
+        }
+        if (m_formatter && m_hasFormatter)
+        {
+            node["formatter"] = m_formatter->getPattern();
+        }
+        std::stringstream ss;
+        ss << node;
+        return ss.str();
+    }
+
     LogFormatter::LogFormatter(const std::string &pattern)
     {
         m_pattern = pattern;
@@ -460,12 +992,17 @@ namespace CXS
 
     std::string LogFormatter::format(std::shared_ptr<Logger> logger, LogLevel level, LogEvent::ptr event)
     {
-        std::stringstream ss;
+        std::string buf;
+        format(buf, logger, level, event);
+        return buf;
+    }
+
+    void LogFormatter::format(std::string &buf, const std::shared_ptr<Logger> &logger, LogLevel level, const LogEvent::ptr &event)
+    {
         for (auto &i : m_item)
         {
-            i->format(ss, logger, level, event);
+            i->format(buf, logger, level, event);
         }
-        return ss.str();
     }
     // 格式化  %xxx %xxx{xxx} %%
     void LogFormatter::init()
@@ -634,17 +1171,24 @@ namespace CXS
 
     struct LogAppenderDefine
     {
-        // 1 File, 2 stdcout
+        // 1 File, 2 stdcout, 3 async
         int type = 0;
         LogLevel level = LogLevel::UNKNOW;
         std::string file;
         std::string formatter;
+        // 以下仅AsyncLogAppender使用
+        std::string overflow;
+        size_t buffer_size = 8192;
+        uint32_t sample_rate = 10;
 
         bool operator==(const LogAppenderDefine &oth) const
         {
             return type == oth.type &&
                    level == oth.level &&
-                   file == oth.file;
+                   file == oth.file &&
+                   overflow == oth.overflow &&
+                   buffer_size == oth.buffer_size &&
+                   sample_rate == oth.sample_rate;
         }
     };
 
@@ -729,6 +1273,31 @@ namespace CXS
                             lad.formatter = ap["formatter"].as<std::string>();
                         }
                     }
+                    else if (type == "AsyncLogAppender")
+                    {
+                        lad.type = 3;
+                        // 没有file时输出到标准输出
+                        if (ap["file"].IsDefined())
+                        {
+                            lad.file = ap["file"].as<std::string>();
+                        }
+                        if (ap["formatter"].IsDefined())
+                        {
+                            lad.formatter = ap["formatter"].as<std::string>();
+                        }
+                        if (ap["overflow"].IsDefined())
+                        {
+                            lad.overflow = ap["overflow"].as<std::string>();
+                        }
+                        if (ap["buffer_size"].IsDefined())
+                        {
+                            lad.buffer_size = ap["buffer_size"].as<size_t>();
+                        }
+                        if (ap["sample_rate"].IsDefined())
+                        {
+                            lad.sample_rate = ap["sample_rate"].as<uint32_t>();
+                        }
+                    }
                     else
                     {
                         std::cout << "log config error: appender type is invalid, " << ap
@@ -771,6 +1340,20 @@ namespace CXS
                 {
                     apNode["type"] = "StdoutLogAppender";
                 }
+                else if (ap.type == 3)
+                {
+                    apNode["type"] = "AsyncLogAppender";
+                    if (!ap.file.empty())
+                    {
+                        apNode["file"] = ap.file;
+                    }
+                    if (!ap.overflow.empty())
+                    {
+                        apNode["overflow"] = ap.overflow;
+                    }
+                    apNode["buffer_size"] = ap.buffer_size;
+                    apNode["sample_rate"] = ap.sample_rate;
+                }
                 if (ap.level != LogLevel::UNKNOW)
                 {
                     apNode["level"] = LogLevelToString(ap.level);
@@ -834,6 +1417,11 @@ namespace CXS
                             {
                                 appender.reset(new StdoutAppender);
                             }
+                            else if(a.type ==3)
+                            {
+                                appender.reset(new AsyncLogAppender(a.file, a.buffer_size,
+                                        AsyncLogAppender::PolicyFromString(a.overflow), a.sample_rate));
+                            }
                             appender->setLevel(a.level);
                             if(!a.formatter.empty())
                             {
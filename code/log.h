@@ -13,11 +13,12 @@
 #include "singleton.h"
 #include <set>
 #include "thread.h"
+#include "ring_buffer.h"
 
 #define CXS_LOG_LEVEL(logger, level)                                                                                        \
     if (logger->getLevel() <= level)                                                                                        \
-    CXS::LogEventWrap(CXS::LogEvent::ptr(new CXS::LogEvent((char *)__FILE__, __LINE__, 0,                                   \
-                                                           CXS::GetThreadId(), CXS::GetFiberId(), time(0), logger, level,CXS::Thread::GetName()))) \
+    CXS::LogEventWrap(CXS::LogEvent::Create(__FILE__, __LINE__, 0,                                                          \
+                                            CXS::GetThreadId(), CXS::GetFiberId(), time(0), logger, level, CXS::Thread::GetName())) \
         .getSS()
 #define CXS_LOG_DEBUG(logger) CXS_LOG_LEVEL(logger, CXS::LogLevel::DEBUG)
 #define CXS_LOG_INFO(logger) CXS_LOG_LEVEL(logger, CXS::LogLevel::INFO)
@@ -27,8 +28,8 @@
 
 #define CXS_LOG_FMT_LEVEL(logger, level, fmt, ...)                                                                          \
     if (logger->getLevel() <= level)                                                                                        \
-    CXS::LogEventWrap(CXS::LogEvent::ptr(new CXS::LogEvent((char *)__FILE__, __LINE__, 0,                                   \
-                                                           CXS::GetThreadId(), CXS::GetFiberId(), time(0), logger, level,CXS::Thread::GetName()))) \
+    CXS::LogEventWrap(CXS::LogEvent::Create(__FILE__, __LINE__, 0,                                                          \
+                                            CXS::GetThreadId(), CXS::GetFiberId(), time(0), logger, level, CXS::Thread::GetName())) \
         .getEvent()                                                                                                         \
         ->format(fmt, __VA_ARGS__)
 #define CXS_LOG_FMT_DEBUG(logger, fmt, ...) CXS_LOG_FMT_LEVEL(logger, CXS::LogLevel::DEBUG, fmt, __VA_ARGS__)
@@ -52,6 +53,27 @@ namespace CXS
         ERROR = 4,
         FATAL = 5
     };
+    // 日志内容流，直接写入std::string，复用时保留缓冲区容量
+    class LogStream : public std::ostream
+    {
+    public:
+        LogStream();
+        const std::string &str() const { return m_buf.str; }
+        std::string &buffer() { return m_buf.str; }
+        // 清空内容并恢复默认格式标志
+        void reset();
+
+    private:
+        struct StringBuf : public std::streambuf
+        {
+            int_type overflow(int_type c) override;
+            std::streamsize xsputn(const char *s, std::streamsize n) override;
+            std::string str;
+        };
+        StringBuf m_buf;
+        std::ios_base::fmtflags m_flags;
+    };
+
     // 日志事件
     class LogEvent
     {
@@ -59,6 +81,12 @@ namespace CXS
     public:
         LogEvent(char *fliename, uint32_t line, uint32_t elapse, uint32_t threadId,
                  uint32_t FiberId, uint32_t time, std::shared_ptr<Logger> logger, LogLevel level, const std::string& thread_name);
+        // 优先从线程本地缓存中取已用完的事件，避免每条日志分配
+        static std::shared_ptr<LogEvent> Create(const char *filename, uint32_t line, uint32_t elapse, uint32_t threadId,
+                                                uint32_t fiberId, uint64_t time, const std::shared_ptr<Logger> &logger,
+                                                LogLevel level, const std::string &thread_name);
+        // 没有其他引用时放回线程本地缓存
+        static void Recycle(std::shared_ptr<LogEvent> &event);
         const char *getFile() const { return m_file; }
         uint32_t getElapse() const { return m_elapse; }
         uint32_t getline() const { return m_line; }
@@ -66,11 +94,11 @@ namespace CXS
         uint32_t getFiber() const { return m_fiberId; }
         uint64_t getTime() const { return m_time; }
         const std::string& getThreadName() const {return m_threadName;}
-        std::string getContent() const { return m_ss.str(); }
-        std::stringstream &getStringStream() { return m_ss; }
+        const std::string &getContent() const { return m_ss.str(); }
+        std::ostream &getStringStream() { return m_ss; }
 
         typedef std::shared_ptr<LogEvent> ptr;
-        std::shared_ptr<Logger> getLogger() const { return m_logger; }
+        const std::shared_ptr<Logger> &getLogger() const { return m_logger; }
         LogLevel GetLevel() { return m_level; }
         void format(const char *fmt, ...);
         void format(const char *fmt, va_list al);
@@ -82,7 +110,7 @@ namespace CXS
         uint32_t m_threadId = 0;      // 线程id
         uint32_t m_fiberId = 0;       // 协程id
         uint64_t m_time = 0;          // 时间戳
-        std::stringstream m_ss;       // 内容
+        LogStream m_ss;               // 内容
         std::shared_ptr<Logger> m_logger;
         LogLevel m_level;
         std::string m_threadName;
@@ -93,8 +121,8 @@ namespace CXS
     public:
         LogEventWrap(LogEvent::ptr e);
         ~LogEventWrap();
-        std::stringstream &getSS();
-        LogEvent::ptr getEvent() const { return m_event; }
+        std::ostream &getSS();
+        const LogEvent::ptr &getEvent() const { return m_event; }
 
     private:
         LogEvent::ptr m_event;
@@ -107,6 +135,8 @@ namespace CXS
         LogFormatter(const std::string &pattern);
         //%t    %thread_id%m%n
         std::string format(std::shared_ptr<Logger> logger, LogLevel level, LogEvent::ptr event);
+        // 追加到buf末尾，不产生额外的分配
+        void format(std::string &buf, const std::shared_ptr<Logger> &logger, LogLevel level, const LogEvent::ptr &event);
         void init();
         bool isError() const { return m_error; }
         const std::string getPattern() const { return m_pattern; }
@@ -117,7 +147,7 @@ namespace CXS
         public:
             typedef std::shared_ptr<FormatItem> ptr;
             virtual ~FormatItem() {}
-            virtual void format(std::ostream &os, std::shared_ptr<Logger> logger, LogLevel level, LogEvent::ptr event) = 0;
+            virtual void format(std::string &buf, const std::shared_ptr<Logger> &logger, LogLevel level, const LogEvent::ptr &event) = 0;
         };
 
     private:
@@ -211,6 +241,64 @@ namespace CXS
         std::ofstream m_filestream;
     };
 
+    // 异步输出，日志在调用线程格式化后放入无锁环形队列，由后台线程批量write
+    class AsyncLogAppender : public LogAppender
+    {
+    public:
+        typedef std::shared_ptr<AsyncLogAppender> ptr;
+        // 队列满时的处理方式
+        enum class OverflowPolicy
+        {
+            BLOCK,  // 等待后台线程腾出空间
+            DROP,   // 丢弃
+            SAMPLE, // 队列超过3/4时每sample_rate条保留1条，满了丢弃
+        };
+        struct Stats
+        {
+            uint64_t written; // 已写出的日志条数
+            uint64_t dropped; // 丢弃的日志条数
+            uint64_t blocked; // 生产者因队列满等待的次数
+        };
+
+        // filename为空时输出到标准输出
+        AsyncLogAppender(const std::string &filename, size_t capacity = 8192,
+                         OverflowPolicy policy = OverflowPolicy::BLOCK, uint32_t sample_rate = 10);
+        ~AsyncLogAppender();
+        void log(std::shared_ptr<Logger> logger, LogLevel level, LogEvent::ptr event) override;
+        std::string toYamlString() override;
+
+        // 重新打开文件，成功则返回true
+        bool reopen();
+        // 等待调用前已入队的日志全部写出
+        void flush();
+        Stats getStats() const;
+
+        static OverflowPolicy PolicyFromString(const std::string &str);
+        static const char *PolicyToString(OverflowPolicy policy);
+
+    private:
+        void run();
+        void wake();
+        void writeAll(const std::string &buf);
+
+    private:
+        std::string m_filename;
+        int m_fd = -1;
+        MPSCRingBuffer<std::string> m_queue;
+        OverflowPolicy m_policy;
+        uint32_t m_sampleRate;
+        std::atomic<uint64_t> m_sampleCount = {0};
+        std::atomic<uint64_t> m_pushed = {0};
+        std::atomic<uint64_t> m_written = {0};
+        std::atomic<uint64_t> m_dropped = {0};
+        std::atomic<uint64_t> m_blocked = {0};
+        // 后台线程队列为空准备休眠
+        std::atomic<bool> m_sleeping = {false};
+        std::atomic<bool> m_stopping = {false};
+        Semaphore m_semaphore;
+        Thread::ptr m_thread;
+    };
+
     class LoggerManager
     {
     public:
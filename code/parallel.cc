@@ -0,0 +1,116 @@
+#include "parallel.h"
+#include "config.hpp"
+#include "fiber_sync.h"
+#include "util.h"
+#include <exception>
+
+namespace CXS {
+
+static ConfigVar<uint64_t>::ptr g_parallel_yield_us =
+    Config::Lookup<uint64_t>("parallel.yield_us", 1000, "parallel algorithms yield to io and timers after running this many microseconds, 0 to disable");
+
+// 当前是否在调度器的任务协程中(可以让出和挂起)
+static bool InSchedulerFiber(Scheduler *scheduler) {
+    return scheduler && Scheduler::GetThis() == scheduler
+           && Fiber::GetThis().get() != Scheduler::GetMainFiber();
+}
+
+ParallelRange::ParallelRange(size_t begin, size_t end, size_t grain, size_t participants) :
+    m_cur(begin),
+    m_end(end),
+    m_grain(std::max(grain, (size_t)1)),
+    m_divisor(participants * 2),
+    m_yieldUs(g_parallel_yield_us->getValue()) {
+}
+
+bool ParallelRange::next(Cursor &cursor, size_t &b, size_t &e) {
+    uint64_t now = GetCurrentUS();
+    if (m_yieldUs) {
+        if (cursor.chunk_begin) {
+            // 上一块的耗时折算到目标时长
+            uint64_t elapsed = std::max(now - cursor.chunk_begin, (uint64_t)1);
+            cursor.limit = std::max((size_t)(cursor.last_size * (m_yieldUs / 4) / elapsed), m_grain);
+        } else {
+            // 第一块只取grain用来测量
+            cursor.limit = m_grain;
+            cursor.last_yield = now;
+        }
+        if (now - cursor.last_yield >= m_yieldUs) {
+            if (InSchedulerFiber(Scheduler::GetThis())) {
+                Fiber::YieldToReady();
+            }
+            now = GetCurrentUS();
+            cursor.last_yield = now;
+        }
+    }
+    size_t cur = m_cur.load(std::memory_order_relaxed);
+    while (cur < m_end) {
+        size_t size = std::max((m_end - cur) / m_divisor, m_grain);
+        if (cursor.limit) {
+            size = std::min(size, cursor.limit);
+        }
+        size_t to = std::min(cur + size, m_end);
+        if (m_cur.compare_exchange_weak(cur, to, std::memory_order_relaxed)) {
+            b = cur;
+            e = to;
+            cursor.last_size = to - cur;
+            cursor.chunk_begin = now;
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t ParallelParticipants(Scheduler *scheduler) {
+    return scheduler ? std::max(scheduler->getWorkerCount(), (size_t)1) : 1;
+}
+
+// 执行一个参与者，异常记到slot中(只保留第一个)，不论是否抛出都要done，否则等待方永远挂起
+static void RunParticipant(const std::function<void(size_t)> &body, size_t i, WaitGroup &wg,
+                           Spinlock &lock, std::exception_ptr &error) {
+    struct DoneGuard {
+        WaitGroup &wg;
+        ~DoneGuard() { wg.done(); }
+    } guard{wg};
+    try {
+        body(i);
+    } catch (...) {
+        Spinlock::Lock l(lock);
+        if (!error) {
+            error = std::current_exception();
+        }
+    }
+}
+
+void ParallelRun(Scheduler *scheduler, size_t participants, const std::function<void(size_t)> &body) {
+    if (participants <= 1) {
+        body(0);
+        return;
+    }
+    // 调用方在调度器中时自己做0号参与者，其余的放入本地队列，被其他工作线程窃取
+    // 参与者引用本函数栈上的对象，即使有参与者抛出异常也要等全部返回后才能离开，再把异常抛给调用方
+    bool inline_first = InSchedulerFiber(scheduler);
+    WaitGroup wg;
+    Spinlock lock;
+    std::exception_ptr error;
+    std::vector<Scheduler::FiberAndThread> tasks;
+    for (size_t i = 0; i < participants; ++i) {
+        wg.add();
+        if (i == 0 && inline_first) {
+            continue;
+        }
+        tasks.push_back(Scheduler::FiberAndThread([&body, &wg, &lock, &error, i]() {
+            RunParticipant(body, i, wg, lock, error);
+        }, -1));
+    }
+    scheduler->schedule(tasks);
+    if (inline_first) {
+        RunParticipant(body, 0, wg, lock, error);
+    }
+    wg.wait();
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+} // namespace CXS
@@ -0,0 +1,132 @@
+#ifndef __CXS_PARALLEL_H__
+#define __CXS_PARALLEL_H__
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <iterator>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "noncopyable.h"
+#include "scheduler.hpp"
+
+namespace CXS {
+
+// 在调度器的工作线程上并行执行批处理任务
+// 调用方在该调度器的协程中时也参与执行，其余参与者作为普通任务放入本线程的本地队列，由空闲线程窃取；
+// 等待时只挂起协程。参与者每执行parallel.yield_us让出一次，打开iomanager.busy_poll时工作线程借此处理IO和定时器
+
+// 自适应分块: 各参与者从同一个原子游标取块，每块取剩余量的1/(2*参与者数)且不小于grain，
+// 开始时块大开销小，接近结束时块小负载均衡，先做完的参与者自然多取；
+// 同时按参与者测得的每元素耗时限制块大小，使一块约为parallel.yield_us的1/4，块之间检查是否该让出
+class ParallelRange : public Noncopyable {
+public:
+    // 每个参与者各自的分块状态
+    struct Cursor {
+        // 按耗时估算的块大小上限，0表示还没有测量
+        size_t limit = 0;
+        size_t last_size = 0;
+        uint64_t chunk_begin = 0;
+        uint64_t last_yield = 0;
+    };
+
+    ParallelRange(size_t begin, size_t end, size_t grain, size_t participants);
+
+    // 取下一块[b, e)，没有剩余时返回false；调用时上一块已做完，根据其耗时调整块大小，必要时先让出
+    bool next(Cursor &cursor, size_t &b, size_t &e);
+
+private:
+    std::atomic<size_t> m_cur;
+    size_t m_end;
+    size_t m_grain;
+    size_t m_divisor;
+    uint64_t m_yieldUs;
+};
+
+// 参与者数，调度器为空或只有一个工作线程时返回1
+size_t ParallelParticipants(Scheduler *scheduler);
+// 启动participants个参与者执行body(参与者下标)，全部返回后才返回
+void ParallelRun(Scheduler *scheduler, size_t participants, const std::function<void(size_t)> &body);
+
+// 对[begin, end)中的每个i执行f(i)，grain为每块的最小元素数
+template <class F>
+void parallel_for(Scheduler *scheduler, size_t begin, size_t end, F f, size_t grain = 1) {
+    size_t participants = ParallelParticipants(scheduler);
+    if (end <= begin) {
+        return;
+    }
+    ParallelRange range(begin, end, grain, participants);
+    ParallelRun(scheduler, participants, [&](size_t) {
+        ParallelRange::Cursor cursor;
+        size_t b = 0;
+        size_t e = 0;
+        while (range.next(cursor, b, e)) {
+            for (size_t i = b; i < e; ++i) {
+                f(i);
+            }
+        }
+    });
+}
+
+// 对[begin, end)做map后用reduce归约，每个参与者各自累加后再合并，reduce需满足结合律和交换律
+template <class T, class Map, class Reduce>
+T parallel_reduce(Scheduler *scheduler, size_t begin, size_t end, T identity, Map map, Reduce reduce,
+                  size_t grain = 1) {
+    size_t participants = ParallelParticipants(scheduler);
+    if (end <= begin) {
+        return identity;
+    }
+    std::vector<T> partial(participants, identity);
+    ParallelRange range(begin, end, grain, participants);
+    ParallelRun(scheduler, participants, [&](size_t slot) {
+        ParallelRange::Cursor cursor;
+        size_t b = 0;
+        size_t e = 0;
+        T acc = identity;
+        while (range.next(cursor, b, e)) {
+            for (size_t i = b; i < e; ++i) {
+                acc = reduce(std::move(acc), map(i));
+            }
+        }
+        partial[slot] = std::move(acc);
+    });
+    T rt = identity;
+    for (auto &i : partial) {
+        rt = reduce(std::move(rt), std::move(i));
+    }
+    return rt;
+}
+
+// 分成2的幂个段并行排序，再逐轮两两归并；不是稳定排序
+template <class RandomIt, class Compare>
+void parallel_sort(Scheduler *scheduler, RandomIt begin, RandomIt end, Compare comp, size_t grain = 4096) {
+    size_t n = end - begin;
+    size_t participants = ParallelParticipants(scheduler);
+    grain = std::max(grain, (size_t)2);
+    if (participants == 1 || n <= grain) {
+        std::sort(begin, end, comp);
+        return;
+    }
+    size_t chunks = 1;
+    while (chunks < participants * 2 && n / (chunks * 2) >= grain) {
+        chunks <<= 1;
+    }
+    auto bound = [&](size_t i) { return begin + n * std::min(i, chunks) / chunks; };
+    parallel_for(scheduler, 0, chunks, [&](size_t i) { std::sort(bound(i), bound(i + 1), comp); });
+    for (size_t width = 1; width < chunks; width <<= 1) {
+        parallel_for(scheduler, 0, chunks / (width * 2), [&](size_t p) {
+            std::inplace_merge(bound(p * 2 * width), bound((p * 2 + 1) * width), bound((p + 1) * 2 * width), comp);
+        });
+    }
+}
+
+template <class RandomIt>
+void parallel_sort(Scheduler *scheduler, RandomIt begin, RandomIt end) {
+    parallel_sort(scheduler, begin, end, std::less<typename std::iterator_traits<RandomIt>::value_type>());
+}
+
+} // namespace CXS
+
+#endif
@@ -0,0 +1,107 @@
+#ifndef __CXS_RING_BUFFER_H__
+#define __CXS_RING_BUFFER_H__
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include <utility>
+#include <vector>
+
+#include "noncopyable.h"
+
+namespace CXS {
+
+// 有界无锁环形队列，多生产者单消费者
+// 每个槽位带序号：序号等于写入位置时可写，等于写入位置+1时可读
+template <class T>
+class MPSCRingBuffer : public Noncopyable {
+public:
+    // 容量向上取整为2的幂
+    MPSCRingBuffer(size_t capacity) {
+        size_t size = 2;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        m_mask = size - 1;
+        m_cells = std::vector<Cell>(size);
+        for (size_t i = 0; i < size; ++i) {
+            m_cells[i].seq.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    // val与槽位中的旧值交换，std::string等类型可以复用旧值的缓冲区
+    // 队列满返回false，此时val不变
+    bool tryPush(T &val) {
+        size_t pos = m_tail.load(std::memory_order_relaxed);
+        Cell *cell = nullptr;
+        while (true) {
+            cell = &m_cells[pos & m_mask];
+            size_t seq = cell->seq.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+            if (diff == 0) {
+                if (m_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = m_tail.load(std::memory_order_relaxed);
+            }
+        }
+        std::swap(cell->data, val);
+        cell->seq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // 仅消费者调用，val与槽位中的值交换
+    bool tryPop(T &val) {
+        size_t pos = m_head.load(std::memory_order_relaxed);
+        Cell &cell = m_cells[pos & m_mask];
+        if (cell.seq.load(std::memory_order_acquire) != pos + 1) {
+            return false;
+        }
+        std::swap(cell.data, val);
+        cell.seq.store(pos + m_mask + 1, std::memory_order_release);
+        m_head.store(pos + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // 仅消费者调用，队头还没有写完的数据视为空
+    bool empty() const {
+        size_t pos = m_head.load(std::memory_order_relaxed);
+        return m_cells[pos & m_mask].seq.load(std::memory_order_acquire) != pos + 1;
+    }
+
+    // 近似元素个数
+    size_t size() const {
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+        size_t head = m_head.load(std::memory_order_relaxed);
+        return tail > head ? tail - head : 0;
+    }
+
+    size_t capacity() const { return m_mask + 1; }
+
+private:
+    struct Cell {
+        std::atomic<size_t> seq;
+        T data;
+
+        Cell() :
+            seq(0) {}
+        Cell(Cell &&oth) :
+            seq(oth.seq.load(std::memory_order_relaxed)), data(std::move(oth.data)) {}
+    };
+
+    std::vector<Cell> m_cells;
+    size_t m_mask = 0;
+    // 生产者和消费者的位置分开在不同缓存行
+    char m_pad0[64];
+    std::atomic<size_t> m_tail = {0};
+    char m_pad1[64];
+    std::atomic<size_t> m_head = {0};
+    char m_pad2[64];
+};
+
+} // namespace CXS
+
+#endif
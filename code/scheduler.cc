@@ -2,12 +2,17 @@
 #include "log.h"
 #include "macro.h"
 #include "hook.h"
+#include "util.h"
 namespace CXS {
 static CXS::Logger::ptr g_logger = CXS_LOG_NAME("system");
 // 当前协程调度器
 static thread_local Scheduler *t_scheduler = nullptr;
 // 线程主协程
 static thread_local Fiber *t_fiber = nullptr;
+// 当前线程在t_scheduler中的本地队列下标
+static thread_local int t_worker_index = -1;
+// 每隔多少次调度先检查一次全局队列，防止全局队列中的任务饿死
+static const uint32_t GLOBAL_QUEUE_CHECK_INTERVAL = 61;
 
 Scheduler::Scheduler(size_t threads, bool use_caller, const std::string &name) :
     m_name(name) {
@@ -35,6 +40,12 @@ Scheduler::Scheduler(size_t threads, bool use_caller, const std::string &name) :
         m_rootThread = -1;
     }
     m_threadCount = threads;
+    // 每个参与调度的线程(包括use_caller线程)一个本地队列
+    size_t workers = threads + (use_caller ? 1 : 0);
+    m_queues.resize(workers);
+    for (size_t i = 0; i < workers; ++i) {
+        m_queues[i].reset(new WorkQueue);
+    }
 }
 Scheduler::~Scheduler() {
     CXS_ASSERT(m_stopping);
@@ -126,6 +137,12 @@ void Scheduler::run() {
     set_hook_enable(true);
     // 设置当前调度器
     setThis();
+    // 分配本线程的本地队列
+    size_t index = m_workerCount++;
+    CXS_ASSERT(index < m_queues.size());
+    WorkQueue *queue = m_queues[index].get();
+    queue->thread = CXS::GetThreadId();
+    t_worker_index = index;
     // 非user_caller线程，设置主协程为线程主协程
     if (CXS::GetThreadId() != m_rootThread) {
         t_fiber = Fiber::GetThis().get();
@@ -138,38 +155,52 @@ void Scheduler::run() {
 
     // 声明一个结构体 FiberAndThread，用于存放协程和线程信息
     FiberAndThread ft;
+    WorkerStats &stats = queue->stats;
+    // 上次进入idle或busyPoll之后执行的任务数和开始忙的时间
+    uint32_t busy_tasks = 0;
+    uint64_t busy_begin = 0;
+    // 当前任务开始执行的时间和上一个任务结束的时间
+    uint64_t task_begin = 0;
+    uint64_t task_end = 0;
+    // 任务切出后计入执行时间
+    auto task_done = [&]() {
+        task_end = GetCurrentUS();
+        uint64_t used = task_end > task_begin ? task_end - task_begin : 0;
+        stats.run_time.record(used);
+        stats.busy_us.fetch_add(used, std::memory_order_relaxed);
+        stats.tasks.fetch_add(1, std::memory_order_relaxed);
+    };
     while (true) {
         ft.reset();
+        if (busy_tasks) {
+            uint32_t poll_tasks = m_busyPollTasks;
+            uint64_t poll_us = m_busyPollUs;
+            if ((poll_tasks && busy_tasks >= poll_tasks)
+                || (poll_us && task_end - busy_begin >= poll_us)) {
+                busyPoll();
+                busy_tasks = 0;
+            }
+        }
         // 用于标记是否需要唤醒其他线程
         bool tickle_me = false;
         // 用于标记当前是否有协程在执行
         bool is_active = false;
-        {
-            // 从任务队列中拿fiber和cb
-            MutexType::Lock lock(m_mutex);
-            auto it = m_fibers.begin();
-            while (it != m_fibers.end()) {
-                // 如果协程的线程信息不匹配当前线程，则将该协程留在队列中并继续查找
-                if (it->thread != -1 && it->thread != CXS::GetThreadId()) {
-                    ++it;
-                    tickle_me = true;
-                    continue;
-                }
-
-                CXS_ASSERT(it->fiber || it->cb);
-                // 如果协程有效且处于执行状态，则继续查找
-                if (it->fiber && it->fiber->getState() == Fiber::EXEC) {
-                    ++it;
-                    continue;
-                }
-                // 获取一个有效的协程或回调
-                ft = *it;
-                m_fibers.erase(it);
-                ++m_activeThreadCount;
-                is_active = true;
-                break;
+        // 先计入活跃线程再取任务，保证任务在队列间转移时stopping()不会误判
+        ++m_activeThreadCount;
+        if (dequeue(queue, ft, tickle_me)) {
+            is_active = true;
+            task_begin = GetCurrentUS();
+            if (ft.enqueue_us) {
+                stats.queue_wait.record(task_begin > ft.enqueue_us ? task_begin - ft.enqueue_us : 0);
+            }
+            if (ft.ready_us) {
+                stats.resume_delay.record(task_begin > ft.ready_us ? task_begin - ft.ready_us : 0);
             }
-            tickle_me |= it != m_fibers.end();
+            if (busy_tasks++ == 0) {
+                busy_begin = task_begin;
+            }
+        } else {
+            --m_activeThreadCount;
         }
         // 如果需要唤醒其他线程，就执行唤醒操作
         if (tickle_me) {
@@ -180,15 +211,33 @@ void Scheduler::run() {
             // 切换到要执行的协程
             ft.fiber->swapIn();
             --m_activeThreadCount;
+            task_done();
 
             if (ft.fiber->getState() == Fiber::READY) {
                 // 如果协程处于就绪状态，重新调度该协程
-                schedule(ft.fiber);
+                reschedule(ft.fiber);
             } else if (ft.fiber->getState() != Fiber::TERM && ft.fiber->getState() != Fiber::EXECEP) {
                 // 如果协程不处于终止或异常状态，将其状态设置为 HOLD
                 ft.fiber->setState(Fiber::HOLD);
             }
             ft.reset();
+        } else if (ft.cb && ft.run_inline) {
+            // 直接在调度循环的栈上执行，调试检查保证回调中没有让出
+            std::function<void()> cb;
+            cb.swap(ft.cb);
+            ft.reset();
+            Fiber::SetRunInline(true);
+            try {
+                cb();
+            } catch (std::exception &ex) {
+                CXS_LOG_ERROR(g_logger) << "inline callback except: " << ex.what();
+            } catch (...) {
+                CXS_LOG_ERROR(g_logger) << "inline callback except";
+            }
+            Fiber::SetRunInline(false);
+            cb = nullptr;
+            --m_activeThreadCount;
+            task_done();
         } else if (ft.cb) {
             // cb_fiber存在，重置该fiber
             if (cb_fiber) {
@@ -202,10 +251,11 @@ void Scheduler::run() {
             // 切换到回调协程执行
             cb_fiber->swapIn();
             --m_activeThreadCount;
+            task_done();
             // 若cb_fiber状态为READY
             if (cb_fiber->getState() == Fiber::READY) {
                 // 重新放入任务队列中
-                schedule(cb_fiber);
+                reschedule(cb_fiber);
                 // 释放智能指针
                 cb_fiber.reset();
             }
@@ -230,9 +280,12 @@ void Scheduler::run() {
                 break;
             }
 
+            busy_tasks = 0;
+            uint64_t idle_begin = GetCurrentUS();
             ++m_idleThreadCount;
             idle_fiber->swapIn();
             --m_idleThreadCount;
+            stats.idle_us.fetch_add(GetCurrentUS() - idle_begin, std::memory_order_relaxed);
             if (idle_fiber->getState() != Fiber::TERM && idle_fiber->getState() != Fiber::EXECEP) {
                 // 如果空闲协程不处于终止或异常状态，将其状态设置为 HOLD
                 idle_fiber->setState(Fiber::HOLD);
@@ -245,8 +298,205 @@ void Scheduler::tickle() {
 }
 
 bool Scheduler::stopping() {
+    return m_autoStop && m_stopping && m_taskCount == 0 && m_activeThreadCount == 0;
+}
+
+Scheduler::WorkQueue *Scheduler::getLocalQueue() {
+    if (t_scheduler != this || t_worker_index < 0) {
+        return nullptr;
+    }
+    return m_queues[t_worker_index].get();
+}
+
+bool Scheduler::enqueue(FiberAndThread &ft) {
+    WorkQueue *queue = getLocalQueue();
+    // 指定了其他线程的任务放入全局队列，由目标线程自己取走
+    if (queue && (ft.thread == -1 || ft.thread == queue->thread)) {
+        QueueMutexType::Lock lock(queue->mutex);
+        queue->tasks.push_back(std::move(ft));
+        ++queue->size;
+        ++m_taskCount;
+        return hasIdleThreads();
+    }
     MutexType::Lock lock(m_mutex);
-    return m_autoStop && m_stopping && m_fibers.empty() && m_activeThreadCount == 0;
+    bool need_tickle = m_fibers.empty();
+    m_fibers.push_back(std::move(ft));
+    ++m_globalCount;
+    ++m_taskCount;
+    return need_tickle;
+}
+
+void Scheduler::schedule(std::vector<FiberAndThread> &tasks) {
+    bool need_tickle = false;
+    bool has_global = false;
+    WorkQueue *queue = getLocalQueue();
+    if (queue) {
+        QueueMutexType::Lock lock(queue->mutex);
+        for (auto &ft : tasks) {
+            if (!ft.fiber && !ft.cb) {
+                continue;
+            }
+            if (ft.thread != -1 && ft.thread != queue->thread) {
+                has_global = true;
+                continue;
+            }
+            queue->tasks.push_back(std::move(ft));
+            ft.reset();
+            ++queue->size;
+            ++m_taskCount;
+            need_tickle = true;
+        }
+        need_tickle = need_tickle && hasIdleThreads();
+    } else {
+        has_global = true;
+    }
+    if (has_global) {
+        // 非工作线程调度的以及指定了其他线程的任务
+        MutexType::Lock lock(m_mutex);
+        for (auto &ft : tasks) {
+            if (!ft.fiber && !ft.cb) {
+                continue;
+            }
+            need_tickle = need_tickle || m_fibers.empty();
+            m_fibers.push_back(std::move(ft));
+            ft.reset();
+            ++m_globalCount;
+            ++m_taskCount;
+        }
+    }
+    tasks.clear();
+    if (need_tickle) {
+        tickle();
+    }
+}
+
+// 让出执行权的协程放到本地队列头部，排在已有任务之后执行，避免LIFO下反复调度同一个协程
+void Scheduler::reschedule(Fiber::ptr fiber) {
+    WorkQueue *queue = getLocalQueue();
+    if (!queue) {
+        schedule(fiber);
+        return;
+    }
+    bool need_tickle = false;
+    {
+        QueueMutexType::Lock lock(queue->mutex);
+        queue->tasks.push_front(FiberAndThread(&fiber, -1));
+        ++queue->size;
+        ++m_taskCount;
+        need_tickle = hasIdleThreads();
+    }
+    if (need_tickle) {
+        tickle();
+    }
+}
+
+bool Scheduler::dequeue(WorkQueue *queue, FiberAndThread &ft, bool &tickle_me) {
+    bool found = false;
+    if (++queue->tick % GLOBAL_QUEUE_CHECK_INTERVAL == 0) {
+        found = popGlobal(ft, tickle_me);
+    }
+    found = found || popLocal(queue, ft) || popGlobal(ft, tickle_me) || steal(queue, ft);
+    if (!found) {
+        return false;
+    }
+    // 协程还在其他线程上执行(刚被唤醒还未切出)，放回全局队列稍后再取
+    if (ft.fiber && ft.fiber->getState() == Fiber::EXEC) {
+        {
+            MutexType::Lock lock(m_mutex);
+            m_fibers.push_back(std::move(ft));
+            ++m_globalCount;
+            ++m_taskCount;
+        }
+        ft.reset();
+        tickle_me = true;
+        return false;
+    }
+    return true;
+}
+
+bool Scheduler::popLocal(WorkQueue *queue, FiberAndThread &ft) {
+    if (queue->size == 0) {
+        return false;
+    }
+    QueueMutexType::Lock lock(queue->mutex);
+    if (queue->tasks.empty()) {
+        return false;
+    }
+    ft = std::move(queue->tasks.back());
+    queue->tasks.pop_back();
+    --queue->size;
+    --m_taskCount;
+    return true;
+}
+
+bool Scheduler::popGlobal(FiberAndThread &ft, bool &tickle_me) {
+    if (m_globalCount == 0) {
+        return false;
+    }
+    MutexType::Lock lock(m_mutex);
+    auto it = m_fibers.begin();
+    while (it != m_fibers.end()) {
+        // 如果协程的线程信息不匹配当前线程，则将该协程留在队列中并继续查找
+        if (it->thread != -1 && it->thread != CXS::GetThreadId()) {
+            ++it;
+            tickle_me = true;
+            continue;
+        }
+
+        CXS_ASSERT(it->fiber || it->cb);
+        // 如果协程有效且处于执行状态，则继续查找
+        if (it->fiber && it->fiber->getState() == Fiber::EXEC) {
+            ++it;
+            continue;
+        }
+        // 获取一个有效的协程或回调
+        ft = std::move(*it);
+        m_fibers.erase(it);
+        --m_globalCount;
+        --m_taskCount;
+        tickle_me |= !m_fibers.empty();
+        return true;
+    }
+    return false;
+}
+
+bool Scheduler::steal(WorkQueue *queue, FiberAndThread &ft) {
+    size_t count = m_queues.size();
+    // 从不同的位置开始遍历，分散窃取者
+    size_t start = queue->tick;
+    for (size_t i = 0; i < count; ++i) {
+        WorkQueue *victim = m_queues[(start + i) % count].get();
+        if (victim == queue || victim->size == 0) {
+            continue;
+        }
+        QueueMutexType::Lock lock(victim->mutex);
+        // 从头部窃取最早放入的任务，跳过绑定了线程的任务
+        for (auto it = victim->tasks.begin(); it != victim->tasks.end(); ++it) {
+            if (it->thread != -1) {
+                continue;
+            }
+            ft = std::move(*it);
+            victim->tasks.erase(it);
+            --victim->size;
+            --m_taskCount;
+            ++queue->steals;
+            return true;
+        }
+    }
+    ++queue->steal_misses;
+    return false;
+}
+
+Scheduler::QueueStats Scheduler::getQueueStats() const {
+    QueueStats stats;
+    stats.global_depth = m_globalCount;
+    stats.local_depth.reserve(m_queues.size());
+    for (auto &i : m_queues) {
+        stats.local_depth.push_back(i->size);
+        stats.steals += i->steals;
+        stats.steal_misses += i->steal_misses;
+    }
+    return stats;
 }
 void Scheduler::idle() {
     CXS_LOG_INFO(g_logger) << "idle";
@@ -4,14 +4,21 @@
 #include <memory>
 #include "thread.h"
 #include "fiber.hpp"
+#include "histogram.h"
+#include "util.h"
 #include <list>
+#include <deque>
 #include <vector>
 #include <functional>
 
 namespace CXS {
+template <class T>
+class Future;
+
 class Scheduler {
 public:
     typedef CXS::Mutex MutexType;
+    typedef CXS::Spinlock QueueMutexType;
     typedef std::shared_ptr<Scheduler> ptr;
 
     Scheduler(size_t threads = 1, bool use_caller = true, const std::string &name = "");
@@ -19,6 +26,10 @@ public:
     const std::string &getName() const {
         return m_name;
     }
+    // 参与调度的线程数，包括use_caller线程
+    size_t getWorkerCount() const {
+        return m_queues.size();
+    }
 
     static Scheduler *GetThis();
     static Fiber *GetMainFiber();
@@ -26,24 +37,37 @@ public:
     void start();
     void stop();
     // 调度协程
+    // 工作线程内调度的任务进入本线程的本地队列，外部线程调度的任务进入全局注入队列
     template <class FiberOrCb>
     void schedule(FiberOrCb fc, int thread = -1) {
-        bool need_tickle = false;
-        {
-            // 将任务加入到队列中，若任务队列中已经有任务了，则tickle（）
-            MutexType::Lock lock(m_mutex);
-            need_tickle = scheduleNoLock(fc, thread);
+        FiberAndThread ft(fc, thread);
+        if ((ft.fiber || ft.cb) && enqueue(ft)) {
+            tickle();
         }
+    };
 
-        if (need_tickle) {
+    // 调度一个短小且不会挂起的回调，在调度循环的栈上直接执行，省去协程reset与两次上下文切换
+    // 回调中不能让出，也不能调用会挂起的hook函数(sleep、阻塞的socket读写等)或等待协程同步原语，否则断言失败
+    void scheduleInline(std::function<void()> cb, int thread = -1) {
+        FiberAndThread ft(&cb, thread);
+        ft.run_inline = true;
+        if (ft.cb && enqueue(ft)) {
             tickle();
         }
-    };
+    }
 
     template <class InputIterator>
     void schedule(InputIterator begin, InputIterator end) {
         bool need_tickle = false;
-        {
+        WorkQueue *queue = getLocalQueue();
+        if (queue) {
+            // 批量放入本地队列，只加一次本地锁
+            QueueMutexType::Lock lock(queue->mutex);
+            while (begin != end) {
+                need_tickle = pushLocalNoLock(queue, &*begin) || need_tickle;
+                ++begin;
+            }
+        } else {
             MutexType::Lock lock(m_mutex);
             while (begin != end) {
                 need_tickle = scheduleNoLock(&*begin, -1) || need_tickle;
@@ -55,28 +79,6 @@ public:
         }
     };
 
-protected:
-    virtual void tickle();
-    void run();
-    virtual bool stopping();
-    virtual void idle();
-    void setThis();
-
-    bool hasIdleThreads() {
-        return m_idleThreadCount > 0;
-    }
-
-private:
-    template <class FiberOrCb>
-    bool scheduleNoLock(FiberOrCb fc, int thread) {
-        bool need_tickle = m_fibers.empty();
-        FiberAndThread ft(fc, thread);
-        if (ft.fiber || ft.cb) {
-            m_fibers.push_back(ft);
-        }
-        return need_tickle;
-    };
-
     struct FiberAndThread {
         //协程
         Fiber::ptr fiber;
@@ -84,21 +86,27 @@ private:
         std::function<void()> cb;
         // 线程id 协程在哪个线程上
         int thread;
+        // IO事件或定时器就绪的时间(微秒)，用于统计从就绪到开始执行的延迟，0为不统计
+        uint64_t ready_us = 0;
+        // 创建(入队)的时间(微秒)，用于统计在队列中的等待时间
+        uint64_t enqueue_us = 0;
+        // 回调不会挂起，在调度循环的栈上直接执行，不切换协程
+        bool run_inline = false;
         // 确定协程在哪个线程上跑
         FiberAndThread(Fiber::ptr f, int thr) :
-            fiber(f), thread(thr){};
+            fiber(f), thread(thr), enqueue_us(GetCurrentUS()){};
         FiberAndThread(Fiber::ptr *f, int thr) :
-            thread(thr) {
+            thread(thr), enqueue_us(GetCurrentUS()) {
             // 通过swap将传入的 fiber 置空，使其引用计数-1
             fiber.swap(*f);
         }
 
         // 确定回调在哪个线程上跑
         FiberAndThread(std::function<void()> f, int thr) :
-            cb(f), thread(thr){};
+            cb(f), thread(thr), enqueue_us(GetCurrentUS()){};
         // 通过swap将传入的 cb 置空，使其引用计数-1
         FiberAndThread(std::function<void()> *f, int thr) :
-            thread(thr) {
+            thread(thr), enqueue_us(GetCurrentUS()) {
             cb.swap(*f);
         };
         // 默认构造
@@ -109,20 +117,156 @@ private:
             fiber = nullptr;
             cb = nullptr;
             thread = -1;
+            ready_us = 0;
+            enqueue_us = 0;
+            run_inline = false;
         }
     };
 
+    // 调度cb，返回其结果的Future，调用方需要包含future.h
+    template <class F>
+    auto async(F cb, int thread = -1) -> Future<decltype(cb())>;
+
+    // 批量调度，任务从tasks中移出(不拷贝std::function)，整批只加一次锁、最多tickle一次
+    // 指定了其他线程的任务进入全局注入队列，返回后tasks被清空
+    void schedule(std::vector<FiberAndThread> &tasks);
+
+    // 任务队列统计信息
+    struct QueueStats {
+        // 全局注入队列长度
+        size_t global_depth = 0;
+        // 各工作线程本地队列长度
+        std::vector<size_t> local_depth;
+        // 累计窃取成功的任务数
+        uint64_t steals = 0;
+        // 累计窃取失败(遍历所有队列都没有拿到任务)的次数
+        uint64_t steal_misses = 0;
+    };
+    QueueStats getQueueStats() const;
+
+    // 忙时轮询: 工作线程连续执行tasks个任务或持续us微秒没有进入idle时，调用一次busyPoll检查IO和定时器
+    // 0表示不按该条件触发，两者都为0时关闭
+    void setBusyPoll(uint32_t tasks, uint64_t us) {
+        m_busyPollTasks = tasks;
+        m_busyPollUs = us;
+    }
+
+    // 每个工作线程的运行统计，只由所属线程写入，其他线程(如监控导出)随时无锁读取
+    struct WorkerStats {
+        // 任务从入队到开始执行的等待时间(微秒)
+        Histogram queue_wait;
+        // 任务每次切入到切出的执行时间(微秒)
+        Histogram run_time;
+        // IO事件、定时器从就绪到对应任务开始执行的延迟(微秒)
+        Histogram resume_delay;
+        // 执行的任务数
+        std::atomic<uint64_t> tasks = {0};
+        // 执行任务的累计时间(微秒)
+        std::atomic<uint64_t> busy_us = {0};
+        // 在idle中的累计时间(微秒)，包括阻塞在epoll_wait中的时间
+        std::atomic<uint64_t> idle_us = {0};
+    };
+    // i为工作线程下标，0 <= i < getWorkerCount()
+    const WorkerStats &getWorkerStats(size_t i) const {
+        return m_queues[i]->stats;
+    }
+
+protected:
+    virtual void tickle();
+    // 忙时轮询，在调度线程的主协程中执行，不能挂起
+    virtual void busyPoll() {}
+    void run();
+    virtual bool stopping();
+    virtual void idle();
+    void setThis();
+
+    bool hasIdleThreads() {
+        return m_idleThreadCount > 0;
+    }
+    // 是否还有未被取走的任务(全局队列与所有本地队列)
+    bool hasPendingTasks() const {
+        return m_taskCount > 0;
+    }
+
+private:
+    struct WorkQueue;
+
+    // 放入全局注入队列，需持有m_mutex
+    template <class FiberOrCb>
+    bool scheduleNoLock(FiberOrCb fc, int thread) {
+        bool need_tickle = m_fibers.empty();
+        FiberAndThread ft(fc, thread);
+        if (ft.fiber || ft.cb) {
+            m_fibers.push_back(std::move(ft));
+            ++m_globalCount;
+            ++m_taskCount;
+        }
+        return need_tickle;
+    };
+
+    // 放入本地队列尾部，需持有queue->mutex
+    template <class FiberOrCb>
+    bool pushLocalNoLock(WorkQueue *queue, FiberOrCb fc) {
+        FiberAndThread ft(fc, -1);
+        if (!ft.fiber && !ft.cb) {
+            return false;
+        }
+        queue->tasks.push_back(std::move(ft));
+        ++queue->size;
+        ++m_taskCount;
+        // 有空闲线程时唤醒它来窃取
+        return hasIdleThreads();
+    };
+
+    bool enqueue(FiberAndThread &ft);
+    void reschedule(Fiber::ptr fiber);
+    WorkQueue *getLocalQueue();
+    bool dequeue(WorkQueue *queue, FiberAndThread &ft, bool &tickle_me);
+    bool popLocal(WorkQueue *queue, FiberAndThread &ft);
+    bool popGlobal(FiberAndThread &ft, bool &tickle_me);
+    bool steal(WorkQueue *queue, FiberAndThread &ft);
+
+    // 工作线程的本地任务队列
+    // 所有者从尾部取(LIFO)，窃取者从头部取(FIFO)，只有窃取时才会与其他线程竞争本地锁
+    struct WorkQueue {
+        QueueMutexType mutex;
+        std::deque<FiberAndThread> tasks;
+        // 队列长度，无锁读取
+        std::atomic<size_t> size = {0};
+        // 该线程窃取成功的任务数
+        std::atomic<uint64_t> steals = {0};
+        // 该线程窃取失败的次数
+        std::atomic<uint64_t> steal_misses = {0};
+        // 所属线程id
+        int thread = -1;
+        // 调度计数，用于定期检查全局队列
+        uint32_t tick = 0;
+        // 本线程的运行统计
+        WorkerStats stats;
+    };
+
 private:
+    // 保护全局注入队列
     MutexType m_mutex;
     // 线程池
     std::vector<Thread::ptr> m_threads;
-    // 待执行的协程队列
+    // 全局注入队列，存放外部线程调度以及指定了线程的任务
     std::list<FiberAndThread> m_fibers;
+    // 每个工作线程一个本地队列
+    std::vector<std::unique_ptr<WorkQueue>> m_queues;
+    // 已进入run()的工作线程数，用于分配本地队列
+    std::atomic<size_t> m_workerCount = {0};
+    // 全局注入队列中的任务数，无锁读取
+    std::atomic<size_t> m_globalCount = {0};
+    // 所有队列中的任务总数
+    std::atomic<size_t> m_taskCount = {0};
     // 协程调度器名称
     std::string m_name;
     // use_caller为true时有效，调度协程
     Fiber::ptr m_rootFiber;
-    int m_idleThreadCount = 0;
+    std::atomic<int> m_idleThreadCount = {0};
+    std::atomic<uint32_t> m_busyPollTasks = {0};
+    std::atomic<uint64_t> m_busyPollUs = {0};
 
 protected:
     // 协程下的线程id数组
@@ -98,16 +98,44 @@ bool Socket::setOption(int level, int optname, const void *optval, size_t optlen
     return true;
 }
 Socket::ptr Socket::accept() {
-    Socket::ptr sock(new Socket(m_family, m_type, m_protocol));
-    int newSock = ::accept(m_sock, nullptr, nullptr);
-    if (newSock == -1) {
-        CXS_LOG_ERROR(g_logger) << " accept (" << m_sock << ") failed, errno = " << errno << " error str = " << strerror(errno);
+    std::vector<Socket::ptr> clients;
+    if (accept(clients, 1) <= 0) {
         return nullptr;
     }
-    if (sock->init(newSock)) {
-        return sock;
+    return clients[0];
+}
+
+int Socket::accept(std::vector<Socket::ptr> &clients, size_t max_count) {
+    // 没有hook时监听socket是阻塞的，取空之后会阻塞，只取一个
+    if (!is_hook_enable()) {
+        max_count = 1;
+    }
+    size_t count = 0;
+    while (count < max_count) {
+        int newSock = -1;
+        if (count == 0) {
+            newSock = ::accept4(m_sock, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (newSock == -1) {
+                CXS_LOG_ERROR(g_logger) << " accept (" << m_sock << ") failed, errno = " << errno << " error str = " << strerror(errno);
+                return -1;
+            }
+        } else {
+            // 之后直接调用原始函数，EAGAIN说明backlog已取空，其他错误留给下一轮处理
+            newSock = accept4_f(m_sock, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (newSock == -1) {
+                break;
+            }
+            FdMgr::GetInstance()->addNonblockSocket(newSock);
+        }
+        Socket::ptr sock(new Socket(m_family, m_type, m_protocol));
+        if (sock->init(newSock)) {
+            clients.push_back(sock);
+            ++count;
+        } else {
+            ::close(newSock);
+        }
     }
-    return nullptr;
+    return count ? (int)count : -1;
 }
 
 bool Socket::init(int sock) {
@@ -115,9 +143,11 @@ bool Socket::init(int sock) {
     if (ctx && ctx->isSocket() && !ctx->isClose()) {
         m_sock = sock;
         m_isConnected = true;
-        initSock();
-        getLocalAddress();
-        getRemoteAddress();
+        // 已连接的socket不需要SO_REUSEADDR，地址在getLocalAddress/getRemoteAddress时才获取
+        if (m_type == SOCK_STREAM) {
+            int val = 1;
+            setOption(IPPROTO_TCP, TCP_NODELAY, val);
+        }
         return true;
     }
     return false;
@@ -141,13 +171,16 @@ void Socket::newSock() {
     // initSock();
 }
 
-bool Socket::bind(const Address::ptr addr) {
+bool Socket::bind(const Address::ptr addr, bool reuse_port) {
     if (!isValid()) {
         newSock();
         if (CXS_UNLIKLY(!isValid())) {
             return false;
         }
     }
+    if (reuse_port && !setOption(SOL_SOCKET, SO_REUSEPORT, (int)1)) {
+        return false;
+    }
     if (CXS_UNLIKLY(addr->getFamily() != m_family)) {
         CXS_LOG_ERROR(g_logger) << "bind sock.family = " << m_family
                                 << " addr.family = " << addr->getFamily() << " not match"
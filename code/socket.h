@@ -6,6 +6,7 @@
 #include <memory>
 #include <ostream>
 #include <sys/socket.h>
+#include <vector>
 #include "address.h"
 #include "noncopyable.h"
 namespace CXS {
@@ -58,7 +59,12 @@ public:
     }
 
     Socket::ptr accept();
-    bool bind(const Address::ptr addr);
+    // 批量accept: backlog为空时挂起等待第一个连接，之后一直取到EAGAIN或取满max_count个
+    // 用accept4(SOCK_NONBLOCK|SOCK_CLOEXEC)，本端/对端地址在第一次使用时才获取
+    // 返回放入clients的个数，一个都没取到时返回-1
+    int accept(std::vector<Socket::ptr> &clients, size_t max_count);
+    // reuse_port为true时绑定前设置SO_REUSEPORT，多个socket可以监听同一地址，由内核分配连接
+    bool bind(const Address::ptr addr, bool reuse_port = false);
     bool connect(const Address::ptr addr, int64_t timeout_ms = -1);
     bool listen(int backlog = 1024);
     bool close();
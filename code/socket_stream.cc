@@ -1,5 +1,7 @@
 #include "socket_stream.h"
 #include <bits/types/struct_iovec.h>
+#include <algorithm>
+#include <sys/sendfile.h>
 #include <vector>
 
 namespace CXS {
@@ -56,4 +58,49 @@ void SocketStream::close() {
     }
 }
 
-} // namespace CXS
\ No newline at end of file
+int SocketStream::writevFixSize(struct iovec *iov, int iovcnt) {
+    if (!isConnected()) {
+        return -1;
+    }
+    size_t total = 0;
+    for (int i = 0; i < iovcnt; ++i) {
+        total += iov[i].iov_len;
+    }
+    size_t left = total;
+    while (left > 0) {
+        int rt = m_sock->send(iov, iovcnt);
+        if (rt <= 0) {
+            return rt;
+        }
+        left -= rt;
+        // 跳过已经写完的部分
+        while (iovcnt > 0 && (size_t)rt >= iov->iov_len) {
+            rt -= iov->iov_len;
+            ++iov;
+            --iovcnt;
+        }
+        if (iovcnt > 0) {
+            iov->iov_base = (char *)iov->iov_base + rt;
+            iov->iov_len -= rt;
+        }
+    }
+    return total;
+}
+
+int64_t SocketStream::sendFile(int fd, uint64_t offset, uint64_t length) {
+    if (!isConnected()) {
+        return -1;
+    }
+    off_t off = offset;
+    uint64_t left = length;
+    while (left > 0) {
+        // 单次调用最多发送0x7ffff000字节
+        ssize_t rt = sendfile(m_sock->getSocket(), fd, &off, std::min<uint64_t>(left, 1 << 30));
+        if (rt <= 0) {
+            return rt;
+        }
+        left -= rt;
+    }
+    return length;
+}
+} // namespace CXS
@@ -15,6 +15,10 @@ public:
     virtual int write(const void *buffer, size_t length) override;
     virtual int write(ByteArray::ptr ba, size_t length) override;
     virtual void close() override;
+    // 写完iov中的全部数据，iov会被修改，返回写入的总字节数，失败返回<=0
+    int writevFixSize(struct iovec *iov, int iovcnt);
+    // 用sendfile把文件fd中[offset, offset + length)发送完，返回发送的字节数，失败返回<=0
+    int64_t sendFile(int fd, uint64_t offset, uint64_t length);
 
     Socket::ptr getSocket() const {
         return m_sock;
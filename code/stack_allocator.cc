@@ -0,0 +1,173 @@
+#include "stack_allocator.h"
+#include "config.hpp"
+#include "log.h"
+#include "macro.h"
+#include <atomic>
+#include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <vector>
+
+namespace CXS {
+
+static CXS::Logger::ptr g_logger = CXS_LOG_NAME("system");
+
+static ConfigVar<uint64_t>::ptr g_stack_pool_max_size =
+    Config::Lookup<uint64_t>("fiber.stack_pool.max_size", 64 * 1024 * 1024, "max bytes of fiber stacks pooled per thread");
+static ConfigVar<bool>::ptr g_stack_pool_madvise =
+    Config::Lookup<bool>("fiber.stack_pool.madvise", false, "madvise(MADV_DONTNEED) fiber stacks when pooled");
+
+static std::atomic<uint64_t> s_alloc_count(0);
+static std::atomic<uint64_t> s_reuse_count(0);
+static std::atomic<uint64_t> s_pool_count(0);
+static std::atomic<uint64_t> s_release_count(0);
+static std::atomic<uint64_t> s_pooled_bytes(0);
+
+static uint64_t s_pool_max_size = 0;
+static bool s_pool_madvise = false;
+static size_t s_page_size = 4096;
+
+struct _StackAllocatorIniter {
+    _StackAllocatorIniter() {
+        long page = sysconf(_SC_PAGESIZE);
+        if (page > 0) {
+            s_page_size = page;
+        }
+        s_pool_max_size = g_stack_pool_max_size->getValue();
+        s_pool_madvise = g_stack_pool_madvise->getValue();
+        g_stack_pool_max_size->addListener([](const uint64_t &old_value, const uint64_t &new_value) {
+            CXS_LOG_INFO(g_logger) << "change fiber.stack_pool.max_size from " << old_value << " to " << new_value;
+            s_pool_max_size = new_value;
+        });
+        g_stack_pool_madvise->addListener([](const bool &old_value, const bool &new_value) {
+            s_pool_madvise = new_value;
+        });
+    }
+};
+
+static _StackAllocatorIniter s_stack_allocator_initer;
+
+// 按页对齐后的栈大小
+static size_t RoundSize(size_t size) {
+    return (size + s_page_size - 1) & ~(s_page_size - 1);
+}
+
+static void *MapStack(size_t size) {
+    size_t len = size + s_page_size;
+    void *base = mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK, -1, 0);
+    if (base == MAP_FAILED) {
+        CXS_LOG_ERROR(g_logger) << "mmap fiber stack size=" << len << " errno=" << errno << " errstr=" << strerror(errno);
+        CXS_ASSERT2(false, "mmap fiber stack");
+    }
+    // 栈向低地址增长，保护页放在最低处
+    if (mprotect(base, s_page_size, PROT_NONE)) {
+        CXS_LOG_ERROR(g_logger) << "mprotect fiber stack guard errno=" << errno << " errstr=" << strerror(errno);
+    }
+    ++s_alloc_count;
+    return (char *)base + s_page_size;
+}
+
+static void UnmapStack(void *vp, size_t size) {
+    munmap((char *)vp - s_page_size, size + s_page_size);
+    ++s_release_count;
+}
+
+// 线程本地的空闲栈链表
+struct StackPool {
+    struct Item {
+        size_t size;
+        void *stack;
+    };
+    std::vector<Item> items;
+    uint64_t bytes = 0;
+
+    ~StackPool() {
+        for (auto &i : items) {
+            UnmapStack(i.stack, i.size);
+        }
+        s_pooled_bytes -= bytes;
+    }
+};
+
+// 用可平凡析构的指针访问线程池，线程退出时由t_stack_pool_holder析构释放，
+// 之后再析构的协程栈直接munmap
+static thread_local StackPool *t_stack_pool = nullptr;
+static thread_local bool t_stack_pool_exited = false;
+
+struct StackPoolHolder {
+    ~StackPoolHolder() {
+        StackPool *pool = t_stack_pool;
+        t_stack_pool = nullptr;
+        t_stack_pool_exited = true;
+        delete pool;
+    }
+};
+
+static thread_local StackPoolHolder t_stack_pool_holder;
+
+static StackPool *GetStackPool() {
+    if (CXS_UNLIKLY(!t_stack_pool)) {
+        if (t_stack_pool_exited) {
+            return nullptr;
+        }
+        // 引用一次holder使其在本线程构造，保证线程退出时释放
+        (void)&t_stack_pool_holder;
+        t_stack_pool = new StackPool;
+    }
+    return t_stack_pool;
+}
+
+void *StackAllocator::Alloc(size_t size) {
+    size = RoundSize(size);
+    StackPool *pool = GetStackPool();
+    if (!pool) {
+        return MapStack(size);
+    }
+    auto &items = pool->items;
+    // 最近释放的栈最可能还在缓存中，从尾部开始找
+    for (size_t i = items.size(); i > 0; --i) {
+        if (items[i - 1].size == size) {
+            void *vp = items[i - 1].stack;
+            items[i - 1] = items.back();
+            items.pop_back();
+            pool->bytes -= size;
+            s_pooled_bytes -= size;
+            ++s_reuse_count;
+            return vp;
+        }
+    }
+    return MapStack(size);
+}
+
+void StackAllocator::Dealloc(void *vp, size_t size) {
+    if (!vp) {
+        return;
+    }
+    size = RoundSize(size);
+    StackPool *pool = GetStackPool();
+    if (!pool || pool->bytes + size > s_pool_max_size) {
+        UnmapStack(vp, size);
+        return;
+    }
+    if (s_pool_madvise) {
+        // 保留映射但归还物理页，复用时重新缺页
+        madvise(vp, size, MADV_DONTNEED);
+    }
+    pool->items.push_back({size, vp});
+    pool->bytes += size;
+    s_pooled_bytes += size;
+    ++s_pool_count;
+}
+
+StackAllocator::Stats StackAllocator::GetStats() {
+    Stats stats;
+    stats.alloc_count = s_alloc_count;
+    stats.reuse_count = s_reuse_count;
+    stats.pool_count = s_pool_count;
+    stats.release_count = s_release_count;
+    stats.pooled_bytes = s_pooled_bytes;
+    return stats;
+}
+
+} // namespace CXS
@@ -0,0 +1,38 @@
+#ifndef __CXS_STACK_ALLOCATOR_H__
+#define __CXS_STACK_ALLOCATOR_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace CXS {
+
+// 协程栈分配器
+// 栈通过mmap分配，最低地址处放一个PROT_NONE的保护页，栈溢出时直接触发SIGSEGV而不是踩坏相邻内存
+// 释放的栈放入当前线程的空闲链表复用，每个线程保留的总字节数受fiber.stack_pool.max_size限制
+class StackAllocator {
+public:
+    // 分配统计
+    struct Stats {
+        // 新mmap的栈数
+        uint64_t alloc_count;
+        // 从空闲链表复用的栈数
+        uint64_t reuse_count;
+        // 归还到空闲链表的栈数
+        uint64_t pool_count;
+        // munmap释放的栈数
+        uint64_t release_count;
+        // 当前所有线程空闲链表中保留的字节数
+        uint64_t pooled_bytes;
+    };
+
+    // 分配size大小的可用栈空间(不含保护页)
+    static void *Alloc(size_t size);
+    // 释放Alloc返回的栈，size需与Alloc时一致
+    static void Dealloc(void *vp, size_t size);
+    // 获取分配统计
+    static Stats GetStats();
+};
+
+} // namespace CXS
+
+#endif
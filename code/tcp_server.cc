@@ -4,6 +4,7 @@
 #include "config.hpp"
 #include "log.h"
 #include "socket.h"
+#include <algorithm>
 #include <cstdint>
 #include <functional>
 #include <vector>
@@ -14,20 +15,40 @@ CXS::ConfigVar<uint64_t>::ptr g_tcp_server_readTimeout = CXS::Config::Lookup("tc
                                                                              (uint64_t)(120000),
                                                                              "tcp server read time out");
 
+static CXS::ConfigVar<std::string>::ptr g_tcp_server_accept_mode =
+    CXS::Config::Lookup("tcp_server.accept_mode", std::string("single"),
+                        "tcp server accept mode: single, reuseport or exclusive");
+
+static CXS::ConfigVar<uint32_t>::ptr g_tcp_server_accept_batch =
+    CXS::Config::Lookup("tcp_server.accept_batch", (uint32_t)64,
+                        "max connections taken from the backlog per accept wakeup");
+
 static CXS::Logger::ptr g_logger = CXS_LOG_NAME("system");
 
+static TCPServer::AcceptMode AcceptModeFromString(const std::string &mode) {
+    if (mode == "reuseport") {
+        return TCPServer::AcceptMode::REUSEPORT;
+    }
+    if (mode == "exclusive") {
+        return TCPServer::AcceptMode::EXCLUSIVE;
+    }
+    return TCPServer::AcceptMode::SINGLE;
+}
+
 TCPServer::TCPServer(CXS::IOManager *work,
                      CXS::IOManager *acceptWork) :
     m_work(work),
     m_acceptWork(acceptWork),
+    m_acceptMode(AcceptModeFromString(g_tcp_server_accept_mode->getValue())),
     m_readTimeout(g_tcp_server_readTimeout->getValue()),
+    m_acceptBatch(std::max(g_tcp_server_accept_batch->getValue(), (uint32_t)1)),
     m_name("CXS/1.0.0"),
     m_isStop(true) {
 }
 
 TCPServer::~TCPServer() {
     for (auto &i : m_socks) {
-        i->close();
+        i.sock->close();
     }
     m_socks.clear();
 }
@@ -38,23 +59,48 @@ bool TCPServer::bind(CXS::Address::ptr addr) {
     return bind(addrs, fails);
 }
 bool TCPServer::bind(const std::vector<Address::ptr> &addrs, std::vector<Address::ptr> &fails) {
-    for (auto &addr : addrs) {
-        Socket::ptr sock = Socket::CreateTCP(addr);
-        if (!sock->bind(addr)) {
-            CXS_LOG_ERROR(g_logger) << "bind fail errno :"
-                                    << errno << " errstr = " << strerror(errno)
-                                    << " addr = [" << addr->toString() << "]";
-            fails.push_back(addr);
-            continue;
+    std::vector<IOManager *> workers = m_acceptWorkers;
+    if (workers.empty()) {
+        workers.push_back(m_acceptWork);
+    }
+    // REUSEPORT每个分片一个监听socket
+    size_t count = 1;
+    if (m_acceptMode == AcceptMode::REUSEPORT) {
+        count = workers.size();
+        if (count == 1) {
+            CXS_LOG_WARN(g_logger) << "reuseport accept mode without accept workers, use one listener";
         }
-        if (!sock->listen()) {
-            CXS_LOG_ERROR(g_logger) << "listen fail errno :" << errno
-                                    << " errstr = " << strerror(errno)
-                                    << " addr = [" << addr->toString() << "]";
-            fails.push_back(addr);
-            continue;
+    }
+    bool shared = m_acceptMode == AcceptMode::EXCLUSIVE && workers.size() > 1;
+    for (auto &addr : addrs) {
+        Address::ptr bind_addr = addr;
+        for (size_t i = 0; i < count; ++i) {
+            Socket::ptr sock = Socket::CreateTCP(bind_addr);
+            if (!sock->bind(bind_addr, m_acceptMode == AcceptMode::REUSEPORT)) {
+                CXS_LOG_ERROR(g_logger) << "bind fail errno :"
+                                        << errno << " errstr = " << strerror(errno)
+                                        << " addr = [" << bind_addr->toString() << "]";
+                fails.push_back(addr);
+                break;
+            }
+            if (!sock->listen()) {
+                CXS_LOG_ERROR(g_logger) << "listen fail errno :" << errno
+                                        << " errstr = " << strerror(errno)
+                                        << " addr = [" << bind_addr->toString() << "]";
+                fails.push_back(addr);
+                break;
+            }
+            // 端口为0时后面的socket绑定到第一个socket分到的端口
+            bind_addr = sock->getLocalAddress();
+            if (shared) {
+                for (auto w : workers) {
+                    w->setExclusive(sock->getSocket());
+                    m_socks.push_back(Listener{sock, w});
+                }
+            } else {
+                m_socks.push_back(Listener{sock, workers[i % workers.size()]});
+            }
         }
-        m_socks.push_back(sock);
     }
     if (!fails.empty()) {
         m_socks.clear();
@@ -62,7 +108,7 @@ bool TCPServer::bind(const std::vector<Address::ptr> &addrs, std::vector<Address
     }
 
     for (auto &i : m_socks) {
-        CXS_LOG_INFO(g_logger) << "server bind success : " << *i;
+        CXS_LOG_INFO(g_logger) << "server bind success : " << *i.sock;
     }
     return true;
 }
@@ -71,37 +117,51 @@ void TCPServer::handleClient(Socket::ptr client) {
     CXS_LOG_INFO(g_logger) << "handle client : " << *client;
 }
 void TCPServer::startAccept(Socket::ptr sock) {
+    // 有多个accept分片时连接留在accept它的IOManager上处理
+    IOManager *work = m_acceptWorkers.empty() ? m_work : IOManager::GetThis();
+    std::vector<Socket::ptr> clients;
+    std::vector<std::function<void()>> tasks;
     while (!m_isStop) {
-        Socket::ptr client = sock->accept();
-        if (client) {
-            client->setRecvTimeOut((int64_t)m_readTimeout);
-            m_work->schedule(std::bind(&TCPServer::handleClient, shared_from_this(), client));
-        } else {
+        clients.clear();
+        if (sock->accept(clients, m_acceptBatch) > 0) {
+            m_acceptCount += clients.size();
+            tasks.clear();
+            for (auto &client : clients) {
+                client->setRecvTimeOut((int64_t)m_readTimeout);
+                tasks.push_back(std::bind(&TCPServer::handleClient, shared_from_this(), client));
+            }
+            // 一批连接一次放入调度队列，只加一次锁、最多唤醒一次
+            work->schedule(tasks.begin(), tasks.end());
+            // 连接在本线程处理时，backlog一直不空accept就不会EAGAIN挂起，让出执行权避免饿死已接入的连接
+            if (work == IOManager::GetThis() && work->getWorkerCount() == 1) {
+                Fiber::YieldToReady();
+            }
+        } else if (!m_isStop) {
             CXS_LOG_ERROR(g_logger) << "accept fail errno :"
                                     << errno << " errstr = " << strerror(errno);
         }
     }
 }
-
 bool TCPServer::start() {
     if (!m_isStop) {
         return true;
     }
     m_isStop = false;
-    for (auto &sock : m_socks) {
-        m_acceptWork->schedule(std::bind(&TCPServer::startAccept, shared_from_this(), sock));
+    for (auto &i : m_socks) {
+        i.iom->schedule(std::bind(&TCPServer::startAccept, shared_from_this(), i.sock));
     }
     return true;
 }
 
 void TCPServer::stop() {
     m_isStop = true;
-    m_acceptWork->schedule([this]() {
-        for (auto &sock : m_socks) {
-            sock->cancelAll();
-            sock->close();
-        }
-        m_socks.clear();
-    });
+    std::vector<Listener> socks;
+    socks.swap(m_socks);
+    for (auto &i : socks) {
+        // 先cancelAll再close时，其他线程上被唤醒的accept协程可能在close之前重试、EAGAIN后重新等待，
+        // close后fd从epoll中移除，该协程再也不会被唤醒。shutdown唤醒所有等待者(包括其他IOManager上以
+        // EPOLLEXCLUSIVE等待的)，之后accept总是返回EINVAL，socket在最后一个accept协程退出后关闭
+        ::shutdown(i.sock->getSocket(), SHUT_RDWR);
+    }
 }
-} // namespace CXS
\ No newline at end of file
+} // namespace CXS
@@ -4,6 +4,7 @@
 #include "address.h"
 #include "iomanager.h"
 #include "socket.h"
+#include <atomic>
 #include <cstdint>
 #include <memory>
 #include <functional>
@@ -15,6 +16,15 @@ namespace CXS {
 class TCPServer : public std::enable_shared_from_this<TCPServer>, Noncopyable {
 public:
     typedef std::shared_ptr<TCPServer> ptr;
+    // 监听方式，默认取tcp_server.accept_mode配置(single/reuseport/exclusive)
+    enum class AcceptMode {
+        // 每个地址一个监听socket，一个accept协程
+        SINGLE,
+        // 每个accept分片一个SO_REUSEPORT监听socket，由内核把连接分散到各分片
+        REUSEPORT,
+        // 每个地址一个监听socket，各accept IOManager以EPOLLEXCLUSIVE等待，连接到达只唤醒一个
+        EXCLUSIVE
+    };
     TCPServer(CXS::IOManager *work = CXS::IOManager::GetThis(),
               CXS::IOManager *acceptWorker = CXS::IOManager::GetThis());
     virtual ~TCPServer();
@@ -24,6 +34,23 @@ public:
     virtual bool start();
     virtual void stop();
 
+    // 在bind之前设置
+    void setAcceptMode(AcceptMode mode) {
+        m_acceptMode = mode;
+    }
+    AcceptMode getAcceptMode() const {
+        return m_acceptMode;
+    }
+    // 在bind之前设置，每个IOManager是一个accept分片，连接在accept它的IOManager上处理
+    // 不设置时只有构造时的acceptWorker，REUSEPORT和EXCLUSIVE都退化为SINGLE:
+    // 一个IOManager内的协程可以在任意线程上被唤醒和窃取，多开监听socket也不能按线程分片
+    void setAcceptWorkers(const std::vector<IOManager *> &workers) {
+        m_acceptWorkers = workers;
+    }
+    uint64_t getAcceptCount() const {
+        return m_acceptCount;
+    }
+
     uint64_t getReadTimeout() const {
         return m_readTimeout;
     };
@@ -48,10 +75,20 @@ protected:
     virtual void startAccept(Socket::ptr sock);
 
 private:
-    std::vector<Socket::ptr> m_socks;
+    // 监听socket及运行其accept协程的IOManager，EXCLUSIVE模式下同一个socket在每个分片上各有一项
+    struct Listener {
+        Socket::ptr sock;
+        IOManager *iom;
+    };
+    std::vector<Listener> m_socks;
     IOManager *m_work;
     IOManager *m_acceptWork;
+    std::vector<IOManager *> m_acceptWorkers;
+    AcceptMode m_acceptMode;
+    std::atomic<uint64_t> m_acceptCount = {0};
     uint64_t m_readTimeout;
+    // 一次accept最多取出的连接数
+    size_t m_acceptBatch;
     std::string m_name;
     bool m_isStop;
 };
@@ -1,41 +1,22 @@
 #include "timer.h"
 #include "util.h"
+#include <string.h>
 namespace CXS
 {
-    bool Timer::Comparator::operator()(const Timer::ptr &lhs, const Timer::ptr &rhs) const
-    {
-        if (!lhs && !rhs)
-        {
-            return false;
-        }
-        if (!lhs)
-        {
-            return true;
-        }
-        if (!rhs)
-        {
-            return false;
-        }
-
-        if (lhs->m_next < rhs->m_next)
-        {
-            return true;
-        }
-        if (lhs->m_next > rhs->m_next)
-        {
-            return false;
-        }
-        return lhs.get() < rhs.get();
-    }
-
     bool Timer::cancel()
     {
+        // self在解锁后释放，定时器可能只剩时间轮持有的引用
+        Timer::ptr self;
         TimerManager::RWMutexType::WriteLock lock(m_manager->m_mutex);
         if (m_cb)
         {
             m_cb = nullptr;
-            auto it = m_manager->m_timers.find(shared_from_this());
-            m_manager->m_timers.erase(it);
+            if (m_level >= 0)
+            {
+                m_manager->unlink(this);
+                self.swap(m_self);
+            }
+            lock.unlock();
             return true;
         }
         return false;
@@ -47,15 +28,13 @@ namespace CXS
         {
             return false;
         }
-        auto it = m_manager->m_timers.find(shared_from_this());
-
-        if (it == m_manager->m_timers.end())
+        if (m_level < 0)
         {
             return false;
         }
-        m_manager->m_timers.erase(it);
+        m_manager->unlink(this);
         m_next = CXS::GetCurrentMS() + m_ms;
-        m_manager->m_timers.insert(shared_from_this());
+        m_manager->link(this);
         return true;
     }
     bool Timer::reset(uint64_t ms, bool from_now)
@@ -69,12 +48,13 @@ namespace CXS
         {
             return false;
         }
-        auto it = m_manager->m_timers.find(shared_from_this());
-        if (it == m_manager->m_timers.end())
+        if (m_level < 0)
         {
             return false;
         }
-        m_manager->m_timers.erase(it);
+        m_manager->unlink(this);
+        Timer::ptr self;
+        self.swap(m_self);
         uint64_t start = 0;
         if (from_now)
         {
@@ -86,7 +66,7 @@ namespace CXS
         }
         m_ms = ms;
         m_next = start + ms;
-        m_manager->addTimer(shared_from_this(), lock);
+        m_manager->addTimer(self, lock);
         return true;
     }
     Timer::Timer(uint64_t ms, std::function<void()> cb, bool recurring, TimerManager *manager)
@@ -97,19 +77,191 @@ namespace CXS
         m_manager = manager;
         m_next = CXS::GetCurrentMS() + m_ms;
     }
-    Timer::Timer(uint64_t next) : m_next(next) {}
     TimerManager::TimerManager()
     {
+        for (int i = 0; i < ROOT_SIZE; ++i)
+        {
+            m_root[i].prev = m_root[i].next = &m_root[i];
+        }
+        for (int l = 0; l < WHEEL_LEVELS - 1; ++l)
+        {
+            for (int i = 0; i < LEVEL_SIZE; ++i)
+            {
+                m_levels[l][i].prev = m_levels[l][i].next = &m_levels[l][i];
+            }
+        }
+        memset(m_rootBitmap, 0, sizeof(m_rootBitmap));
+        memset(m_levelCount, 0, sizeof(m_levelCount));
         m_previouseTime = GetCurrentMS();
+        m_current = m_previouseTime;
     }
 
     TimerManager::~TimerManager()
     {
+        // 释放时间轮中定时器对自身的引用
+        std::vector<Timer::ptr> timers;
+        takeAll(timers);
     }
+
+    void TimerManager::link(Timer *timer)
+    {
+        uint64_t expires = timer->m_next < m_current ? m_current : timer->m_next;
+        uint64_t delta = expires - m_current;
+        int level = 0;
+        int slot = 0;
+        TimerListNode *head = nullptr;
+        if (delta < (uint64_t)ROOT_SIZE)
+        {
+            slot = expires & (ROOT_SIZE - 1);
+            head = &m_root[slot];
+            m_rootBitmap[slot >> 6] |= 1ull << (slot & 63);
+        }
+        else
+        {
+            // 超出时间轮范围的放在最高层，下放时重新计算位置
+            static const uint64_t MAX_DELTA = (1ull << (ROOT_BITS + LEVEL_BITS * (WHEEL_LEVELS - 1))) - 1;
+            if (delta > MAX_DELTA)
+            {
+                delta = MAX_DELTA;
+                expires = m_current + delta;
+            }
+            level = 1;
+            while (level < WHEEL_LEVELS - 1 && delta >= (1ull << (ROOT_BITS + LEVEL_BITS * level)))
+            {
+                ++level;
+            }
+            slot = (expires >> (ROOT_BITS + LEVEL_BITS * (level - 1))) & (LEVEL_SIZE - 1);
+            head = &m_levels[level - 1][slot];
+        }
+        timer->prev = head->prev;
+        timer->next = head;
+        head->prev->next = timer;
+        head->prev = timer;
+        timer->m_level = level;
+        timer->m_slot = slot;
+        ++m_levelCount[level];
+        ++m_count;
+    }
+
+    void TimerManager::unlink(Timer *timer)
+    {
+        timer->prev->next = timer->next;
+        timer->next->prev = timer->prev;
+        if (timer->m_level == 0 && m_root[timer->m_slot].next == &m_root[timer->m_slot])
+        {
+            m_rootBitmap[timer->m_slot >> 6] &= ~(1ull << (timer->m_slot & 63));
+        }
+        timer->prev = timer->next = nullptr;
+        --m_levelCount[timer->m_level];
+        --m_count;
+        timer->m_level = -1;
+    }
+
+    void TimerManager::cascade(int level, int index)
+    {
+        TimerListNode *head = &m_levels[level - 1][index];
+        while (head->next != head)
+        {
+            Timer *timer = static_cast<Timer *>(head->next);
+            unlink(timer);
+            link(timer);
+        }
+    }
+
+    void TimerManager::takeAll(std::vector<Timer::ptr> &timers)
+    {
+        for (int i = 0; i < ROOT_SIZE; ++i)
+        {
+            while (m_root[i].next != &m_root[i])
+            {
+                Timer *timer = static_cast<Timer *>(m_root[i].next);
+                unlink(timer);
+                timers.push_back(std::move(timer->m_self));
+            }
+        }
+        for (int l = 0; l < WHEEL_LEVELS - 1; ++l)
+        {
+            for (int i = 0; i < LEVEL_SIZE; ++i)
+            {
+                while (m_levels[l][i].next != &m_levels[l][i])
+                {
+                    Timer *timer = static_cast<Timer *>(m_levels[l][i].next);
+                    unlink(timer);
+                    timers.push_back(std::move(timer->m_self));
+                }
+            }
+        }
+    }
+
+    // 第0层位图中从from开始的第一个非空槽位，没有返回-1
+    static int FindNextSlot(const uint64_t *bitmap, int words, int from)
+    {
+        int word = from >> 6;
+        if (word >= words)
+        {
+            return -1;
+        }
+        uint64_t bits = bitmap[word] & (~0ull << (from & 63));
+        while (true)
+        {
+            if (bits)
+            {
+                return (word << 6) + __builtin_ctzll(bits);
+            }
+            if (++word >= words)
+            {
+                return -1;
+            }
+            bits = bitmap[word];
+        }
+    }
+
+    uint64_t TimerManager::nextExpire()
+    {
+        if (m_count == 0)
+        {
+            return ~0ull;
+        }
+        int index = m_current & (ROOT_SIZE - 1);
+        uint64_t base = m_current - index;
+        if (index == 0 && m_levelCount[0] != m_count)
+        {
+            // 当前一圈的上层定时器还没有下放
+            return m_current;
+        }
+        if (m_levelCount[0])
+        {
+            int pos = FindNextSlot(m_rootBitmap, ROOT_SIZE / 64, index);
+            if (pos >= 0)
+            {
+                return base + pos;
+            }
+        }
+        uint64_t boundary = base + ROOT_SIZE;
+        if (m_levelCount[0] == m_count)
+        {
+            // 只剩第0层绕到下一圈的定时器
+            return boundary + FindNextSlot(m_rootBitmap, ROOT_SIZE / 64, 0);
+        }
+        // 上层定时器最早在下一圈开始时下放，到时再精确计算
+        return boundary;
+    }
+
     void TimerManager::addTimer(Timer::ptr val, RWMutexType::WriteLock &lock)
     {
-        auto it = m_timers.insert(val).first;
-        bool at_front = (it == m_timers.begin()) && !m_tickled;
+        if (m_count == 0)
+        {
+            // 没有定时器时时间轮可以直接跳到当前时间
+            m_current = GetCurrentMS();
+        }
+        Timer *timer = val.get();
+        link(timer);
+        timer->m_self.swap(val);
+        bool at_front = timer->m_next < m_earliest && !m_tickled;
+        if (timer->m_next < m_earliest)
+        {
+            m_earliest = timer->m_next;
+        }
         if (at_front)
         {
             m_tickled = true;
@@ -145,23 +297,23 @@ namespace CXS
     }
     uint64_t TimerManager::getNextTimer()
     {
-        RWMutexType::ReadLock lock(m_mutex);
+        RWMutexType::WriteLock lock(m_mutex);
         m_tickled = false;
-        if (m_timers.empty())
+        uint64_t next = nextExpire();
+        m_earliest = next;
+        if (next == ~0ull)
         {
             return ~0ull;
         }
 
-        const Timer::ptr &next = *m_timers.begin();
-
         uint64_t now_ms = CXS::GetCurrentMS();
-        if (now_ms >= next->m_next)
+        if (now_ms >= next)
         {
             return 0;
         }
         else
         {
-            return next->m_next - now_ms;
+            return next - now_ms;
         }
     }
 
@@ -172,36 +324,77 @@ namespace CXS
         std::vector<Timer::ptr> expired;
         {
             RWMutexType::ReadLock lock(m_mutex);
-            if (m_timers.empty())
+            if (m_count == 0)
             {
-                return; 
+                return;
             }
         }
         RWMutexType::WriteLock lock(m_mutex);
-
-        bool rollover = detectClockRollover(now_ms);
-        if (!rollover && (*m_timers.begin())->m_next > now_ms)
+        // 释放读锁后定时器可能已被其他线程取消
+        if (m_count == 0)
         {
             return;
         }
-        Timer::ptr now_timer(new Timer(now_ms));
 
-        auto it = rollover ? m_timers.end() : m_timers.lower_bound(now_timer);
-        while (it != m_timers.end() && (*it)->m_next == now_ms)
+        bool rollover = detectClockRollover(now_ms);
+        if (rollover)
+        {
+            takeAll(expired);
+            m_current = now_ms;
+        }
+        while (!rollover && m_current <= now_ms)
         {
-            ++it;
+            int index = m_current & (ROOT_SIZE - 1);
+            if (index == 0)
+            {
+                // 进入第0层新的一圈，逐层下放上层对应槽位
+                for (int level = 1; level < WHEEL_LEVELS; ++level)
+                {
+                    int slot = (m_current >> (ROOT_BITS + LEVEL_BITS * (level - 1))) & (LEVEL_SIZE - 1);
+                    cascade(level, slot);
+                    if (slot != 0)
+                    {
+                        break;
+                    }
+                }
+            }
+
+            TimerListNode *head = &m_root[index];
+            while (head->next != head)
+            {
+                Timer *timer = static_cast<Timer *>(head->next);
+                unlink(timer);
+                expired.push_back(std::move(timer->m_self));
+            }
+
+            if (m_count == 0)
+            {
+                m_current = now_ms + 1;
+                break;
+            }
+            // 跳过空槽位，直接到下一个非空槽位或下一圈开始
+            uint64_t next = m_current - index + ROOT_SIZE;
+            if (m_levelCount[0] && index + 1 < ROOT_SIZE)
+            {
+                int pos = FindNextSlot(m_rootBitmap, ROOT_SIZE / 64, index + 1);
+                if (pos >= 0)
+                {
+                    next = m_current - index + pos;
+                }
+            }
+            m_current = next < now_ms + 1 ? next : now_ms + 1;
         }
-        expired.insert(expired.begin(), m_timers.begin(), it);
-        m_timers.erase(m_timers.begin(), it);
-        cbs.reserve(expired.size());
 
+        cbs.reserve(cbs.size() + expired.size());
         for (auto &timer : expired)
         {
+            m_lateness.record(now_ms > timer->m_next ? now_ms - timer->m_next : 0);
             cbs.push_back(timer->m_cb);
             if (timer->m_recurring)
             {
                 timer->m_next = now_ms + timer->m_ms;
-                m_timers.insert(timer);
+                link(timer.get());
+                timer->m_self = timer;
             }
             else
             {
@@ -224,7 +417,7 @@ namespace CXS
     bool TimerManager::hasTimer()
     {
         RWMutexType::ReadLock lock(m_mutex);
-        return !m_timers.empty();
+        return m_count > 0;
     }
 
-}
\ No newline at end of file
+}
@@ -1,29 +1,35 @@
 #ifndef __CXS_TIMER_H__
 #define __CXS_TIMER_H__
-#include <set>
 #include <memory>
 #include "thread.h"
+#include "histogram.h"
 #include <stdint.h>
 #include <vector>
 #include <functional>
 namespace CXS
 {
     class TimerManager;
-    class Timer : public std::enable_shared_from_this<Timer>
+
+    // 时间轮槽位中的双向链表节点，槽位头为哨兵节点
+    struct TimerListNode
+    {
+        TimerListNode *prev = nullptr;
+        TimerListNode *next = nullptr;
+    };
+
+    class Timer : public std::enable_shared_from_this<Timer>, private TimerListNode
     {
         friend class TimerManager;
 
     public:
         typedef std::shared_ptr<Timer> ptr;
-        
+
         bool cancel();
         bool refresh();
         bool reset(uint64_t ms, bool from_now);
 
     private:
         Timer(uint64_t ms, std::function<void()> cb, bool recurring, TimerManager *manager);
-        Timer(uint64_t next);
-
 
     private:
         bool m_recurring = false;
@@ -31,14 +37,16 @@ namespace CXS
         uint64_t m_next = 0;
         TimerManager *m_manager = nullptr;
         std::function<void()> m_cb;
-
-    private:
-        struct Comparator
-        {
-            bool operator()(const Timer::ptr &lhs, const Timer::ptr &rhs) const;
-        };
+        // 所在时间轮层级和槽位，-1表示不在时间轮中
+        int m_level = -1;
+        int m_slot = 0;
+        // 在时间轮中时持有自身，保证只剩时间轮引用时定时器仍然有效
+        Timer::ptr m_self;
     };
 
+    // 定时器管理，使用分层时间轮
+    // 第0层256个槽位，每个槽位1ms；之后4层每层64个槽位，每层一个槽位覆盖下一层的一整圈
+    // 插入和取消O(1)，到期时上层槽位逐级下放到第0层
     class TimerManager
     {
         friend class Timer;
@@ -52,8 +60,11 @@ namespace CXS
 
         Timer::ptr addTimer(uint64_t ms, std::function<void()> cb, bool recurring = false);
         Timer::ptr addConditionTImer(uint64_t ms, std::function<void()> cb, std::weak_ptr<void> weal_cond, bool recurring = false);
+        // 距离下一个定时器到期的毫秒数(不晚于真实到期时间)，没有定时器返回~0ull
         uint64_t getNextTimer();
         void listExpiredTimer(std::vector<std::function<void()>> &cbs);
+        // 定时器被取出时比到期时间晚了多少毫秒
+        const Histogram &getTimerLateness() const { return m_lateness; }
 
     protected:
         virtual void onTimerInsertedAtFront() = 0;
@@ -61,10 +72,40 @@ namespace CXS
         bool hasTimer();
     private:
         bool detectClockRollover(uint64_t now_ms);
+        // 把定时器放入时间轮对应的槽位
+        void link(Timer *timer);
+        // 把定时器从所在槽位摘下
+        void unlink(Timer *timer);
+        // 把第level层index槽位的定时器重新放入下层
+        void cascade(int level, int index);
+        // 取出所有定时器
+        void takeAll(std::vector<Timer::ptr> &timers);
+        // 下一个定时器到期时间的下界
+        uint64_t nextExpire();
 
     private:
+        static const int WHEEL_LEVELS = 5;
+        static const int ROOT_BITS = 8;
+        static const int LEVEL_BITS = 6;
+        static const int ROOT_SIZE = 1 << ROOT_BITS;
+        static const int LEVEL_SIZE = 1 << LEVEL_BITS;
+
         RWMutexType m_mutex;
-        std::set<Timer::ptr, Timer::Comparator> m_timers;
+        // 第0层槽位
+        TimerListNode m_root[ROOT_SIZE];
+        // 第1~4层槽位
+        TimerListNode m_levels[WHEEL_LEVELS - 1][LEVEL_SIZE];
+        // 第0层非空槽位的位图
+        uint64_t m_rootBitmap[ROOT_SIZE / 64];
+        // 每层定时器数量
+        size_t m_levelCount[WHEEL_LEVELS];
+        // 定时器总数
+        size_t m_count = 0;
+        Histogram m_lateness;
+        // 时间轮当前处理到的毫秒，小于它的都已处理
+        uint64_t m_current = 0;
+        // 已通知idle的最早到期时间
+        uint64_t m_earliest = ~0ull;
         bool m_tickled = false;
         uint64_t m_previouseTime = 0;
 
@@ -1,14 +1,22 @@
 #include "util.h"
 #include "log.h"
 #include "fiber.hpp"
+#include "macro.h"
 #include <execinfo.h>
 #include <sys/time.h>
 namespace CXS
 {
     CXS::Logger::ptr g_logger = CXS_LOG_NAME("system");
+    // 线程id在线程内不变，缓存避免每次系统调用
+    static thread_local pid_t t_thread_id = 0;
+
     pid_t GetThreadId()
     {
-        return syscall(SYS_gettid);
+        if (CXS_UNLIKLY(!t_thread_id))
+        {
+            t_thread_id = syscall(SYS_gettid);
+        }
+        return t_thread_id;
     };
     uint32_t GetFiberId()
     {
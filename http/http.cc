@@ -5,6 +5,8 @@
 #include <string.h>
 #include <string>
 #include <strings.h>
+#include <stdio.h>
+#include <time.h>
 
 namespace CXS {
 
@@ -63,6 +65,15 @@ HttpRequest::HttpRequest(uint8_t version, bool close) :
     m_close(close), m_path("/") {
 }
 
+void HttpRequest::initClose() {
+    std::string conn = getHeaders("connection");
+    if (m_version >= 0x11) {
+        m_close = strcasecmp(conn.c_str(), "close") == 0;
+    } else {
+        m_close = strcasecmp(conn.c_str(), "keep-alive") != 0;
+    }
+}
+
 std::string HttpRequest::getHeaders(const std::string &key, const std::string &def) const {
     auto it = m_headers.find(key);
     if (it == m_headers.end()) {
@@ -171,6 +182,17 @@ HttpResponse::HttpResponse(uint8_t version, bool close) :
 }
 
 std::ostream &HttpResponse::dump(std::ostream &os) const {
+    dumpHeader(os, false);
+    if (!m_body.empty()) {
+        os << "content-length: " << m_body.size() << "\r\n\r\n"
+           << m_body;
+    } else {
+        os << "\r\n";
+    }
+    return os;
+}
+
+std::ostream &HttpResponse::dumpHeader(std::ostream &os, bool end) const {
     os << "HTTP/"
        << ((uint32_t)m_version >> 4) << "."
        << ((uint32_t)m_version & 0x0F) << " "
@@ -184,16 +206,115 @@ std::ostream &HttpResponse::dump(std::ostream &os) const {
         os << it.first << ": " << it.second << "\r\n";
     }
     os << "connection: " << (m_close ? "close" : "keep-alive") << "\r\n";
-
-    if (!m_body.empty()) {
-        os << "content-length: " << m_body.size() << "\r\n\r\n"
-           << m_body;
-    } else {
+    if (end) {
         os << "\r\n";
     }
     return os;
 }
 
+namespace {
+
+// "HTTP/1.x code reason\r\n"，下标为状态码，[0]为HTTP/1.0，[1]为HTTP/1.1
+struct StatusLineTable {
+    static const int MAX_STATUS = 600;
+    std::string lines[2][MAX_STATUS];
+
+    StatusLineTable() {
+#define XX(num, name, string)                                         \
+    lines[0][num] = "HTTP/1.0 " #num " " #string "\r\n"; \
+    lines[1][num] = "HTTP/1.1 " #num " " #string "\r\n";
+        HTTP_STATUS_MAP(XX);
+#undef XX
+    }
+
+    const std::string *get(uint8_t version, HttpStatus status) const {
+        int code = (int)status;
+        if ((version != 0x10 && version != 0x11) || code < 0 || code >= MAX_STATUS) {
+            return nullptr;
+        }
+        const std::string &line = lines[version & 0x01][code];
+        return line.empty() ? nullptr : &line;
+    }
+};
+
+void AppendDate(std::string &out) {
+    static thread_local time_t t_sec = 0;
+    static thread_local char t_buf[64];
+    static thread_local size_t t_len = 0;
+    time_t now = time(0);
+    if (now != t_sec) {
+        struct tm tm;
+        gmtime_r(&now, &tm);
+        t_len = strftime(t_buf, sizeof(t_buf), "date: %a, %d %b %Y %H:%M:%S GMT\r\n", &tm);
+        t_sec = now;
+    }
+    out.append(t_buf, t_len);
+}
+
+void AppendUInt(std::string &out, uint64_t v) {
+    char buf[24];
+    char *p = buf + sizeof(buf);
+    do {
+        *--p = '0' + v % 10;
+        v /= 10;
+    } while (v);
+    out.append(p, buf + sizeof(buf) - p);
+}
+
+} // namespace
+
+void HttpResponse::serializeHeader(std::string &out, bool with_length) const {
+    static const StatusLineTable s_table;
+    const std::string *line = m_reason.empty() ? s_table.get(m_version, m_status) : nullptr;
+    if (line) {
+        out.append(*line);
+    } else {
+        out.append("HTTP/");
+        AppendUInt(out, (uint32_t)m_version >> 4);
+        out.push_back('.');
+        AppendUInt(out, (uint32_t)m_version & 0x0F);
+        out.push_back(' ');
+        AppendUInt(out, (uint32_t)m_status);
+        out.push_back(' ');
+        out.append(m_reason.empty() ? HttpStatusToString(m_status) : m_reason);
+        out.append("\r\n");
+    }
+
+    bool has_date = false;
+    bool has_length = false;
+    for (auto &it : m_headers) {
+        const char *key = it.first.c_str();
+        if (strcasecmp(key, "connection") == 0) {
+            continue;
+        }
+        if (strcasecmp(key, "content-length") == 0 || strcasecmp(key, "transfer-encoding") == 0) {
+            // 有响应体时以实际长度为准
+            if (with_length && !m_body.empty()) {
+                continue;
+            }
+            has_length = true;
+        } else if (strcasecmp(key, "date") == 0) {
+            has_date = true;
+        }
+        out.append(it.first);
+        out.append(": ");
+        out.append(it.second);
+        out.append("\r\n");
+    }
+    if (!has_date) {
+        AppendDate(out);
+    }
+    out.append(m_close ? "connection: close\r\n" : "connection: keep-alive\r\n");
+    // 1xx/204/304不能带响应体，其余空响应体也要声明长度，否则保持连接的客户端会一直等
+    int code = (int)m_status;
+    if (with_length && !has_length && !(code < 200 || code == 204 || code == 304)) {
+        out.append("content-length: ");
+        AppendUInt(out, m_body.size());
+        out.append("\r\n");
+    }
+    out.append("\r\n");
+}
+
 std::string HttpResponse::toString() const {
     std::stringstream ss;
     dump(ss);
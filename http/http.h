@@ -193,6 +193,9 @@ public:
     const std::string &getQuery() const {
         return m_query;
     }
+    const std::string &getBody() const {
+        return m_body;
+    }
 
     const MapType &getHeaders() const {
         return m_headers;
@@ -240,6 +243,8 @@ public:
     void setClose(bool close) {
         m_close = close;
     }
+    // 根据版本和connection头决定是否保持连接：HTTP/1.1默认保持，HTTP/1.0默认关闭
+    void initClose();
     std::string getHeaders(const std::string &key, const std::string &def = "") const;
     std::string getParams(const std::string &key, const std::string &def = "") const;
     std::string getCookies(const std::string &key, const std::string &def = "") const;
@@ -371,6 +376,12 @@ public:
     }
     std::string toString() const;
     std::ostream &dump(std::ostream &os) const;
+    // 只输出状态行和头部，不带响应体也不补content-length，end为true时输出结尾的空行
+    std::ostream &dumpHeader(std::ostream &os, bool end = true) const;
+    // 发送用的序列化：状态行和头部追加到out尾部，以空行结束，不含响应体
+    // 状态行查预先生成的表，Date头每个线程每秒格式化一次
+    // with_length为true时按响应体补content-length，流式响应传false
+    void serializeHeader(std::string &out, bool with_length = true) const;
 
 private:
     HttpStatus m_status;
@@ -0,0 +1,538 @@
+#include "http_connection.h"
+#include "../code/config.hpp"
+#include "../code/fd_manager.h"
+#include "../code/iomanager.h"
+#include "../code/log.h"
+#include "../code/util.h"
+#include <errno.h>
+#include <sstream>
+#include <strings.h>
+
+namespace CXS {
+namespace http {
+
+static CXS::Logger::ptr g_logger = CXS_LOG_NAME("system");
+
+static CXS::ConfigVar<uint32_t>::ptr g_http_client_pool_max_size =
+    CXS::Config::Lookup("http.client.pool.max_size", (uint32_t)64, "http client max connections per host");
+static CXS::ConfigVar<uint32_t>::ptr g_http_client_pool_max_idle =
+    CXS::Config::Lookup("http.client.pool.max_idle_ms", (uint32_t)(30 * 1000), "http client max idle time of connection");
+static CXS::ConfigVar<uint32_t>::ptr g_http_client_pool_max_alive =
+    CXS::Config::Lookup("http.client.pool.max_alive_ms", (uint32_t)(120 * 1000), "http client max alive time of connection");
+static CXS::ConfigVar<uint32_t>::ptr g_http_client_pool_max_requests =
+    CXS::Config::Lookup("http.client.pool.max_requests", (uint32_t)1000, "http client max requests per connection");
+
+std::string HttpResult::toString() const {
+    std::stringstream ss;
+    ss << "[HttpResult result=" << result << " error=" << error
+       << " response=" << (response ? response->toString() : "nullptr") << "]";
+    return ss.str();
+}
+
+HttpConnection::HttpConnection(Socket::ptr sock, bool owner) :
+    SocketStream(sock, owner),
+    m_input(this),
+    m_createTime(GetCurrentMS()) {
+    m_input.setBeforeRead([this]() {
+        return applyDeadline(SO_RCVTIMEO);
+    });
+}
+
+bool HttpConnection::applyDeadline(int type) {
+    FdCtx::ptr ctx = FdMgr::GetInstance()->get(getSocket()->getSocket());
+    if (!ctx) {
+        return true;
+    }
+    if (!m_deadline) {
+        ctx->setTimeout(type, -1);
+        return true;
+    }
+    // 超时由hook中的定时器保证，这里只更新fd上的超时时间，不需要系统调用
+    uint64_t now = GetCurrentMS();
+    if (now >= m_deadline) {
+        errno = ETIMEDOUT;
+        return false;
+    }
+    ctx->setTimeout(type, m_deadline - now);
+    return true;
+}
+
+int HttpConnection::sendRequest(HttpRequest::ptr request) {
+    return sendRequests(std::vector<HttpRequest::ptr>{request});
+}
+
+int HttpConnection::sendRequests(const std::vector<HttpRequest::ptr> &requests) {
+    std::stringstream ss;
+    for (auto &i : requests) {
+        i->dump(ss);
+    }
+    m_sendBuf = ss.str();
+    if (!applyDeadline(SO_SNDTIMEO)) {
+        return -1;
+    }
+    int rt = writeFixSize(m_sendBuf.c_str(), m_sendBuf.size());
+    if (rt <= 0) {
+        m_broken = true;
+    }
+    return rt;
+}
+
+HttpResponse::ptr HttpConnection::recvResponse(bool has_body) {
+    m_parser.reset();
+    m_input.setBody(HttpInput::BodyMode::NONE);
+    size_t header_len = m_input.readHeader();
+    if (!header_len) {
+        m_broken = true;
+        return nullptr;
+    }
+    // 响应parser要求数据以'\0'结尾，readHeader保证后面有一个字节可写
+    char *data = m_input.begin();
+    char saved = data[header_len];
+    data[header_len] = '\0';
+    m_parser.execute(data, header_len);
+    data[header_len] = saved;
+    if (m_parser.hasError() || !m_parser.isFinished()) {
+        CXS_LOG_WARN(g_logger) << "invalid http response: " << std::string(data, header_len);
+        m_broken = true;
+        return nullptr;
+    }
+    m_input.consume(header_len);
+
+    HttpResponse::ptr response = m_parser.getData();
+    std::string conn = response->getHeader("connection");
+    if (response->getVersion() >= 0x11) {
+        response->setClose(strcasecmp(conn.c_str(), "close") == 0);
+    } else {
+        response->setClose(strcasecmp(conn.c_str(), "keep-alive") != 0);
+    }
+
+    int status = (int)response->getStatus();
+    std::string te = response->getHeader("transfer-encoding");
+    std::string cl = response->getHeader("content-length");
+    if (!has_body || (status >= 100 && status < 200) || status == 204 || status == 304) {
+        m_input.setBody(HttpInput::BodyMode::NONE);
+    } else if (!te.empty() && strcasestr(te.c_str(), "chunked")) {
+        m_input.setBody(HttpInput::BodyMode::CHUNKED);
+    } else if (!cl.empty()) {
+        m_input.setBody(HttpInput::BodyMode::LENGTH, m_parser.getContentLength());
+    } else {
+        // 没有长度的响应只能读到连接关闭
+        m_input.setBody(HttpInput::BodyMode::UNTIL_CLOSE);
+        response->setClose(true);
+    }
+    std::string body;
+    if (!m_input.loadBody(body, HttpRequestParser::GetHttpRequestMaxBodySize())) {
+        m_broken = true;
+        return nullptr;
+    }
+    response->setBody(body);
+    ++m_requestCount;
+    if (response->isClose()) {
+        m_broken = true;
+    }
+    return response;
+}
+
+struct HttpConnectionPool::Waiter {
+    Scheduler *scheduler;
+    Fiber::ptr fiber;
+    HttpConnection *conn = nullptr;
+    // 已经被归还的连接或者超时唤醒过，防止重复调度
+    bool done = false;
+};
+
+HttpConnectionPool::HttpConnectionPool(const std::string &host, uint32_t port, uint32_t max_size,
+                                       uint32_t max_idle_ms, uint32_t max_alive_ms, uint32_t max_requests) :
+    m_host(host),
+    m_port(port),
+    m_maxSize(max_size),
+    m_maxIdle(max_idle_ms),
+    m_maxAlive(max_alive_ms),
+    m_maxRequest(max_requests) {
+}
+
+HttpConnectionPool::~HttpConnectionPool() {
+    // 借出的连接持有连接池的智能指针，析构时只剩空闲连接
+    for (auto i : m_idle) {
+        delete i;
+    }
+}
+
+bool HttpConnectionPool::isExpired(HttpConnection *conn, uint64_t now) const {
+    return !conn->isConnected() || conn->isBroken()
+           || (m_maxAlive && now >= conn->m_createTime + m_maxAlive)
+           || (m_maxIdle && now >= conn->m_lastUsedTime + m_maxIdle)
+           || (m_maxRequest && conn->m_requestCount >= m_maxRequest);
+}
+
+HttpConnection *HttpConnectionPool::create(uint64_t deadline) {
+    Address::ptr addr;
+    {
+        MutexType::Lock lock(m_mutex);
+        addr = m_addr;
+    }
+    if (!addr) {
+        // 只解析一次
+        addr = Address::LookupAny(m_host);
+        IPAddress::ptr ip = std::dynamic_pointer_cast<IPAddress>(addr);
+        if (!ip) {
+            CXS_LOG_ERROR(g_logger) << "http connection pool invalid host: " << m_host;
+            return nullptr;
+        }
+        ip->setPort(m_port);
+        MutexType::Lock lock(m_mutex);
+        m_addr = addr;
+    }
+    int64_t timeout = -1;
+    if (deadline) {
+        uint64_t now = GetCurrentMS();
+        if (now >= deadline) {
+            return nullptr;
+        }
+        timeout = deadline - now;
+    }
+    Socket::ptr sock = Socket::CreateTCP(addr);
+    m_connects.fetch_add(1, std::memory_order_relaxed);
+    if (!sock->connect(addr, timeout)) {
+        m_connectFailures.fetch_add(1, std::memory_order_relaxed);
+        CXS_LOG_WARN(g_logger) << "http connection pool connect fail: " << *addr
+                               << " errno=" << errno << " " << strerror(errno);
+        return nullptr;
+    }
+    return new HttpConnection(sock);
+}
+
+HttpConnection::ptr HttpConnectionPool::getConnection(uint64_t timeout_ms) {
+    uint64_t deadline = timeout_ms ? GetCurrentMS() + timeout_ms : 0;
+    bool waited = false;
+    while (true) {
+        uint64_t now = GetCurrentMS();
+        std::vector<HttpConnection *> expired;
+        HttpConnection *conn = nullptr;
+        bool need_create = false;
+        std::shared_ptr<Waiter> waiter;
+        Timer::ptr timer;
+        {
+            MutexType::Lock lock(m_mutex);
+            // 优先用最近归还的连接，更早归还的更可能已经被对端关闭
+            while (!m_idle.empty()) {
+                HttpConnection *c = m_idle.back();
+                m_idle.pop_back();
+                if (isExpired(c, now)) {
+                    expired.push_back(c);
+                    --m_total;
+                    continue;
+                }
+                conn = c;
+                break;
+            }
+            if (!conn && m_total < m_maxSize) {
+                ++m_total;
+                need_create = true;
+            } else if (!conn) {
+                IOManager *iom = IOManager::GetThis();
+                if (!iom || (deadline && now >= deadline)) {
+                    lock.unlock();
+                    for (auto i : expired) {
+                        delete i;
+                    }
+                    return nullptr;
+                }
+                waiter.reset(new Waiter);
+                waiter->scheduler = Scheduler::GetThis();
+                waiter->fiber = Fiber::GetThis();
+                m_waiters.push_back(waiter);
+                if (deadline) {
+                    std::weak_ptr<Waiter> weak(waiter);
+                    HttpConnectionPool::ptr self = shared_from_this();
+                    timer = iom->addTimer(deadline - now, [weak, self]() {
+                        std::shared_ptr<Waiter> w = weak.lock();
+                        if (!w) {
+                            return;
+                        }
+                        MutexType::Lock lock(self->m_mutex);
+                        if (w->done) {
+                            return;
+                        }
+                        w->done = true;
+                        self->m_waiters.remove(w);
+                        w->scheduler->schedule(w->fiber);
+                    });
+                }
+            }
+        }
+        for (auto i : expired) {
+            delete i;
+        }
+
+        if (need_create) {
+            if (!waited) {
+                m_misses.fetch_add(1, std::memory_order_relaxed);
+            }
+            conn = create(deadline);
+            if (!conn) {
+                MutexType::Lock lock(m_mutex);
+                --m_total;
+                return nullptr;
+            }
+        } else if (waiter) {
+            if (!waited) {
+                m_misses.fetch_add(1, std::memory_order_relaxed);
+                m_waits.fetch_add(1, std::memory_order_relaxed);
+                waited = true;
+            }
+            uint64_t begin = GetCurrentUS();
+            Fiber::YieldToHold();
+            m_waitUs.fetch_add(GetCurrentUS() - begin, std::memory_order_relaxed);
+            if (timer) {
+                timer->cancel();
+            }
+            // 被唤醒时要么拿到了归还的连接，要么有连接被关闭可以新建，要么超时
+            conn = waiter->conn;
+            if (!conn) {
+                continue;
+            }
+        } else if (!waited) {
+            m_hits.fetch_add(1, std::memory_order_relaxed);
+        }
+        conn->setDeadline(0);
+        return HttpConnection::ptr(conn, std::bind(&HttpConnectionPool::ReleasePtr,
+                                                   std::placeholders::_1, shared_from_this()));
+    }
+}
+
+void HttpConnectionPool::ReleasePtr(HttpConnection *conn, HttpConnectionPool::ptr pool) {
+    pool->release(conn);
+}
+
+void HttpConnectionPool::release(HttpConnection *conn) {
+    uint64_t now = GetCurrentMS();
+    conn->m_lastUsedTime = now;
+    conn->setDeadline(0);
+    std::shared_ptr<Waiter> waiter;
+    {
+        MutexType::Lock lock(m_mutex);
+        if (!m_waiters.empty()) {
+            waiter = m_waiters.front();
+            m_waiters.pop_front();
+            waiter->done = true;
+        }
+        if (isExpired(conn, now)) {
+            // 连接数减少了，唤醒的等待者会重新去新建连接
+            --m_total;
+        } else if (waiter) {
+            // 直接交给等待最久的请求
+            waiter->conn = conn;
+            conn = nullptr;
+        } else {
+            m_idle.push_back(conn);
+            conn = nullptr;
+        }
+        if (waiter) {
+            waiter->scheduler->schedule(waiter->fiber);
+        }
+    }
+    delete conn;
+}
+
+void HttpConnectionPool::prepare(HttpRequest::ptr request) {
+    if (request->getHeaders("host").empty()) {
+        if (m_port == 80) {
+            request->setHeader("Host", m_host);
+        } else {
+            request->setHeader("Host", m_host + ":" + std::to_string(m_port));
+        }
+    }
+    // 默认keep-alive，调用方显式带了connection头时按它的要求
+    if (request->getHeaders("connection").empty()) {
+        request->setClose(false);
+    } else {
+        request->initClose();
+    }
+}
+
+HttpResult::ptr HttpConnectionPool::doGet(const std::string &path, uint64_t timeout_ms,
+                                          const std::map<std::string, std::string> &headers) {
+    return doRequest(HttpMethod::GET, path, timeout_ms, headers);
+}
+
+HttpResult::ptr HttpConnectionPool::doPost(const std::string &path, uint64_t timeout_ms,
+                                           const std::map<std::string, std::string> &headers,
+                                           const std::string &body) {
+    return doRequest(HttpMethod::POST, path, timeout_ms, headers, body);
+}
+
+HttpResult::ptr HttpConnectionPool::doRequest(HttpMethod method, const std::string &path, uint64_t timeout_ms,
+                                              const std::map<std::string, std::string> &headers,
+                                              const std::string &body) {
+    HttpRequest::ptr request(new HttpRequest);
+    request->setMethod(method);
+    size_t pos = path.find('?');
+    if (pos == std::string::npos) {
+        request->setPath(path);
+    } else {
+        request->setPath(path.substr(0, pos));
+        request->setQuery(path.substr(pos + 1));
+    }
+    for (auto &i : headers) {
+        request->setHeader(i.first, i.second);
+    }
+    request->setBody(body);
+    return doRequest(request, timeout_ms);
+}
+
+HttpResult::ptr HttpConnectionPool::doRequest(HttpRequest::ptr request, uint64_t timeout_ms) {
+    std::vector<HttpResult::ptr> results = doRequests(std::vector<HttpRequest::ptr>{request}, timeout_ms);
+    return results[0];
+}
+
+// 可以安全地在同一连接上连续发送，也可以在连接失效后重发
+static bool IsIdempotent(HttpMethod method) {
+    return method == HttpMethod::GET || method == HttpMethod::HEAD;
+}
+
+// hook超时返回时errno为ETIMEDOUT，中间打日志等可能覆盖errno，同时用截止时间判断
+static bool IsTimeout(HttpConnection::ptr conn) {
+    return errno == ETIMEDOUT || (conn->getDeadline() && GetCurrentMS() >= conn->getDeadline());
+}
+
+size_t HttpConnectionPool::pipeline(HttpConnection::ptr conn, const std::vector<HttpRequest::ptr> &requests,
+                                    size_t begin, size_t end, std::vector<HttpResult::ptr> &results) {
+    std::vector<HttpRequest::ptr> batch(requests.begin() + begin, requests.begin() + end);
+    int rt = conn->sendRequests(batch);
+    if (rt <= 0) {
+        int error = (int)(IsTimeout(conn) ? HttpResult::Error::TIMEOUT
+                          : rt == 0        ? HttpResult::Error::SEND_CLOSE_BY_PEER
+                                           : HttpResult::Error::SEND_SOCKET_ERROR);
+        results[begin] = std::make_shared<HttpResult>(error, nullptr, strerror(errno));
+        return 0;
+    }
+    size_t done = 0;
+    for (size_t i = begin; i < end; ++i) {
+        HttpResponse::ptr rsp = conn->recvResponse(requests[i]->getMethod() != HttpMethod::HEAD);
+        if (!rsp) {
+            bool timeout = IsTimeout(conn);
+            int error = (int)(timeout ? HttpResult::Error::TIMEOUT : HttpResult::Error::RECV_ERROR);
+            results[i] = std::make_shared<HttpResult>(error, nullptr,
+                                                      timeout ? "recv timeout" : "recv fail");
+            break;
+        }
+        results[i] = std::make_shared<HttpResult>((int)HttpResult::Error::OK, rsp, "ok");
+        ++done;
+        if (requests[i]->isClose()) {
+            // 调用方要求关闭的连接用完不放回连接池
+            conn->m_broken = true;
+            break;
+        }
+        if (rsp->isClose()) {
+            // 对端关闭后剩下的请求不会再有响应
+            break;
+        }
+    }
+    return done;
+}
+
+std::vector<HttpResult::ptr> HttpConnectionPool::doRequests(const std::vector<HttpRequest::ptr> &requests,
+                                                            uint64_t timeout_ms) {
+    std::vector<HttpResult::ptr> results(requests.size());
+    uint64_t deadline = timeout_ms ? GetCurrentMS() + timeout_ms : 0;
+    size_t pos = 0;
+    bool retried = false;
+    for (auto &i : requests) {
+        prepare(i);
+    }
+    while (pos < requests.size()) {
+        // 连续的GET/HEAD一起流水线发送，其他方法单独发送
+        size_t end = pos + 1;
+        if (IsIdempotent(requests[pos]->getMethod())) {
+            // 要求关闭的请求之后不再接着流水线发送
+            while (end < requests.size() && IsIdempotent(requests[end]->getMethod())
+                   && !requests[end - 1]->isClose()) {
+                ++end;
+            }
+        }
+        uint64_t left = 0;
+        if (deadline) {
+            uint64_t now = GetCurrentMS();
+            left = now < deadline ? deadline - now : 0;
+            if (!left) {
+                m_timeouts.fetch_add(1, std::memory_order_relaxed);
+                results[pos] = std::make_shared<HttpResult>((int)HttpResult::Error::TIMEOUT,
+                                                            nullptr, "timeout");
+                break;
+            }
+        }
+        HttpConnection::ptr conn = getConnection(left);
+        if (!conn) {
+            bool timeout = deadline && GetCurrentMS() >= deadline;
+            if (timeout) {
+                m_timeouts.fetch_add(1, std::memory_order_relaxed);
+            }
+            results[pos] = std::make_shared<HttpResult>(
+                (int)(timeout ? HttpResult::Error::TIMEOUT : HttpResult::Error::CONNECT_FAIL),
+                nullptr, "get connection fail, host=" + m_host + ":" + std::to_string(m_port));
+            break;
+        }
+        bool reused = conn->getRequestCount() > 0;
+        conn->setDeadline(deadline);
+        m_requests.fetch_add(end - pos, std::memory_order_relaxed);
+        size_t done = pipeline(conn, requests, pos, end, results);
+        if (done < end - pos && results[pos + done]) {
+            if (results[pos + done]->result == (int)HttpResult::Error::TIMEOUT) {
+                m_timeouts.fetch_add(1, std::memory_order_relaxed);
+                break;
+            }
+            // 复用的连接可能已经被对端关闭，一个响应都没收到时重试一次
+            if (done == 0 && reused && !retried && IsIdempotent(requests[pos]->getMethod())) {
+                retried = true;
+                results[pos].reset();
+                continue;
+            }
+            break;
+        }
+        // 中途被关闭时未处理的流水线请求在新连接上重发
+        pos += done;
+        retried = false;
+    }
+    for (auto &i : results) {
+        if (!i) {
+            i = std::make_shared<HttpResult>((int)HttpResult::Error::NOT_SENT, nullptr, "not sent");
+        }
+    }
+    return results;
+}
+
+HttpConnectionPool::Stats HttpConnectionPool::getStats() const {
+    Stats s;
+    s.hits = m_hits.load(std::memory_order_relaxed);
+    s.misses = m_misses.load(std::memory_order_relaxed);
+    s.connects = m_connects.load(std::memory_order_relaxed);
+    s.connect_failures = m_connectFailures.load(std::memory_order_relaxed);
+    s.waits = m_waits.load(std::memory_order_relaxed);
+    s.wait_us = m_waitUs.load(std::memory_order_relaxed);
+    s.timeouts = m_timeouts.load(std::memory_order_relaxed);
+    s.requests = m_requests.load(std::memory_order_relaxed);
+    MutexType::Lock lock(m_mutex);
+    s.idle = m_idle.size();
+    s.total = m_total;
+    return s;
+}
+
+HttpConnectionPool::ptr HttpConnectionPoolManager::get(const std::string &host, uint32_t port) {
+    std::string key = host + ":" + std::to_string(port);
+    Mutex::Lock lock(m_mutex);
+    auto it = m_pools.find(key);
+    if (it != m_pools.end()) {
+        return it->second;
+    }
+    HttpConnectionPool::ptr pool(new HttpConnectionPool(host, port,
+                                                        g_http_client_pool_max_size->getValue(),
+                                                        g_http_client_pool_max_idle->getValue(),
+                                                        g_http_client_pool_max_alive->getValue(),
+                                                        g_http_client_pool_max_requests->getValue()));
+    m_pools[key] = pool;
+    return pool;
+}
+
+}
+} // namespace CXS::http
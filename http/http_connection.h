@@ -0,0 +1,182 @@
+#ifndef __CXS_HTTP_CONNECTION_H__
+#define __CXS_HTTP_CONNECTION_H__
+#include "../code/socket_stream.h"
+#include "../code/singleton.h"
+#include "../code/thread.h"
+#include "http.h"
+#include "http_input.h"
+#include "http_parser.h"
+#include <atomic>
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+namespace CXS {
+namespace http {
+
+struct HttpResult {
+    typedef std::shared_ptr<HttpResult> ptr;
+    enum class Error {
+        OK = 0,
+        // 地址解析或者连接失败
+        CONNECT_FAIL = 1,
+        SEND_CLOSE_BY_PEER = 2,
+        SEND_SOCKET_ERROR = 3,
+        // 等待连接、读写超时
+        TIMEOUT = 4,
+        RECV_ERROR = 5,
+        // 前面的请求失败，没有发送
+        NOT_SENT = 6
+    };
+    HttpResult(int result_, HttpResponse::ptr response_, const std::string &error_) :
+        result(result_), response(response_), error(error_) {}
+    int result;
+    HttpResponse::ptr response;
+    std::string error;
+
+    std::string toString() const;
+};
+
+class HttpConnectionPool;
+
+// 客户端连接，可以连续发送多个请求(流水线)，响应按顺序读取
+class HttpConnection : public SocketStream {
+    friend class HttpConnectionPool;
+
+public:
+    typedef std::shared_ptr<HttpConnection> ptr;
+    HttpConnection(Socket::ptr sock, bool owner = true);
+
+    int sendRequest(HttpRequest::ptr request);
+    // 多个请求一次写出
+    int sendRequests(const std::vector<HttpRequest::ptr> &requests);
+    // 读一个完整的响应，has_body为false时(HEAD请求)不读响应体
+    HttpResponse::ptr recvResponse(bool has_body = true);
+
+    // 本次请求的截止时间(ms，GetCurrentMS)，之后每次阻塞读写的超时都不超过剩余时间，0表示不限制
+    void setDeadline(uint64_t deadline_ms) { m_deadline = deadline_ms; }
+    uint64_t getDeadline() const { return m_deadline; }
+    // 对端要求关闭或者读写出错，不能再复用
+    bool isBroken() const { return m_broken; }
+    uint64_t getCreateTime() const { return m_createTime; }
+    uint64_t getRequestCount() const { return m_requestCount; }
+
+private:
+    // 按截止时间设置fd上的读写超时，已经超时返回false
+    bool applyDeadline(int type);
+
+private:
+    HttpInput m_input;
+    HttpResponseParser m_parser;
+    std::string m_sendBuf;
+    uint64_t m_deadline = 0;
+    uint64_t m_createTime = 0;
+    // 放回连接池的时间
+    uint64_t m_lastUsedTime = 0;
+    uint64_t m_requestCount = 0;
+    bool m_broken = false;
+};
+
+// 同一个host:port的keep-alive连接池
+// 连接空闲超过max_idle_ms、存活超过max_alive_ms或者处理了max_requests个请求后不再复用
+// 连接数达到max_size时在协程中等待其他请求归还连接
+class HttpConnectionPool : public std::enable_shared_from_this<HttpConnectionPool> {
+public:
+    typedef std::shared_ptr<HttpConnectionPool> ptr;
+    typedef Mutex MutexType;
+
+    struct Stats {
+        // 复用了空闲连接
+        uint64_t hits = 0;
+        // 没有空闲连接，需要新建
+        uint64_t misses = 0;
+        uint64_t connects = 0;
+        uint64_t connect_failures = 0;
+        // 连接数已满需要等待的次数和总等待时间
+        uint64_t waits = 0;
+        uint64_t wait_us = 0;
+        uint64_t timeouts = 0;
+        uint64_t requests = 0;
+        // 当前空闲和总连接数
+        uint64_t idle = 0;
+        uint64_t total = 0;
+    };
+
+    HttpConnectionPool(const std::string &host, uint32_t port, uint32_t max_size,
+                       uint32_t max_idle_ms, uint32_t max_alive_ms, uint32_t max_requests);
+    ~HttpConnectionPool();
+
+    HttpResult::ptr doGet(const std::string &path, uint64_t timeout_ms,
+                          const std::map<std::string, std::string> &headers = {});
+    HttpResult::ptr doPost(const std::string &path, uint64_t timeout_ms,
+                           const std::map<std::string, std::string> &headers = {},
+                           const std::string &body = "");
+    HttpResult::ptr doRequest(HttpMethod method, const std::string &path, uint64_t timeout_ms,
+                              const std::map<std::string, std::string> &headers = {},
+                              const std::string &body = "");
+    // timeout_ms包含等待连接、发送和接收的全部时间
+    HttpResult::ptr doRequest(HttpRequest::ptr request, uint64_t timeout_ms);
+    // 结果与请求一一对应；连续的GET/HEAD请求在同一连接上流水线发送，其他请求逐个发送
+    std::vector<HttpResult::ptr> doRequests(const std::vector<HttpRequest::ptr> &requests,
+                                            uint64_t timeout_ms);
+
+    // 取一个连接，析构时自动归还，超时或失败返回nullptr
+    HttpConnection::ptr getConnection(uint64_t timeout_ms);
+
+    Stats getStats() const;
+    const std::string &getHost() const { return m_host; }
+    uint32_t getPort() const { return m_port; }
+
+private:
+    struct Waiter;
+    static void ReleasePtr(HttpConnection *conn, HttpConnectionPool::ptr pool);
+    void release(HttpConnection *conn);
+    HttpConnection *create(uint64_t deadline);
+    bool isExpired(HttpConnection *conn, uint64_t now) const;
+    // 发送一批请求并按顺序读取响应，填入results[begin, end)，返回成功处理的请求数
+    size_t pipeline(HttpConnection::ptr conn, const std::vector<HttpRequest::ptr> &requests,
+                    size_t begin, size_t end, std::vector<HttpResult::ptr> &results);
+    void prepare(HttpRequest::ptr request);
+
+private:
+    std::string m_host;
+    uint32_t m_port;
+    uint32_t m_maxSize;
+    uint32_t m_maxIdle;
+    uint32_t m_maxAlive;
+    uint32_t m_maxRequest;
+
+    mutable MutexType m_mutex;
+    Address::ptr m_addr;
+    // 空闲连接，尾部为最近归还的
+    std::list<HttpConnection *> m_idle;
+    std::list<std::shared_ptr<Waiter>> m_waiters;
+    // 已创建(包括正在创建)的连接数
+    uint32_t m_total = 0;
+
+    std::atomic<uint64_t> m_hits = {0};
+    std::atomic<uint64_t> m_misses = {0};
+    std::atomic<uint64_t> m_connects = {0};
+    std::atomic<uint64_t> m_connectFailures = {0};
+    std::atomic<uint64_t> m_waits = {0};
+    std::atomic<uint64_t> m_waitUs = {0};
+    std::atomic<uint64_t> m_timeouts = {0};
+    std::atomic<uint64_t> m_requests = {0};
+};
+
+// 按host:port管理连接池，参数来自http.client.*配置
+class HttpConnectionPoolManager {
+public:
+    HttpConnectionPool::ptr get(const std::string &host, uint32_t port);
+
+private:
+    Mutex m_mutex;
+    std::map<std::string, HttpConnectionPool::ptr> m_pools;
+};
+
+typedef Singleton<HttpConnectionPoolManager> HttpConnectionPoolMgr;
+
+}
+} // namespace CXS::http
+#endif
@@ -0,0 +1,243 @@
+#include "http_input.h"
+#include "../code/log.h"
+#include <algorithm>
+#include <string.h>
+
+namespace CXS {
+namespace http {
+
+static CXS::Logger::ptr g_logger = CXS_LOG_NAME("system");
+
+// 块头和trailer单行的最大长度
+static const size_t MAX_CHUNK_LINE = 1024;
+
+HttpInput::HttpInput(Stream *stream) :
+    m_stream(stream) {
+}
+
+int HttpInput::fill(size_t max_size) {
+    if (m_buffer.empty()) {
+        m_buffer.resize(std::max<uint64_t>(HttpRequestParser::GetHttpRequestBufferSize(), 64) + 1);
+    }
+    if (m_beforeRead && !m_beforeRead()) {
+        return -1;
+    }
+    if (m_begin == m_end) {
+        m_begin = m_end = 0;
+    }
+    size_t capacity = m_buffer.size() - 1;
+    if (m_end == capacity) {
+        if (m_begin > 0) {
+            memmove(&m_buffer[0], &m_buffer[m_begin], m_end - m_begin);
+            m_end -= m_begin;
+            m_begin = 0;
+        } else if (capacity < max_size) {
+            capacity = std::min<uint64_t>(capacity * 2, max_size);
+            m_buffer.resize(capacity + 1);
+        } else {
+            return -1;
+        }
+    }
+    return m_stream->read(&m_buffer[m_end], capacity - m_end);
+}
+
+size_t HttpInput::readHeader() {
+    // [m_begin, m_begin + scanned)中已确认没有"\r\n\r\n"，新数据到达后往前退3个字节继续找
+    size_t scanned = 0;
+    while (true) {
+        if (m_end - m_begin >= 4) {
+            size_t from = m_begin + (std::max<size_t>(scanned, 3) - 3);
+            void *pos = memmem(&m_buffer[from], m_end - from, "\r\n\r\n", 4);
+            if (pos) {
+                return (char *)pos - &m_buffer[m_begin] + 4;
+            }
+            scanned = m_end - m_begin;
+        }
+        uint64_t max_size = HttpRequestParser::GetHttpRequestMaxHeaderSize();
+        if (m_end - m_begin >= max_size) {
+            CXS_LOG_WARN(g_logger) << "http header too large, size=" << m_end - m_begin;
+            return 0;
+        }
+        int len = fill(max_size);
+        if (len <= 0) {
+            return 0;
+        }
+        m_end += len;
+    }
+}
+
+void HttpInput::setBody(BodyMode mode, uint64_t length) {
+    m_bodyMode = mode;
+    m_bodyLeft = mode == BodyMode::LENGTH ? length : 0;
+    m_chunkCRLF = false;
+    if (mode == BodyMode::LENGTH && length == 0) {
+        m_bodyMode = BodyMode::NONE;
+    }
+}
+
+size_t HttpInput::readLine() {
+    size_t scanned = m_begin;
+    while (true) {
+        void *pos = memchr(m_buffer.data() + scanned, '\n', m_end - scanned);
+        if (pos) {
+            return (char *)pos - &m_buffer[0] + 1;
+        }
+        if (m_end - m_begin >= MAX_CHUNK_LINE) {
+            CXS_LOG_WARN(g_logger) << "http chunk line too long";
+            return 0;
+        }
+        size_t offset = m_end - m_begin;
+        int len = fill(HttpRequestParser::GetHttpRequestMaxHeaderSize());
+        if (len <= 0) {
+            return 0;
+        }
+        m_end += len;
+        scanned = m_begin + offset;
+    }
+}
+
+bool HttpInput::readChunkHeader() {
+    if (m_chunkCRLF) {
+        size_t end = readLine();
+        size_t len = end - m_begin;
+        if (!end || !(len == 1 || (len == 2 && m_buffer[m_begin] == '\r'))) {
+            CXS_LOG_WARN(g_logger) << "invalid http chunk data end";
+            return false;
+        }
+        m_begin = end;
+        m_chunkCRLF = false;
+    }
+    size_t end = readLine();
+    if (!end || end - m_begin > MAX_CHUNK_LINE) {
+        return false;
+    }
+    // parser要求数据以'\0'结尾，拷到栈上解析
+    char line[MAX_CHUNK_LINE + 1];
+    size_t len = end - m_begin;
+    memcpy(line, &m_buffer[m_begin], len);
+    line[len] = '\0';
+    m_begin = end;
+    m_chunkParser.reset();
+    m_chunkParser.execute(line, len);
+    if (m_chunkParser.hasError() || !m_chunkParser.isFinished()) {
+        CXS_LOG_WARN(g_logger) << "invalid http chunk header: " << std::string(line, len);
+        return false;
+    }
+    if (!m_chunkParser.isLastChunk()) {
+        m_bodyLeft = m_chunkParser.getChunkSize();
+        m_chunkCRLF = true;
+        return true;
+    }
+    // trailer不处理，读到空行为止
+    while (true) {
+        end = readLine();
+        if (!end) {
+            return false;
+        }
+        bool empty = end - m_begin <= 2 && (m_buffer[m_begin] == '\r' || m_buffer[m_begin] == '\n');
+        m_begin = end;
+        if (empty) {
+            break;
+        }
+    }
+    m_bodyMode = BodyMode::NONE;
+    m_bodyLeft = 0;
+    return true;
+}
+
+int HttpInput::readBody(void *buffer, size_t length) {
+    if (m_bodyMode == BodyMode::CHUNKED && m_bodyLeft == 0) {
+        if (!readChunkHeader()) {
+            return -1;
+        }
+    }
+    if (m_bodyMode == BodyMode::NONE
+        || (m_bodyMode != BodyMode::UNTIL_CLOSE && m_bodyLeft == 0)) {
+        return 0;
+    }
+    if (m_bodyMode != BodyMode::UNTIL_CLOSE) {
+        length = std::min<uint64_t>(length, m_bodyLeft);
+    }
+    length = std::min<uint64_t>(length, 1 << 30);
+    int rt = 0;
+    if (m_begin < m_end) {
+        rt = std::min(length, m_end - m_begin);
+        memcpy(buffer, &m_buffer[m_begin], rt);
+        m_begin += rt;
+    } else {
+        // 缓冲区里没有数据时直接读到调用方的内存
+        if (m_beforeRead && !m_beforeRead()) {
+            return -1;
+        }
+        rt = m_stream->read(buffer, length);
+        if (rt == 0 && m_bodyMode == BodyMode::UNTIL_CLOSE) {
+            m_bodyMode = BodyMode::NONE;
+            return 0;
+        }
+        if (rt <= 0) {
+            return -1;
+        }
+    }
+    if (m_bodyMode == BodyMode::UNTIL_CLOSE) {
+        return rt;
+    }
+    m_bodyLeft -= rt;
+    if (m_bodyMode == BodyMode::LENGTH && m_bodyLeft == 0) {
+        m_bodyMode = BodyMode::NONE;
+    }
+    return rt;
+}
+
+bool HttpInput::loadBody(std::string &body, uint64_t max_size) {
+    body.clear();
+    if (m_bodyMode == BodyMode::NONE) {
+        return true;
+    }
+    if (m_bodyMode == BodyMode::LENGTH) {
+        if (m_bodyLeft > max_size) {
+            CXS_LOG_WARN(g_logger) << "http body too large, content-length=" << m_bodyLeft;
+            return false;
+        }
+        body.resize(m_bodyLeft);
+        size_t offset = 0;
+        while (offset < body.size()) {
+            int rt = readBody(&body[offset], body.size() - offset);
+            if (rt <= 0) {
+                return false;
+            }
+            offset += rt;
+        }
+        return true;
+    }
+    char buf[4096];
+    while (true) {
+        int rt = readBody(buf, sizeof(buf));
+        if (rt < 0) {
+            return false;
+        }
+        if (rt == 0) {
+            return true;
+        }
+        if (body.size() + rt > max_size) {
+            CXS_LOG_WARN(g_logger) << "http body too large, size > " << max_size;
+            return false;
+        }
+        body.append(buf, rt);
+    }
+}
+
+bool HttpInput::skipBody() {
+    char buf[4096];
+    while (true) {
+        int rt = readBody(buf, sizeof(buf));
+        if (rt < 0) {
+            return false;
+        }
+        if (rt == 0) {
+            return true;
+        }
+    }
+}
+
+}
+} // namespace CXS::http
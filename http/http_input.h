@@ -0,0 +1,75 @@
+#ifndef __CXS_HTTP_INPUT_H__
+#define __CXS_HTTP_INPUT_H__
+#include "../code/stream.h"
+#include "http_parser.h"
+#include <functional>
+#include <string>
+#include <vector>
+namespace CXS {
+namespace http {
+
+// 连接上复用的HTTP读缓冲区，服务端的HttpSession和客户端的HttpConnection共用
+// 负责找到完整的头部，以及按content-length/chunked/读到关闭三种方式读消息体
+class HttpInput {
+public:
+    enum class BodyMode {
+        NONE,
+        LENGTH,
+        CHUNKED,
+        // 没有长度的响应，读到连接关闭为止
+        UNTIL_CLOSE
+    };
+
+    HttpInput(Stream *stream);
+
+    // 阻塞读之前调用，返回false时读失败，服务端用来先发出排队的响应
+    void setBeforeRead(std::function<bool()> cb) { m_beforeRead = cb; }
+
+    // 读到缓冲区中出现完整的头部，返回头部长度，失败返回0
+    // 返回后begin()[len]可写，用于给要求'\0'结尾的parser临时放结束符
+    size_t readHeader();
+    char *begin() { return &m_buffer[m_begin]; }
+    // 缓冲区中未处理的字节数
+    size_t size() const { return m_end - m_begin; }
+    void consume(size_t n) { m_begin += n; }
+
+    void setBody(BodyMode mode, uint64_t length = 0);
+    BodyMode getBodyMode() const { return m_bodyMode; }
+    // LENGTH为剩余未读的长度，CHUNKED为当前块剩余的长度
+    uint64_t getBodyLeft() const { return m_bodyLeft; }
+
+    // 读消息体，chunked自动解码，返回读到的字节数，0表示消息体已读完，-1出错
+    int readBody(void *buffer, size_t length);
+    // 把剩余的消息体读入body，超过max_size失败
+    bool loadBody(std::string &body, uint64_t max_size);
+    // 丢弃剩余的消息体，使连接可以读下一条消息
+    bool skipBody();
+
+private:
+    // 往缓冲区尾部读数据，空间不够时先把未处理的数据移到头部，max_size为缓冲区允许增长到的大小
+    int fill(size_t max_size);
+    // 读一行，返回行尾('\n'之后)的位置，失败返回0
+    size_t readLine();
+    // 读下一个块头，最后一个块会连同trailer一起读掉
+    bool readChunkHeader();
+
+private:
+    Stream *m_stream;
+    std::function<bool()> m_beforeRead;
+    // 初始为http.request_buffer_size，读头部时不够翻倍直到http.max_header_size
+    // 末尾多留一个字节，见readHeader
+    std::vector<char> m_buffer;
+    // 缓冲区中未处理数据的范围[m_begin, m_end)
+    size_t m_begin = 0;
+    size_t m_end = 0;
+    HttpChunkParser m_chunkParser;
+
+    BodyMode m_bodyMode = BodyMode::NONE;
+    uint64_t m_bodyLeft = 0;
+    // 块数据之后的"\r\n"还没有读
+    bool m_chunkCRLF = false;
+};
+
+}
+} // namespace CXS::http
+#endif
@@ -19,26 +19,36 @@ static CXS::ConfigVar<u_int64_t>::ptr g_http_request_buffer_size =
     CXS::Config::Lookup("http.request_buffer_size", 4 * 1024ul, "http request buffer size");
 static CXS::ConfigVar<u_int64_t>::ptr g_http_request_body_size =
     CXS::Config::Lookup("http.max_body_size", 64 * 1024 * 1024ul, "http max body size");
+static CXS::ConfigVar<u_int64_t>::ptr g_http_request_header_size =
+    CXS::Config::Lookup("http.max_header_size", 64 * 1024ul, "http max header size");
 
 static uint64_t s_http_request_buffer_size = 0;
 static uint64_t s_http_request_body_size = 0;
+static uint64_t s_http_request_header_size = 0;
 uint64_t HttpRequestParser::GetHttpRequestBufferSize() {
     return s_http_request_buffer_size;
 }
 uint64_t HttpRequestParser::GetHttpRequestMaxBodySize() {
     return s_http_request_body_size;
 }
+uint64_t HttpRequestParser::GetHttpRequestMaxHeaderSize() {
+    return s_http_request_header_size;
+}
 namespace {
 struct _ReqestSizeIniter {
     _ReqestSizeIniter() {
         s_http_request_buffer_size = g_http_request_buffer_size->getValue();
         s_http_request_body_size = g_http_request_body_size->getValue();
+        s_http_request_header_size = g_http_request_header_size->getValue();
         g_http_request_buffer_size->addListener([](const uint64_t &ov, const uint64_t &nv) {
             s_http_request_buffer_size = nv;
         });
         g_http_request_body_size->addListener([](const uint64_t &ov, const uint64_t &nv) {
             s_http_request_body_size = nv;
         });
+        g_http_request_header_size->addListener([](const uint64_t &ov, const uint64_t &nv) {
+            s_http_request_header_size = nv;
+        });
     }
 };
 
@@ -111,17 +121,19 @@ HttpRequestParser::HttpRequestParser() {
     m_error = 0;
 }
 
+void HttpRequestParser::reset() {
+    http_parser_init(&m_parser);
+    m_data.reset(new CXS::http::HttpRequest);
+    m_error = 0;
+}
+
 uint64_t HttpRequestParser::getContentLength() {
     return m_data->getHeaderAs<uint64_t>("content-length", (uint64_t)0);
 }
 
-// 1 成功
-// -1 解析错误
-// >0 处理的字节数，且data 有效数据为len - v;
+// 返回处理的字节数，data中[rt, len)为未处理的数据(请求体或下一个请求)
 size_t HttpRequestParser::execute(char *data, size_t len) {
-    size_t rt = http_parser_execute(&m_parser, data, len, 0);
-    memmove(data, data + rt, (len - rt));
-    return rt;
+    return http_parser_execute(&m_parser, data, len, 0);
 }
 int HttpRequestParser::isFinished() {
     return http_parser_finish(&m_parser);
@@ -182,6 +194,12 @@ HttpResponseParser::HttpResponseParser() {
     m_error = 0;
 }
 
+void HttpResponseParser::reset() {
+    httpclient_parser_init(&m_parser);
+    m_data.reset(new CXS::http::HttpResponse);
+    m_error = 0;
+}
+
 size_t HttpResponseParser::execute(char *data, size_t len) {
     size_t rt = httpclient_parser_execute(&m_parser, data, len, 0);
     memmove(data, data + rt, (len - rt));
@@ -197,5 +215,47 @@ int HttpResponseParser::hasError() {
 uint64_t HttpResponseParser::getContentLength() {
     return m_data->getHeaderAs<uint64_t>("content-length", (uint64_t)0);
 }
+
+void on_chunk_size(void *data, const char *at, size_t length) {
+    static_cast<HttpChunkParser *>(data)->setChunk(at, length, false);
+}
+void on_chunk_last(void *data, const char *at, size_t length) {
+    static_cast<HttpChunkParser *>(data)->setChunk(at, length, true);
+}
+HttpChunkParser::HttpChunkParser() {
+    reset();
+}
+
+void HttpChunkParser::reset() {
+    httpclient_parser_init(&m_parser);
+    m_parser.chunk_size = on_chunk_size;
+    m_parser.last_chunk = on_chunk_last;
+    m_parser.data = this;
+    m_size = 0;
+    m_last = false;
+    m_error = 0;
+}
+
+void HttpChunkParser::setChunk(const char *at, size_t length, bool last) {
+    // parser内部用int保存长度，超过7位十六进制会溢出
+    if (length == 0 || length > 7) {
+        CXS_LOG_WARN(g_logger) << "invalid http chunk size: " << std::string(at, length);
+        m_error = 1003;
+        return;
+    }
+    m_size = strtoull(at, nullptr, 16);
+    m_last = last;
+}
+
+size_t HttpChunkParser::execute(char *data, size_t len) {
+    return httpclient_parser_execute(&m_parser, data, len, 0);
+}
+int HttpChunkParser::isFinished() {
+    return httpclient_parser_is_finished(&m_parser);
+}
+int HttpChunkParser::hasError() {
+    // 以"HTTP/"开头的行会被当成响应行，不是块头
+    return m_error || httpclient_parser_has_error(&m_parser) || !m_parser.chunked;
+}
 }
-} // namespace CXS::http
\ No newline at end of file
+} // namespace CXS::http
@@ -13,6 +13,9 @@ public:
     typedef std::shared_ptr<HttpRequestParser> ptr;
     HttpRequestParser();
 
+    // 重置解析状态并换一个新的请求对象，连接上的下一个请求复用解析器
+    void reset();
+    // 返回已解析的字节数，未解析的数据留在原处由调用方处理
     size_t execute(char *data, size_t len);
     int isFinished();
     int hasError();
@@ -30,6 +33,7 @@ public:
 public:
     static uint64_t GetHttpRequestBufferSize();
     static uint64_t GetHttpRequestMaxBodySize();
+    static uint64_t GetHttpRequestMaxHeaderSize();
 
 private:
     http_parser m_parser;
@@ -42,6 +46,9 @@ public:
     typedef std::shared_ptr<HttpResponseParser> ptr;
     HttpResponseParser();
 
+    // 重置解析状态并换一个新的响应对象，连接上的下一个响应复用解析器
+    void reset();
+    // data[len]必须是'\0'
     size_t execute(char *data, size_t len);
     int isFinished();
     int hasError();
@@ -61,6 +68,34 @@ private:
     HttpResponse::ptr m_data;
     int m_error;
 };
+
+// chunked编码的块头"size[;ext]\r\n"，复用httpclient_parser的Chunked_Header
+class HttpChunkParser {
+public:
+    HttpChunkParser();
+
+    void reset();
+    // data[len]必须是'\0'
+    size_t execute(char *data, size_t len);
+    int isFinished();
+    int hasError();
+    uint64_t getChunkSize() const {
+        return m_size;
+    }
+    // 0长度的块，后面只剩trailer
+    bool isLastChunk() const {
+        return m_last;
+    }
+
+    // 供parser回调使用
+    void setChunk(const char *at, size_t length, bool last);
+
+private:
+    httpclient_parser m_parser;
+    uint64_t m_size;
+    bool m_last;
+    int m_error;
+};
 }
 } // namespace CXS::http
 #endif
\ No newline at end of file
@@ -12,22 +12,45 @@ HttpServer::HttpServer(bool keepalive,
                        CXS::IOManager *accept_woker) :
     TCPServer(worker, accept_woker),
     m_isKeepAlive(keepalive) {
+    m_dispatch.reset(new ServletDispatch);
 }
 void HttpServer::handleClient(Socket::ptr client) {
     HttpSession::ptr session(new HttpSession(client));
     do {
-        auto req = session->recvRequest();
+        auto req = session->recvRequestHeader();
         if (req == nullptr) {
             CXS_LOG_WARN(g_logger) << "recvRequest failed errno = " << errno
                                    << ", errmsg = " << strerror(errno) << "client " << *client;
             break;
         }
+        // 小的定长请求体直接读入request，大的和chunked请求体由servlet通过session->readBody流式读取
+        if (!session->isChunkedBody()
+            && session->getBodyLeft() <= HttpRequestParser::GetHttpRequestBufferSize()
+            && !session->loadBody(req, HttpRequestParser::GetHttpRequestBufferSize())) {
+            break;
+        }
         HttpResponse::ptr rsp(new HttpResponse(req->getVersion(), req->isClose() || !m_isKeepAlive));
-        rsp->setBody("Hello, world!");
-        CXS_LOG_INFO(g_logger) << "recvRequest: " << std::endl
-                               << *req;
-        session->sendResponse(rsp);
+        int32_t handled = m_dispatch->handle(req, rsp, session);
+        if (!session->isResponseStarted()) {
+            if (!session->skipBody()) {
+                break;
+            }
+            // 流水线上还有后续请求时先排队，和后面的响应合并成一次writev
+            int rt = session->hasBufferedInput() && !rsp->isClose()
+                         ? session->queueResponse(rsp)
+                         : session->sendResponse(rsp);
+            if (rt <= 0) {
+                break;
+            }
+        } else if (handled < 0 || session->finishBody() < 0 || !session->skipBody()) {
+            // 响应已经开始发送后servlet失败，响应不完整，只能关闭连接
+            break;
+        }
+        if (rsp->isClose()) {
+            break;
+        }
     } while (m_isKeepAlive);
+    session->flush();
     session->close();
 }
 }
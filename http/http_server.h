@@ -1,22 +1,27 @@
 #ifndef __CXS_HTTP_HTTTP_SERVER__
 #define __CXS_HTTP_HTTTP_SERVER__
 #include "http_session.h"
+#include "servlet.h"
 #include "../code/tcp_server.h"
 #include <memory>
 namespace CXS {
 namespace http {
 class HttpServer : public TCPServer {
 public:
-    typedef std::shared_ptr<TCPServer> ptr;
+    typedef std::shared_ptr<HttpServer> ptr;
     HttpServer(bool keepalive = false,
                CXS::IOManager *worker = CXS::IOManager::GetThis(),
                CXS::IOManager *accept_woker = CXS::IOManager::GetThis());
 
+    ServletDispatch::ptr getServletDispatch() const { return m_dispatch; }
+    void setServletDispatch(ServletDispatch::ptr v) { m_dispatch = v; }
+
 protected:
     virtual void handleClient(Socket::ptr client) override;
 
 private:
     bool m_isKeepAlive;
+    ServletDispatch::ptr m_dispatch;
 };
 }
 } // namespace CXS::http
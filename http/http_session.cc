@@ -1,69 +1,229 @@
 #include "http_session.h"
 #include "http_parser.h"
+#include "../code/log.h"
+#include <algorithm>
 #include <cstddef>
 #include <cstdint>
 #include <memory>
-#include <sstream>
+#include <stdio.h>
 #include <string>
+#include <string.h>
+#include <strings.h>
+#include <sys/uio.h>
 
 namespace CXS {
 namespace http {
+
+static CXS::Logger::ptr g_logger = CXS_LOG_NAME("system");
+
+// 流式响应中不限制长度
+static const uint64_t UNLIMITED = ~0ull;
+// 发送队列积累到这么多条或这么多字节时立即发送
+static const size_t MAX_QUEUED_RESPONSES = 16;
+static const size_t MAX_QUEUED_BYTES = 64 * 1024;
+
 HttpSession::HttpSession(Socket::ptr sock, bool owner) :
-    SocketStream(sock, owner) {
-}
-HttpRequest::ptr HttpSession::recvRequest() {
-    HttpRequestParser::ptr parser(new HttpRequestParser);
-    // uint64_t buff_size = HttpRequestParser::GetHttpRequestBufferSize();
-    uint64_t buff_size = 100;
-    std::shared_ptr<char> buffer(new char[buff_size], [](char *ptr) {
-        delete[] ptr;
+    SocketStream(sock, owner),
+    m_input(this) {
+    // 阻塞读之前先把排队的响应发出去，否则流水线的客户端会一直等
+    m_input.setBeforeRead([this]() {
+        return m_output.empty() || flush() > 0;
     });
+}
 
-    char *data = buffer.get();
-    int offset = 0;
+HttpRequest::ptr HttpSession::recvRequestHeader() {
+    // 上一个请求之后多读的数据保留在缓冲区中，是流水线上的下一个请求
+    m_parser.reset();
+    m_input.setBody(HttpInput::BodyMode::NONE);
+    m_responseStarted = false;
 
-    do {
-        int len = read(data + offset, buff_size - offset);
-        if (len <= 0) {
-            return nullptr;
-        }
-        len += offset;
-        size_t rtParser = parser->execute(data, len);
-        if (parser->hasError()) {
-            return nullptr;
-        }
-        offset = len - rtParser;
-        if (offset == (int)buff_size) {
+    size_t header_len = m_input.readHeader();
+    if (!header_len) {
+        return nullptr;
+    }
+    // 请求头已经完整，一次解析完成
+    size_t nparse = m_parser.execute(m_input.begin(), header_len);
+    if (m_parser.hasError() || !m_parser.isFinished()) {
+        return nullptr;
+    }
+    m_input.consume(nparse);
+
+    HttpRequest::ptr request = m_parser.getData();
+    request->initClose();
+    m_headRequest = request->getMethod() == HttpMethod::HEAD;
+    const std::string &te = request->getHeaders("transfer-encoding");
+    if (!te.empty()) {
+        if (strcasestr(te.c_str(), "chunked") == nullptr) {
+            CXS_LOG_WARN(g_logger) << "unsupported http transfer-encoding: " << te;
             return nullptr;
         }
-        if (parser->isFinished()) {
-            break;
-        }
-    } while (true);
-    int64_t length = parser->getContentLength();
-    if (length > 0) {
-        std::string body;
-        body.reserve(length);
-        if (length >= offset) {
-            body.append(data, offset);
-        } else {
-            body.append(data, length);
+        // 同时带content-length时以chunked为准
+        m_input.setBody(HttpInput::BodyMode::CHUNKED);
+    } else {
+        m_input.setBody(HttpInput::BodyMode::LENGTH, m_parser.getContentLength());
+    }
+    return request;
+}
+
+HttpRequest::ptr HttpSession::recvRequest() {
+    HttpRequest::ptr request = recvRequestHeader();
+    if (!request) {
+        return nullptr;
+    }
+    if (!loadBody(request, HttpRequestParser::GetHttpRequestMaxBodySize())) {
+        return nullptr;
+    }
+    return request;
+}
+
+bool HttpSession::loadBody(HttpRequest::ptr request, uint64_t max_size) {
+    if (m_input.getBodyMode() == HttpInput::BodyMode::NONE) {
+        return true;
+    }
+    std::string body;
+    if (!m_input.loadBody(body, max_size)) {
+        return false;
+    }
+    request->setBody(body);
+    return true;
+}
+
+int HttpSession::sendResponse(HttpResponse::ptr response) {
+    enqueue(response);
+    return flush();
+}
+
+int HttpSession::queueResponse(HttpResponse::ptr response) {
+    enqueue(response);
+    if (m_output.size() >= MAX_QUEUED_RESPONSES || m_outputSize >= MAX_QUEUED_BYTES) {
+        return flush();
+    }
+    return 1;
+}
+
+void HttpSession::enqueue(HttpResponse::ptr response) {
+    m_responseStarted = true;
+    size_t offset = m_headerBuf.size();
+    response->serializeHeader(m_headerBuf);
+    size_t len = m_headerBuf.size() - offset;
+    if (m_headRequest) {
+        // HEAD请求保留content-length，不发响应体，否则会混进流水线上的下一个响应
+        m_output.push_back(OutputItem{offset, len, nullptr});
+        m_outputSize += len;
+        return;
+    }
+    m_output.push_back(OutputItem{offset, len, response});
+    m_outputSize += len + response->getBody().size();
+}
+
+int HttpSession::flush() {
+    if (m_output.empty()) {
+        return 0;
+    }
+    // 每条响应头部和响应体各一段
+    struct iovec iov[MAX_QUEUED_RESPONSES * 2];
+    int iovcnt = 0;
+    for (auto &i : m_output) {
+        iov[iovcnt].iov_base = &m_headerBuf[i.header_offset];
+        iov[iovcnt].iov_len = i.header_len;
+        ++iovcnt;
+        if (i.response && !i.response->getBody().empty()) {
+            const std::string &body = i.response->getBody();
+            iov[iovcnt].iov_base = (void *)body.data();
+            iov[iovcnt].iov_len = body.size();
+            ++iovcnt;
         }
-        length -= offset;
-        if (length > 0) {
-            if (readFixSize(&body[body.size()], length) <= 0) {
-                return nullptr;
+    }
+    int rt = writevFixSize(iov, iovcnt);
+    m_output.clear();
+    m_outputSize = 0;
+    // 保留容量，下一批响应复用
+    m_headerBuf.clear();
+    return rt;
+}
+
+int HttpSession::sendResponseHeader(HttpResponse::ptr response) {
+    m_responseStarted = true;
+    m_responseChunked = false;
+    m_writeLeft = UNLIMITED;
+    std::string length = response->getHeader("content-length");
+    if (!length.empty()) {
+        m_writeLeft = strtoull(length.c_str(), nullptr, 10);
+        response->delHeader("transfer-encoding");
+    } else if (response->getVersion() >= 0x11) {
+        m_responseChunked = true;
+        response->setHeader("Transfer-Encoding", "chunked");
+    } else {
+        response->setClose(true);
+    }
+    if (m_headRequest) {
+        // HEAD请求只发头部，之后写入的响应体全部丢弃
+        m_responseChunked = false;
+        response->delHeader("transfer-encoding");
+        m_writeLeft = 0;
+    }
+    size_t offset = m_headerBuf.size();
+    response->serializeHeader(m_headerBuf, false);
+    m_output.push_back(OutputItem{offset, m_headerBuf.size() - offset, nullptr});
+    return flush();
+}
+
+int64_t HttpSession::sendFile(int fd, uint64_t offset, uint64_t length) {
+    if (length == 0 || m_headRequest) {
+        return length;
+    }
+    if (m_responseChunked || (m_writeLeft != UNLIMITED && length > m_writeLeft)) {
+        CXS_LOG_WARN(g_logger) << "http sendFile requires content-length, length=" << length;
+        return -1;
+    }
+    int64_t rt = SocketStream::sendFile(fd, offset, length);
+    // 发送失败或文件变短时不扣减，finishBody发现长度不足，连接不再复用
+    if (rt == (int64_t)length && m_writeLeft != UNLIMITED) {
+        m_writeLeft -= length;
+    }
+    return rt;
+}
+
+int HttpSession::writeBody(const void *buffer, size_t length) {
+    if (length == 0) {
+        return 0;
+    }
+    if (m_headRequest) {
+        return length;
+    }
+    if (!m_responseChunked) {
+        if (m_writeLeft != UNLIMITED) {
+            if (length > m_writeLeft) {
+                CXS_LOG_WARN(g_logger) << "http response body exceeds content-length";
+                return -1;
             }
+            m_writeLeft -= length;
         }
-        parser->getData()->setBody(body);
+        return writeFixSize(buffer, length);
     }
-    return parser->getData();
+    char head[32];
+    int n = snprintf(head, sizeof(head), "%zx\r\n", length);
+    struct iovec iov[3];
+    iov[0].iov_base = head;
+    iov[0].iov_len = n;
+    iov[1].iov_base = (void *)buffer;
+    iov[1].iov_len = length;
+    iov[2].iov_base = (void *)"\r\n";
+    iov[2].iov_len = 2;
+    return writevFixSize(iov, 3);
 }
-int HttpSession::sendResponse(HttpResponse::ptr response) {
-    std::stringstream ss;
-    ss << *response;
-    std::string data = ss.str();
-    return writeFixSize(data.c_str(), data.size());
+
+int HttpSession::finishBody() {
+    if (m_responseChunked) {
+        m_responseChunked = false;
+        return writeFixSize("0\r\n\r\n", 5);
+    }
+    if (!m_headRequest && m_writeLeft != UNLIMITED && m_writeLeft != 0) {
+        CXS_LOG_WARN(g_logger) << "http response body shorter than content-length, left=" << m_writeLeft;
+        return -1;
+    }
+    return 1;
 }
+
 }
-} // namespace CXS::http
\ No newline at end of file
+} // namespace CXS::http
@@ -2,16 +2,78 @@
 #define __CXS_HTTP_SESSION__
 #include "../code/socket_stream.h"
 #include "http.h"
+#include "http_input.h"
+#include "http_parser.h"
 #include <memory>
+#include <vector>
 namespace CXS {
 namespace http {
 class HttpSession : public SocketStream {
 public:
     typedef std::shared_ptr<HttpSession> ptr;
     HttpSession(Socket::ptr sock, bool owner = true);
-    int sendResponse(HttpResponse::ptr response);
+    // 收完整的请求，请求体读入request，超过http.max_body_size失败
     HttpRequest::ptr recvRequest();
+    // 只收请求头，请求体由readBody按需读取
+    HttpRequest::ptr recvRequestHeader();
+
+    // 读请求体，chunked自动解码，返回读到的字节数，0表示请求体已读完，-1出错
+    int readBody(void *buffer, size_t length) { return m_input.readBody(buffer, length); }
+    // 把剩余的请求体读入request，超过max_size失败
+    bool loadBody(HttpRequest::ptr request, uint64_t max_size);
+    // 丢弃剩余的请求体，使连接可以读下一个请求
+    bool skipBody() { return m_input.skipBody(); }
+    bool isChunkedBody() const { return m_input.getBodyMode() == HttpInput::BodyMode::CHUNKED; }
+    // content-length请求剩余未读的长度，chunked请求为当前块剩余的长度
+    uint64_t getBodyLeft() const { return m_input.getBodyLeft(); }
+
+    // 发送响应，发送队列中排在前面的响应一起用writev发出
+    int sendResponse(HttpResponse::ptr response);
+    // 响应先放入发送队列，下次sendResponse/flush或需要阻塞读数据时一起发出
+    // 用于流水线请求：缓冲区中还有后续请求时不急于发送，队列满时立即发送，发送失败返回<=0
+    int queueResponse(HttpResponse::ptr response);
+    int flush();
+    // 缓冲区中还有未处理的数据，即流水线上的后续请求
+    bool hasBufferedInput() const { return m_input.size() > 0; }
+
+    // 流式响应：先发送头部，再多次writeBody，最后finishBody
+    // 设置了content-length按原样输出，否则HTTP/1.1使用chunked，HTTP/1.0写完后关闭连接
+    // HEAD请求只发送头部
+    int sendResponseHeader(HttpResponse::ptr response);
+    int writeBody(const void *buffer, size_t length);
+    int finishBody();
+    // 流式响应的响应体直接从文件发送(sendfile)，需要先设置content-length
+    int64_t sendFile(int fd, uint64_t offset, uint64_t length);
+    // 本次请求的响应是否已经开始发送
+    bool isResponseStarted() const { return m_responseStarted; }
+
+private:
+    // 序列化头部并加入发送队列
+    void enqueue(HttpResponse::ptr response);
+
+private:
+    HttpInput m_input;
+    HttpRequestParser m_parser;
+
+    // 待发送的响应，按请求顺序排列
+    // 头部序列化到连接上复用的m_headerBuf中，响应体不拷贝，发送时直接指向response的body
+    // HEAD请求的响应不带response，只发头部
+    struct OutputItem {
+        size_t header_offset;
+        size_t header_len;
+        HttpResponse::ptr response;
+    };
+    std::string m_headerBuf;
+    std::vector<OutputItem> m_output;
+    size_t m_outputSize = 0;
+
+    // 当前请求是HEAD，响应只发送头部
+    bool m_headRequest = false;
+    bool m_responseStarted = false;
+    bool m_responseChunked = false;
+    // 流式响应声明了content-length时剩余要写的长度
+    uint64_t m_writeLeft = 0;
 };
 }
 } // namespace CXS::http
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,379 @@
+#include "servlet.h"
+#include "../code/log.h"
+#include "../code/macro.h"
+#include <algorithm>
+#include <sched.h>
+#include <string.h>
+
+namespace CXS {
+namespace http {
+
+static CXS::Logger::ptr g_logger = CXS_LOG_NAME("system");
+
+FunctionServlet::FunctionServlet(callback cb) :
+    Servlet("FunctionServlet"),
+    m_cb(cb) {
+}
+
+int32_t FunctionServlet::handle(HttpRequest::ptr request,
+                                HttpResponse::ptr response,
+                                HttpSession::ptr session) {
+    return m_cb(request, response, session);
+}
+
+NotFoundServlet::NotFoundServlet() :
+    Servlet("NotFoundServlet") {
+}
+
+int32_t NotFoundServlet::handle(HttpRequest::ptr request,
+                                HttpResponse::ptr response,
+                                HttpSession::ptr session) {
+    static const std::string s_body = "<html><head><title>404 Not Found</title></head>"
+                                      "<body><center><h1>404 Not Found</h1></center>"
+                                      "<hr><center>CXS</center></body></html>";
+    response->setStatus(HttpStatus::NOT_FOUND);
+    response->setHeader("Content-Type", "text/html");
+    response->setBody(s_body);
+    return 0;
+}
+
+// 树节点，发布之后只读
+// label是从父节点到本节点的边上的字符，通配边(wildcard)的label为空，代表一个'*'
+struct ServletDispatch::Node {
+    std::string label;
+    Servlet::ptr slots[3];
+    // 字面子节点，按label首字符有序
+    std::vector<NodePtr> children;
+    NodePtr wildcard;
+
+    bool empty() const {
+        return !slots[0] && !slots[1] && !slots[2] && children.empty() && !wildcard;
+    }
+};
+
+struct ServletDispatch::Root {
+    NodePtr tree;
+    Servlet::ptr def;
+    size_t size = 0;
+};
+
+namespace {
+
+typedef ServletDispatch::Node Node;
+typedef ServletDispatch::NodePtr NodePtr;
+typedef ServletDispatch::Kind Kind;
+
+std::vector<NodePtr>::const_iterator FindChild(const std::vector<NodePtr> &children, char c) {
+    auto it = std::lower_bound(children.begin(), children.end(), c,
+                               [](const NodePtr &n, char c) { return n->label[0] < c; });
+    if (it != children.end() && (*it)->label[0] == c) {
+        return it;
+    }
+    return children.end();
+}
+
+// key[pos..]中字面部分的结束位置，通配路由遇到'*'为止
+size_t LiteralEnd(const std::string &key, size_t pos, bool glob) {
+    if (!glob) {
+        return key.size();
+    }
+    size_t end = key.find('*', pos);
+    return end == std::string::npos ? key.size() : end;
+}
+
+// 定位key对应的节点，不存在返回nullptr
+const Node *Locate(const Node *node, const std::string &key, bool glob) {
+    size_t pos = 0;
+    while (node) {
+        if (pos == key.size()) {
+            return node;
+        }
+        if (glob && key[pos] == '*') {
+            node = node->wildcard.get();
+            ++pos;
+            continue;
+        }
+        auto it = FindChild(node->children, key[pos]);
+        if (it == node->children.end()) {
+            return nullptr;
+        }
+        const std::string &label = (*it)->label;
+        if (key.compare(pos, label.size(), label) != 0 || pos + label.size() > LiteralEnd(key, pos, glob)) {
+            return nullptr;
+        }
+        pos += label.size();
+        node = it->get();
+    }
+    return nullptr;
+}
+
+// 路径复制：返回node的新副本，key[0..pos)已经匹配到node
+// slt为空时清除，变空的节点返回nullptr由父节点摘除
+NodePtr Insert(const Node *node, const std::string &key, size_t pos, bool glob,
+               int slot, const Servlet::ptr &slt) {
+    std::shared_ptr<Node> copy = node ? std::make_shared<Node>(*node) : std::make_shared<Node>();
+    if (pos == key.size()) {
+        copy->slots[slot] = slt;
+    } else if (glob && key[pos] == '*') {
+        copy->wildcard = Insert(copy->wildcard.get(), key, pos + 1, glob, slot, slt);
+    } else {
+        size_t end = LiteralEnd(key, pos, glob);
+        auto it = FindChild(copy->children, key[pos]);
+        if (it == copy->children.end()) {
+            std::shared_ptr<Node> leaf = std::make_shared<Node>();
+            leaf->label = key.substr(pos, end - pos);
+            NodePtr child = Insert(leaf.get(), key, end, glob, slot, slt);
+            if (child) {
+                auto where = std::lower_bound(copy->children.begin(), copy->children.end(), key[pos],
+                                              [](const NodePtr &n, char c) { return n->label[0] < c; });
+                copy->children.insert(where, child);
+            }
+        } else {
+            size_t idx = it - copy->children.begin();
+            const Node *child = it->get();
+            size_t common = 0;
+            while (common < child->label.size() && pos + common < end && child->label[common] == key[pos + common]) {
+                ++common;
+            }
+            NodePtr replaced;
+            if (common == child->label.size()) {
+                replaced = Insert(child, key, pos + common, glob, slot, slt);
+            } else {
+                // 在公共前缀处拆分出中间节点
+                std::shared_ptr<Node> tail = std::make_shared<Node>(*child);
+                tail->label = child->label.substr(common);
+                std::shared_ptr<Node> mid = std::make_shared<Node>();
+                mid->label = child->label.substr(0, common);
+                mid->children.push_back(tail);
+                replaced = Insert(mid.get(), key, pos + common, glob, slot, slt);
+            }
+            if (replaced) {
+                copy->children[idx] = replaced;
+            } else {
+                copy->children.erase(copy->children.begin() + idx);
+            }
+        }
+    }
+    if (copy->empty()) {
+        return nullptr;
+    }
+    return copy;
+}
+
+struct MatchResult {
+    const Servlet::ptr *full = nullptr;
+    const Servlet::ptr *prefix = nullptr;
+    size_t prefix_len = 0;
+};
+
+// 深度优先，字面子节点先于通配子节点，找到精确或通配的完整匹配即返回
+// 沿途记录最长的前缀路由
+bool Match(const Node *node, const char *path, size_t len, size_t pos, MatchResult &rt) {
+    if (node->slots[(int)Kind::PREFIX] && (!rt.prefix || pos >= rt.prefix_len)) {
+        rt.prefix = &node->slots[(int)Kind::PREFIX];
+        rt.prefix_len = pos;
+    }
+    if (pos == len) {
+        if (node->slots[(int)Kind::EXACT]) {
+            rt.full = &node->slots[(int)Kind::EXACT];
+            return true;
+        }
+        if (node->slots[(int)Kind::GLOB]) {
+            rt.full = &node->slots[(int)Kind::GLOB];
+            return true;
+        }
+        return false;
+    }
+    auto it = FindChild(node->children, path[pos]);
+    if (it != node->children.end()) {
+        const std::string &label = (*it)->label;
+        if (label.size() <= len - pos && memcmp(label.data(), path + pos, label.size()) == 0) {
+            if (Match(it->get(), path, len, pos + label.size(), rt)) {
+                return true;
+            }
+        }
+    }
+    if (node->wildcard && path[pos] != '/') {
+        size_t end = pos;
+        while (end < len && path[end] != '/') {
+            ++end;
+        }
+        return Match(node->wildcard.get(), path, len, end, rt);
+    }
+    return false;
+}
+
+} // namespace
+
+ServletDispatch::ServletDispatch() :
+    Servlet("ServletDispatch"),
+    m_root(nullptr),
+    m_epoch(0) {
+    m_readers[0] = 0;
+    m_readers[1] = 0;
+    std::shared_ptr<Root> root = std::make_shared<Root>();
+    root->tree = std::make_shared<Node>();
+    root->def.reset(new NotFoundServlet());
+    m_holder = root;
+    m_root.store(root.get(), std::memory_order_release);
+}
+
+ServletDispatch::~ServletDispatch() {
+}
+
+int32_t ServletDispatch::handle(HttpRequest::ptr request,
+                                HttpResponse::ptr response,
+                                HttpSession::ptr session) {
+    Servlet::ptr slt = getMatchedServlet(request->getPath());
+    if (slt) {
+        return slt->handle(request, response, session);
+    }
+    return 0;
+}
+
+void ServletDispatch::addServlet(const std::string &uri, Servlet::ptr slt) {
+    update(Kind::EXACT, uri, slt);
+}
+
+void ServletDispatch::addServlet(const std::string &uri, FunctionServlet::callback cb) {
+    update(Kind::EXACT, uri, std::make_shared<FunctionServlet>(cb));
+}
+
+bool ServletDispatch::addGlobServlet(const std::string &pattern, Servlet::ptr slt) {
+    for (size_t i = 0; i < pattern.size(); ++i) {
+        if (pattern[i] == '*' && i + 1 < pattern.size() && pattern[i + 1] != '/') {
+            CXS_LOG_ERROR(g_logger) << "addGlobServlet invalid pattern: " << pattern;
+            return false;
+        }
+    }
+    update(Kind::GLOB, pattern, slt);
+    return true;
+}
+
+bool ServletDispatch::addGlobServlet(const std::string &pattern, FunctionServlet::callback cb) {
+    return addGlobServlet(pattern, std::make_shared<FunctionServlet>(cb));
+}
+
+void ServletDispatch::addPrefixServlet(const std::string &prefix, Servlet::ptr slt) {
+    update(Kind::PREFIX, prefix, slt);
+}
+
+void ServletDispatch::addPrefixServlet(const std::string &prefix, FunctionServlet::callback cb) {
+    update(Kind::PREFIX, prefix, std::make_shared<FunctionServlet>(cb));
+}
+
+void ServletDispatch::delServlet(const std::string &uri) {
+    update(Kind::EXACT, uri, nullptr);
+}
+
+void ServletDispatch::delGlobServlet(const std::string &pattern) {
+    update(Kind::GLOB, pattern, nullptr);
+}
+
+void ServletDispatch::delPrefixServlet(const std::string &prefix) {
+    update(Kind::PREFIX, prefix, nullptr);
+}
+
+Servlet::ptr ServletDispatch::getDefault() const {
+    int slot = readLock();
+    Servlet::ptr rt = m_root.load(std::memory_order_acquire)->def;
+    readUnlock(slot);
+    return rt;
+}
+
+void ServletDispatch::setDefault(Servlet::ptr slt) {
+    Mutex::Lock lock(m_mutex);
+    std::shared_ptr<Root> root = std::make_shared<Root>(*m_holder);
+    root->def = slt;
+    publish(root);
+}
+
+Servlet::ptr ServletDispatch::getServlet(const std::string &uri) const {
+    return find(Kind::EXACT, uri);
+}
+
+Servlet::ptr ServletDispatch::getGlobServlet(const std::string &pattern) const {
+    return find(Kind::GLOB, pattern);
+}
+
+Servlet::ptr ServletDispatch::getPrefixServlet(const std::string &prefix) const {
+    return find(Kind::PREFIX, prefix);
+}
+
+Servlet::ptr ServletDispatch::getMatchedServlet(const std::string &uri) const {
+    int slot = readLock();
+    const Root *root = m_root.load(std::memory_order_acquire);
+    MatchResult rt;
+    Match(root->tree.get(), uri.data(), uri.size(), 0, rt);
+    Servlet::ptr slt = rt.full ? *rt.full : (rt.prefix ? *rt.prefix : root->def);
+    readUnlock(slot);
+    return slt;
+}
+
+size_t ServletDispatch::size() const {
+    int slot = readLock();
+    size_t rt = m_root.load(std::memory_order_acquire)->size;
+    readUnlock(slot);
+    return rt;
+}
+
+void ServletDispatch::update(Kind kind, const std::string &uri, Servlet::ptr slt) {
+    bool glob = kind == Kind::GLOB;
+    Mutex::Lock lock(m_mutex);
+    const Node *node = Locate(m_holder->tree.get(), uri, glob);
+    bool exists = node && node->slots[(int)kind];
+    if (!slt && !exists) {
+        return;
+    }
+    std::shared_ptr<Root> root = std::make_shared<Root>(*m_holder);
+    root->tree = Insert(m_holder->tree.get(), uri, 0, glob, (int)kind, slt);
+    if (!root->tree) {
+        root->tree = std::make_shared<Node>();
+    }
+    if (slt && !exists) {
+        ++root->size;
+    } else if (!slt) {
+        --root->size;
+    }
+    publish(root);
+}
+
+Servlet::ptr ServletDispatch::find(Kind kind, const std::string &uri) const {
+    int slot = readLock();
+    const Node *node = Locate(m_root.load(std::memory_order_acquire)->tree.get(), uri, kind == Kind::GLOB);
+    Servlet::ptr rt = node ? node->slots[(int)kind] : nullptr;
+    readUnlock(slot);
+    return rt;
+}
+
+void ServletDispatch::publish(std::shared_ptr<const Root> root) {
+    m_root.store(root.get(), std::memory_order_seq_cst);
+    // 切换槽位，之后进入的读者只会看到新的根；等旧槽位上的读者退出
+    uint64_t epoch = m_epoch.load(std::memory_order_relaxed);
+    m_epoch.store(epoch + 1, std::memory_order_seq_cst);
+    while (m_readers[epoch & 1].load(std::memory_order_seq_cst) != 0) {
+        sched_yield();
+    }
+    // 未被新树共享的节点在这里释放
+    m_holder.swap(root);
+}
+
+int ServletDispatch::readLock() const {
+    while (true) {
+        uint64_t epoch = m_epoch.load(std::memory_order_seq_cst);
+        int slot = epoch & 1;
+        m_readers[slot].fetch_add(1, std::memory_order_seq_cst);
+        // 登记期间写者切换了槽位，重新登记，保证写者等待的槽位覆盖所有可能持有旧根的读者
+        if (m_epoch.load(std::memory_order_seq_cst) == epoch) {
+            return slot;
+        }
+        m_readers[slot].fetch_sub(1, std::memory_order_release);
+    }
+}
+
+void ServletDispatch::readUnlock(int slot) const {
+    m_readers[slot].fetch_sub(1, std::memory_order_release);
+}
+
+}
+} // namespace CXS::http
@@ -0,0 +1,131 @@
+#ifndef __CXS_HTTP_SERVLET_H__
+#define __CXS_HTTP_SERVLET_H__
+#include "../code/thread.h"
+#include "http.h"
+#include "http_session.h"
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+namespace CXS {
+namespace http {
+
+class Servlet {
+public:
+    typedef std::shared_ptr<Servlet> ptr;
+    Servlet(const std::string &name) :
+        m_name(name) {}
+    virtual ~Servlet() {}
+    virtual int32_t handle(HttpRequest::ptr request,
+                           HttpResponse::ptr response,
+                           HttpSession::ptr session) = 0;
+    const std::string &getName() const { return m_name; }
+
+protected:
+    std::string m_name;
+};
+
+class FunctionServlet : public Servlet {
+public:
+    typedef std::shared_ptr<FunctionServlet> ptr;
+    typedef std::function<int32_t(HttpRequest::ptr request,
+                                  HttpResponse::ptr response,
+                                  HttpSession::ptr session)>
+        callback;
+    FunctionServlet(callback cb);
+    virtual int32_t handle(HttpRequest::ptr request,
+                           HttpResponse::ptr response,
+                           HttpSession::ptr session) override;
+
+private:
+    callback m_cb;
+};
+
+class NotFoundServlet : public Servlet {
+public:
+    typedef std::shared_ptr<NotFoundServlet> ptr;
+    NotFoundServlet();
+    virtual int32_t handle(HttpRequest::ptr request,
+                           HttpResponse::ptr response,
+                           HttpSession::ptr session) override;
+};
+
+// 路由分发，三种路由：
+//   精确: addServlet("/a/b")，路径完全相等
+//   通配: addGlobServlet("/user/*/info")，'*'匹配一个或多个非'/'字符，其后只能是'/'或结尾
+//   前缀: addPrefixServlet("/static/")，路径以其开头，多个命中时取最长的
+// 优先级 精确 > 通配 > 前缀 > 默认，同一位置上字面字符优先于'*'
+// 路由存放在压缩前缀树中，查找代价与路径长度相关，与路由数量无关，查找过程不分配内存
+// 树的节点只读，修改时复制从根到修改点的路径后原子替换根节点，
+// 读者不加锁，写者之间用互斥量串行并等待旧树上的读者退出后再释放
+class ServletDispatch : public Servlet {
+public:
+    typedef std::shared_ptr<ServletDispatch> ptr;
+    ServletDispatch();
+    ~ServletDispatch();
+    virtual int32_t handle(HttpRequest::ptr request,
+                           HttpResponse::ptr response,
+                           HttpSession::ptr session) override;
+
+    void addServlet(const std::string &uri, Servlet::ptr slt);
+    void addServlet(const std::string &uri, FunctionServlet::callback cb);
+    // pattern不合法('*'后面不是'/'或结尾)返回false
+    bool addGlobServlet(const std::string &pattern, Servlet::ptr slt);
+    bool addGlobServlet(const std::string &pattern, FunctionServlet::callback cb);
+    void addPrefixServlet(const std::string &prefix, Servlet::ptr slt);
+    void addPrefixServlet(const std::string &prefix, FunctionServlet::callback cb);
+
+    void delServlet(const std::string &uri);
+    void delGlobServlet(const std::string &pattern);
+    void delPrefixServlet(const std::string &prefix);
+
+    Servlet::ptr getDefault() const;
+    void setDefault(Servlet::ptr slt);
+
+    // 只查对应类型的路由，未注册返回nullptr
+    Servlet::ptr getServlet(const std::string &uri) const;
+    Servlet::ptr getGlobServlet(const std::string &pattern) const;
+    Servlet::ptr getPrefixServlet(const std::string &prefix) const;
+
+    // 按优先级匹配，都未命中返回默认servlet
+    Servlet::ptr getMatchedServlet(const std::string &uri) const;
+
+    // 路由条数
+    size_t size() const;
+
+public:
+    struct Node;
+    struct Root;
+    typedef std::shared_ptr<const Node> NodePtr;
+    enum class Kind {
+        EXACT = 0,
+        GLOB = 1,
+        PREFIX = 2
+    };
+
+private:
+    // slt为空表示删除
+    void update(Kind kind, const std::string &uri, Servlet::ptr slt);
+    Servlet::ptr find(Kind kind, const std::string &uri) const;
+    // 发布新的根，等旧根上的读者退出后释放，需持有m_mutex
+    void publish(std::shared_ptr<const Root> root);
+    // 进入读临界区，返回读者所在槽位
+    int readLock() const;
+    void readUnlock(int slot) const;
+
+private:
+    // 写者互斥
+    Mutex m_mutex;
+    // 持有当前的根，只在m_mutex下访问
+    std::shared_ptr<const Root> m_holder;
+    // 读者看到的根
+    std::atomic<const Root *> m_root;
+    // 读者计数分两个槽位，写者切换m_epoch后等待旧槽位归零
+    std::atomic<uint64_t> m_epoch;
+    mutable std::atomic<int64_t> m_readers[2];
+};
+
+}
+} // namespace CXS::http
+#endif
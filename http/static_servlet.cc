@@ -0,0 +1,384 @@
+#include "static_servlet.h"
+#include "../code/config.hpp"
+#include "../code/log.h"
+#include "../code/util.h"
+#include <algorithm>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+namespace CXS {
+namespace http {
+
+static CXS::Logger::ptr g_logger = CXS_LOG_NAME("system");
+
+static CXS::ConfigVar<uint32_t>::ptr g_http_static_cache_size =
+    CXS::Config::Lookup("http.static.cache_size", (uint32_t)1024, "http static file max cached fds");
+static CXS::ConfigVar<uint32_t>::ptr g_http_static_stat_ttl =
+    CXS::Config::Lookup("http.static.stat_ttl_ms", (uint32_t)1000, "http static file stat cache time");
+
+static uint32_t s_http_static_stat_ttl = 0;
+namespace {
+struct _StaticFileIniter {
+    _StaticFileIniter() {
+        s_http_static_stat_ttl = g_http_static_stat_ttl->getValue();
+        g_http_static_stat_ttl->addListener([](const uint32_t &ov, const uint32_t &nv) {
+            s_http_static_stat_ttl = nv;
+        });
+    }
+};
+
+static _StaticFileIniter _init;
+} // namespace
+
+static const char *GetContentType(const std::string &path) {
+    static const struct {
+        const char *ext;
+        const char *type;
+    } s_types[] = {
+        {"html", "text/html; charset=utf-8"},
+        {"htm", "text/html; charset=utf-8"},
+        {"css", "text/css; charset=utf-8"},
+        {"js", "application/javascript; charset=utf-8"},
+        {"json", "application/json"},
+        {"txt", "text/plain; charset=utf-8"},
+        {"xml", "application/xml"},
+        {"svg", "image/svg+xml"},
+        {"png", "image/png"},
+        {"jpg", "image/jpeg"},
+        {"jpeg", "image/jpeg"},
+        {"gif", "image/gif"},
+        {"ico", "image/x-icon"},
+        {"webp", "image/webp"},
+        {"woff", "font/woff"},
+        {"woff2", "font/woff2"},
+        {"wasm", "application/wasm"},
+        {"pdf", "application/pdf"},
+        {"mp4", "video/mp4"},
+    };
+    size_t pos = path.rfind('.');
+    if (pos != std::string::npos && path.find('/', pos) == std::string::npos) {
+        const char *ext = path.c_str() + pos + 1;
+        for (auto &i : s_types) {
+            if (strcasecmp(ext, i.ext) == 0) {
+                return i.type;
+            }
+        }
+    }
+    return "application/octet-stream";
+}
+
+static std::string FormatHttpTime(time_t t) {
+    struct tm tm;
+    gmtime_r(&t, &tm);
+    char buf[64];
+    size_t len = strftime(buf, sizeof(buf), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+    return std::string(buf, len);
+}
+
+// 解析失败返回-1
+static time_t ParseHttpTime(const std::string &str) {
+    struct tm tm;
+    memset(&tm, 0, sizeof(tm));
+    const char *end = strptime(str.c_str(), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+    if (!end || *end != '\0') {
+        return -1;
+    }
+    return timegm(&tm);
+}
+
+StaticFile::StaticFile(int fd_, const struct stat &st) :
+    fd(fd_),
+    size(st.st_size),
+    mtime(st.st_mtime),
+    ino(st.st_ino),
+    check_time(GetCurrentMS()) {
+    char buf[64];
+    snprintf(buf, sizeof(buf), "\"%lx-%lx-%lx\"", (unsigned long)st.st_ino, (unsigned long)st.st_size,
+             (unsigned long)st.st_mtim.tv_sec * 1000 + st.st_mtim.tv_nsec / 1000000);
+    etag = buf;
+    last_modified = FormatHttpTime(mtime);
+}
+
+StaticFile::~StaticFile() {
+    ::close(fd);
+}
+
+StaticFileCache::StaticFileCache(size_t capacity) :
+    m_capacity(capacity ? capacity : 1) {
+}
+
+StaticFile::ptr StaticFileCache::open(const std::string &path) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return nullptr;
+    }
+    struct stat fst;
+    if (fstat(fd, &fst) != 0 || !S_ISREG(fst.st_mode)) {
+        ::close(fd);
+        errno = ENOENT;
+        return nullptr;
+    }
+    StaticFile::ptr file(new StaticFile(fd, fst));
+    file->content_type = GetContentType(path);
+    return file;
+}
+
+StaticFile::ptr StaticFileCache::get(const std::string &path) {
+    uint64_t now = GetCurrentMS();
+    StaticFile::ptr cached;
+    {
+        MutexType::Lock lock(m_mutex);
+        auto it = m_map.find(path);
+        if (it != m_map.end()) {
+            m_list.splice(m_list.begin(), m_list, it->second);
+            cached = it->second->second;
+            if (now < cached->check_time + s_http_static_stat_ttl) {
+                ++m_hits;
+                return cached;
+            }
+        }
+    }
+    // 过期的缓存项用stat确认文件是否被替换或修改
+    struct stat st;
+    if (cached) {
+        if (stat(path.c_str(), &st) == 0 && st.st_ino == cached->ino
+            && (uint64_t)st.st_size == cached->size && st.st_mtime == cached->mtime) {
+            MutexType::Lock lock(m_mutex);
+            cached->check_time = now;
+            ++m_hits;
+            return cached;
+        }
+    }
+    StaticFile::ptr file = open(path);
+    int error = errno;
+    std::vector<StaticFile::ptr> evicted;
+    {
+        MutexType::Lock lock(m_mutex);
+        ++m_misses;
+        auto it = m_map.find(path);
+        if (it != m_map.end()) {
+            evicted.push_back(it->second->second);
+            m_list.erase(it->second);
+            m_map.erase(it);
+        }
+        if (file) {
+            m_list.emplace_front(path, file);
+            m_map[path] = m_list.begin();
+            while (m_list.size() > m_capacity) {
+                evicted.push_back(m_list.back().second);
+                m_map.erase(m_list.back().first);
+                m_list.pop_back();
+            }
+        }
+    }
+    // 在锁外关闭被淘汰的fd
+    evicted.clear();
+    errno = error;
+    return file;
+}
+
+void StaticFileCache::clear() {
+    // list在锁释放之后析构，关闭fd不占用锁
+    ListType list;
+    MutexType::Lock lock(m_mutex);
+    list.swap(m_list);
+    m_map.clear();
+}
+
+size_t StaticFileCache::size() const {
+    MutexType::Lock lock(m_mutex);
+    return m_list.size();
+}
+
+StaticFileServlet::StaticFileServlet(const std::string &root, const std::string &prefix,
+                                     StaticFileCache::ptr cache) :
+    Servlet("StaticFileServlet"),
+    m_root(root),
+    m_prefix(prefix),
+    m_cache(cache) {
+    while (m_root.size() > 1 && m_root.back() == '/') {
+        m_root.pop_back();
+    }
+    if (!m_cache) {
+        m_cache.reset(new StaticFileCache(g_http_static_cache_size->getValue()));
+    }
+}
+
+// 路径中不允许出现".."，防止访问根目录之外的文件
+static bool IsSafePath(const std::string &path) {
+    size_t pos = 0;
+    while (pos <= path.size()) {
+        size_t end = path.find('/', pos);
+        if (end == std::string::npos) {
+            end = path.size();
+        }
+        if (end - pos == 2 && path.compare(pos, 2, "..") == 0) {
+            return false;
+        }
+        pos = end + 1;
+    }
+    return path.find('\0') == std::string::npos;
+}
+
+// etag列表中有匹配的，弱比较
+static bool MatchETag(const std::string &list, const std::string &etag) {
+    size_t pos = 0;
+    while (pos < list.size()) {
+        size_t end = list.find(',', pos);
+        if (end == std::string::npos) {
+            end = list.size();
+        }
+        size_t b = list.find_first_not_of(" \t", pos);
+        size_t e = list.find_last_not_of(" \t", end - 1);
+        if (b < end && e != std::string::npos && e >= b) {
+            std::string tag = list.substr(b, e - b + 1);
+            if (tag.compare(0, 2, "W/") == 0) {
+                tag = tag.substr(2);
+            }
+            if (tag == "*" || tag == etag) {
+                return true;
+            }
+        }
+        pos = end + 1;
+    }
+    return false;
+}
+
+// 解析单个区间"bytes=a-b"、"bytes=a-"、"bytes=-n"
+// 返回1得到区间[start, end]，0表示忽略Range返回整个文件，-1表示区间不可满足
+static int ParseRange(const std::string &range, uint64_t size, uint64_t &start, uint64_t &end) {
+    if (range.compare(0, 6, "bytes=") != 0 || range.find(',') != std::string::npos) {
+        return 0;
+    }
+    const char *p = range.c_str() + 6;
+    char *next = nullptr;
+    if (*p == '-') {
+        if (!isdigit(p[1])) {
+            return 0;
+        }
+        uint64_t n = strtoull(p + 1, &next, 10);
+        if (*next != '\0') {
+            return 0;
+        }
+        if (n == 0 || size == 0) {
+            return -1;
+        }
+        start = n >= size ? 0 : size - n;
+        end = size - 1;
+        return 1;
+    }
+    if (!isdigit(*p)) {
+        return 0;
+    }
+    start = strtoull(p, &next, 10);
+    if (*next != '-') {
+        return 0;
+    }
+    p = next + 1;
+    if (*p == '\0') {
+        end = size ? size - 1 : 0;
+    } else {
+        if (!isdigit(*p)) {
+            return 0;
+        }
+        end = strtoull(p, &next, 10);
+        if (*next != '\0' || end < start) {
+            return 0;
+        }
+        end = std::min(end, size - 1);
+    }
+    if (start >= size) {
+        return -1;
+    }
+    return 1;
+}
+
+int32_t StaticFileServlet::handle(HttpRequest::ptr request,
+                                  HttpResponse::ptr response,
+                                  HttpSession::ptr session) {
+    HttpMethod method = request->getMethod();
+    if (method != HttpMethod::GET && method != HttpMethod::HEAD) {
+        response->setStatus(HttpStatus::METHOD_NOT_ALLOWED);
+        response->setHeader("Allow", "GET, HEAD");
+        return 0;
+    }
+    const std::string &uri = request->getPath();
+    if (uri.compare(0, m_prefix.size(), m_prefix) != 0 || !IsSafePath(uri)) {
+        response->setStatus(HttpStatus::FORBIDDEN);
+        return 0;
+    }
+    std::string path = m_root + "/" + uri.substr(m_prefix.size());
+    if (path.back() == '/') {
+        path += "index.html";
+    }
+    StaticFile::ptr file = m_cache->get(path);
+    if (!file) {
+        if (errno == EACCES) {
+            response->setStatus(HttpStatus::FORBIDDEN);
+            return 0;
+        }
+        return NotFoundServlet().handle(request, response, session);
+    }
+
+    response->setHeader("ETag", file->etag);
+    response->setHeader("Last-Modified", file->last_modified);
+    response->setHeader("Accept-Ranges", "bytes");
+    // If-None-Match优先于If-Modified-Since
+    std::string inm = request->getHeaders("if-none-match");
+    if (!inm.empty()) {
+        if (MatchETag(inm, file->etag)) {
+            response->setStatus(HttpStatus::NOT_MODIFIED);
+            return 0;
+        }
+    } else {
+        std::string ims = request->getHeaders("if-modified-since");
+        time_t t = ims.empty() ? -1 : ParseHttpTime(ims);
+        if (t != -1 && file->mtime <= t) {
+            response->setStatus(HttpStatus::NOT_MODIFIED);
+            return 0;
+        }
+    }
+
+    uint64_t start = 0;
+    uint64_t end = file->size ? file->size - 1 : 0;
+    int ranged = 0;
+    std::string range = request->getHeaders("range");
+    if (!range.empty()) {
+        // If-Range与当前文件不一致时返回整个文件
+        std::string if_range = request->getHeaders("if-range");
+        if (if_range.empty() || if_range == file->etag || if_range == file->last_modified) {
+            ranged = ParseRange(range, file->size, start, end);
+        }
+    }
+    if (ranged < 0) {
+        response->setStatus(HttpStatus::RANGE_NOT_SATISFIABLE);
+        response->setHeader("Content-Range", "bytes */" + std::to_string(file->size));
+        return 0;
+    }
+    uint64_t length = file->size ? end - start + 1 : 0;
+    if (ranged > 0) {
+        response->setStatus(HttpStatus::PARTIAL_CONTENT);
+        response->setHeader("Content-Range", "bytes " + std::to_string(start) + "-"
+                                                 + std::to_string(end) + "/" + std::to_string(file->size));
+    }
+    response->setHeader("Content-Type", file->content_type);
+    response->setHeader("Content-Length", std::to_string(length));
+    int rt = session->sendResponseHeader(response);
+    if (rt <= 0) {
+        return rt;
+    }
+    // 发送期间file保持引用，即使被缓存淘汰fd也不会关闭
+    return session->sendFile(file->fd, start, length) == (int64_t)length ? 0 : -1;
+}
+
+}
+} // namespace CXS::http
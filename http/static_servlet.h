@@ -0,0 +1,84 @@
+#ifndef __CXS_HTTP_STATIC_SERVLET_H__
+#define __CXS_HTTP_STATIC_SERVLET_H__
+#include "../code/thread.h"
+#include "servlet.h"
+#include <list>
+#include <memory>
+#include <string>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unordered_map>
+namespace CXS {
+namespace http {
+
+// 打开的文件及其stat结果，头部用到的ETag、Last-Modified在打开时计算一次
+// 从缓存中淘汰后正在发送的请求仍持有智能指针，最后一个引用释放时才关闭fd
+struct StaticFile {
+    typedef std::shared_ptr<StaticFile> ptr;
+    StaticFile(int fd_, const struct stat &st);
+    ~StaticFile();
+
+    int fd;
+    uint64_t size;
+    time_t mtime;
+    ino_t ino;
+    std::string etag;
+    std::string last_modified;
+    std::string content_type;
+    // 上次确认文件没有变化的时间，超过http.static.stat_ttl_ms重新stat
+    uint64_t check_time;
+};
+
+// 按路径缓存打开的文件，LRU淘汰，最多http.static.cache_size个fd
+class StaticFileCache {
+public:
+    typedef std::shared_ptr<StaticFileCache> ptr;
+    typedef Mutex MutexType;
+    StaticFileCache(size_t capacity);
+
+    // 文件不存在、不是普通文件或打不开返回nullptr，errno为原因
+    StaticFile::ptr get(const std::string &path);
+    void clear();
+    size_t size() const;
+
+    uint64_t getHits() const { return m_hits; }
+    uint64_t getMisses() const { return m_misses; }
+
+private:
+    typedef std::list<std::pair<std::string, StaticFile::ptr>> ListType;
+    StaticFile::ptr open(const std::string &path);
+
+private:
+    size_t m_capacity;
+    mutable MutexType m_mutex;
+    // 头部是最近使用的
+    ListType m_list;
+    std::unordered_map<std::string, ListType::iterator> m_map;
+    uint64_t m_hits = 0;
+    uint64_t m_misses = 0;
+};
+
+// 静态文件，配合前缀路由使用: addPrefixServlet("/static/", StaticFileServlet("/var/www", "/static/"))
+// 响应体用sendfile从文件直接发送到socket，不经过用户态内存
+// 支持单个区间的Range(多个区间时返回整个文件)、If-Range、If-None-Match、If-Modified-Since
+class StaticFileServlet : public Servlet {
+public:
+    typedef std::shared_ptr<StaticFileServlet> ptr;
+    // root为文件根目录，请求路径去掉prefix后拼到root后面，以'/'结尾的路径返回index.html
+    StaticFileServlet(const std::string &root, const std::string &prefix = "/",
+                      StaticFileCache::ptr cache = nullptr);
+    virtual int32_t handle(HttpRequest::ptr request,
+                           HttpResponse::ptr response,
+                           HttpSession::ptr session) override;
+
+    StaticFileCache::ptr getCache() const { return m_cache; }
+
+private:
+    std::string m_root;
+    std::string m_prefix;
+    StaticFileCache::ptr m_cache;
+};
+
+}
+} // namespace CXS::http
+#endif
@@ -0,0 +1,124 @@
+#include "../code/tcp_server.h"
+#include "../code/iomanager.h"
+#include "../code/log.h"
+#include "../code/macro.h"
+#include "../code/util.h"
+#include <map>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// 测量TCPServer每秒accept的连接数
+// 用法: test_accept_rate [single|reuseport|exclusive] [accept线程数] [客户端线程数] [秒数]
+// reuseport/exclusive为每个accept线程建一个单线程IOManager作为分片
+
+static CXS::Logger::ptr g_logger = CXS_LOG_ROOT();
+
+static const int PORT = 8099;
+static std::atomic<bool> s_running = {true};
+static std::atomic<uint64_t> s_connects = {0};
+static std::atomic<uint64_t> s_connectFails = {0};
+
+class CountServer : public CXS::TCPServer {
+public:
+    typedef std::shared_ptr<CountServer> ptr;
+    CountServer(CXS::IOManager *worker) :
+        CXS::TCPServer(worker, worker) {}
+
+    std::map<CXS::IOManager *, uint64_t> getShardCounts() {
+        CXS::Mutex::Lock lock(m_mutex);
+        return m_counts;
+    }
+
+protected:
+    void handleClient(CXS::Socket::ptr client) override {
+        {
+            CXS::Mutex::Lock lock(m_mutex);
+            ++m_counts[CXS::IOManager::GetThis()];
+        }
+        client->close();
+    }
+
+private:
+    CXS::Mutex m_mutex;
+    std::map<CXS::IOManager *, uint64_t> m_counts;
+};
+
+void client_loop(CXS::Address::ptr addr) {
+    while (s_running) {
+        CXS::Socket::ptr sock = CXS::Socket::CreateTCP(addr);
+        // 客户端主动RST关闭，不留TIME_WAIT，避免本地端口耗尽
+        struct linger lg = {1, 0};
+        if (sock->connect(addr, 1000)) {
+            sock->setOption(SOL_SOCKET, SO_LINGER, lg);
+            ++s_connects;
+        } else {
+            ++s_connectFails;
+        }
+        sock->close();
+    }
+}
+
+int main(int argc, char **argv) {
+    std::string mode_str = argc > 1 ? argv[1] : "single";
+    int accept_threads = argc > 2 ? atoi(argv[2]) : 2;
+    int client_threads = argc > 3 ? atoi(argv[3]) : 2;
+    int seconds = argc > 4 ? atoi(argv[4]) : 3;
+    g_logger->setLevel(CXS::LogLevel::INFO);
+    CXS::LoggerMgr::GetInstance()->getLogger("system")->setLevel(CXS::LogLevel::FATAL);
+
+    CXS::TCPServer::AcceptMode mode = CXS::TCPServer::AcceptMode::SINGLE;
+    if (mode_str == "reuseport") {
+        mode = CXS::TCPServer::AcceptMode::REUSEPORT;
+    } else if (mode_str == "exclusive") {
+        mode = CXS::TCPServer::AcceptMode::EXCLUSIVE;
+    }
+
+    // single: 一个多线程IOManager，一个accept协程；其他模式: 每个分片一个单线程IOManager
+    std::vector<std::unique_ptr<CXS::IOManager>> shards;
+    std::vector<CXS::IOManager *> workers;
+    if (mode == CXS::TCPServer::AcceptMode::SINGLE) {
+        shards.emplace_back(new CXS::IOManager(accept_threads, false, "accept"));
+    } else {
+        for (int i = 0; i < accept_threads; ++i) {
+            shards.emplace_back(new CXS::IOManager(1, false, "accept_" + std::to_string(i)));
+            workers.push_back(shards.back().get());
+        }
+    }
+    CountServer::ptr server(new CountServer(shards[0].get()));
+    server->setAcceptMode(mode);
+    if (!workers.empty()) {
+        server->setAcceptWorkers(workers);
+    }
+    CXS::Address::ptr addr = CXS::Address::LookupAny("127.0.0.1:" + std::to_string(PORT));
+    CXS_ASSERT(server->bind(addr));
+    server->start();
+
+    {
+        CXS::IOManager clients(client_threads, false, "client");
+        for (int i = 0; i < client_threads * 8; ++i) {
+            clients.schedule(std::bind(client_loop, addr));
+        }
+        uint64_t begin = CXS::GetCurrentUS();
+        uint64_t last = 0;
+        for (int i = 0; i < seconds; ++i) {
+            sleep(1);
+            uint64_t accepts = server->getAcceptCount();
+            CXS_LOG_INFO(g_logger) << mode_str << " second " << i + 1 << ": " << accepts - last << " accepts/s";
+            last = accepts;
+        }
+        uint64_t used = CXS::GetCurrentUS() - begin;
+        s_running = false;
+        CXS_LOG_INFO(g_logger) << mode_str << " accept_threads=" << accept_threads
+                               << " client_threads=" << client_threads
+                               << " avg=" << server->getAcceptCount() * 1000000 / used << " accepts/s"
+                               << " connects=" << s_connects << " connect_fails=" << s_connectFails;
+    }
+    server->stop();
+    int shard = 0;
+    for (auto &i : server->getShardCounts()) {
+        CXS_LOG_INFO(g_logger) << "shard " << shard++ << ": " << i.second << " connections";
+    }
+    shards.clear();
+    return 0;
+}
@@ -0,0 +1,100 @@
+#include "../code/config.hpp"
+#include "../code/fd_manager.h"
+#include "../code/iomanager.h"
+#include "../code/log.h"
+#include "../code/macro.h"
+#include "../code/util.h"
+#include <atomic>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+// CPU密集的回调一直占满任务队列时，socket可读后多久能恢复读协程
+// 用法: test_busy_poll [busy_poll.tasks] [busy_poll.us]，默认64和500，都为0时关闭忙时轮询
+
+static CXS::Logger::ptr g_logger = CXS_LOG_ROOT();
+
+static const int MESSAGES = 500;
+static const uint64_t SPIN_US = 20;
+static std::atomic<bool> s_spinning = {true};
+// 关闭忙时轮询时读协程一直得不到执行，回调最多跑到这个时间
+static uint64_t s_spinUntil = 0;
+static CXS::Histogram s_delay;
+
+// 每个回调忙等SPIN_US后重新调度自己，任务队列永远不空
+void spin() {
+    uint64_t begin = CXS::GetCurrentUS();
+    while (CXS::GetCurrentUS() - begin < SPIN_US) {
+    }
+    if (s_spinning && begin < s_spinUntil) {
+        CXS::IOManager::GetThis()->schedule(spin);
+    }
+}
+
+void reader(int fd) {
+    uint64_t sent = 0;
+    for (int i = 0; i < MESSAGES; ++i) {
+        CXS_ASSERT(read(fd, &sent, sizeof(sent)) == sizeof(sent));
+        s_delay.record(CXS::GetCurrentUS() - sent);
+    }
+    s_spinning = false;
+    close(fd);
+}
+
+int main(int argc, char **argv) {
+    g_logger->setLevel(CXS::LogLevel::INFO);
+    CXS::LoggerMgr::GetInstance()->getLogger("system")->setLevel(CXS::LogLevel::ERROR);
+    CXS::Config::Lookup<uint32_t>("iomanager.busy_poll.tasks")->setValue(argc > 2 ? atoi(argv[1]) : 64);
+    CXS::Config::Lookup<uint64_t>("iomanager.busy_poll.us")->setValue(argc > 2 ? atoi(argv[2]) : 500);
+    int fds[2];
+    CXS_ASSERT(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+    CXS::FdMgr::GetInstance()->get(fds[0], true);
+
+    std::unique_ptr<CXS::IOManager> iom(new CXS::IOManager(1, false, "busy"));
+    iom->schedule(std::bind(reader, fds[0]));
+    usleep(10 * 1000);
+    s_spinUntil = CXS::GetCurrentUS() + MESSAGES * 1000;
+    iom->schedule(spin);
+    iom->schedule(spin);
+
+    // 外部线程每毫秒发送一次当前时间
+    std::thread sender([&]() {
+        for (int i = 0; i < MESSAGES; ++i) {
+            uint64_t now = CXS::GetCurrentUS();
+            CXS_ASSERT(write(fds[1], &now, sizeof(now)) == sizeof(now));
+            usleep(1000);
+        }
+    });
+    sender.join();
+    iom->stop();
+    // 统计接口无锁，监控线程可以在运行中随时读取
+    CXS::Histogram resume;
+    for (size_t i = 0; i < iom->getWorkerCount(); ++i) {
+        const CXS::Scheduler::WorkerStats &stats = iom->getWorkerStats(i);
+        resume.merge(stats.resume_delay);
+        CXS_LOG_INFO(g_logger) << "worker " << i << " tasks=" << stats.tasks
+                               << " busy=" << stats.busy_us * 100 / (stats.busy_us + stats.idle_us + 1) << "%"
+                               << " queue_wait_p99=" << stats.queue_wait.percentile(0.99) << "us"
+                               << " run_time_p99=" << stats.run_time.percentile(0.99) << "us";
+    }
+    CXS::IOManager::EventStats events = iom->getEventStats();
+    CXS_LOG_INFO(g_logger) << "epoll_wait=" << events.epoll_wait
+                           << " batch_p99=" << iom->getEpollBatchSize().percentile(0.99)
+                           << " blocked_p99=" << iom->getEpollWaitTime().percentile(0.99) << "us"
+                           << " tickles=" << events.tickles
+                           << " timer_late_p99=" << iom->getTimerLateness().percentile(0.99) << "ms";
+    uint64_t resume_p99 = resume.percentile(0.99);
+    uint64_t busy_polls = events.busy_poll;
+    iom.reset();
+    close(fds[1]);
+
+    CXS_LOG_INFO(g_logger) << "busy_poll.tasks=" << CXS::Config::Lookup<uint32_t>("iomanager.busy_poll.tasks")->getValue()
+                           << " busy_poll.us=" << CXS::Config::Lookup<uint64_t>("iomanager.busy_poll.us")->getValue()
+                           << " messages=" << s_delay.getCount()
+                           << " p50=" << s_delay.percentile(0.5) << "us"
+                           << " p99=" << s_delay.percentile(0.99) << "us"
+                           << " max=" << s_delay.getMax() << "us"
+                           << " resume_p99=" << resume_p99 << "us"
+                           << " busy_polls=" << busy_polls;
+    return 0;
+}
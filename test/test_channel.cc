@@ -0,0 +1,166 @@
+#include "../code/channel.h"
+#include "../code/iomanager.h"
+#include "../code/log.h"
+#include "../code/macro.h"
+#include "../code/util.h"
+#include <atomic>
+#include <memory>
+#include <string>
+
+// 协程间的有界通道: 满/空时挂起协程，批量收发，关闭，接收超时，多通道Select
+
+static CXS::Logger::ptr g_logger = CXS_LOG_ROOT();
+
+static const int PRODUCERS = 4;
+static const int CONSUMERS = 4;
+static const int ITEMS = 5000;
+
+// 多生产者多消费者，元素只能移动
+void test_mpmc() {
+    CXS::Channel<std::unique_ptr<int>> ch(16);
+    std::atomic<int64_t> sum = {0};
+    std::atomic<int> producers = {PRODUCERS};
+    std::atomic<size_t> max_size = {0};
+    {
+        CXS::IOManager iom(4, false, "mpmc");
+        for (int i = 0; i < PRODUCERS; ++i) {
+            iom.schedule([&]() {
+                for (int j = 1; j <= ITEMS; ++j) {
+                    CXS_ASSERT(ch.send(std::unique_ptr<int>(new int(j))));
+                    size_t size = ch.size();
+                    size_t m = max_size;
+                    while (size > m && !max_size.compare_exchange_weak(m, size)) {
+                    }
+                }
+                if (--producers == 0) {
+                    ch.close();
+                }
+            });
+        }
+        for (int i = 0; i < CONSUMERS; ++i) {
+            iom.schedule([&]() {
+                std::unique_ptr<int> v;
+                while (ch.recv(v)) {
+                    sum += *v;
+                }
+            });
+        }
+    }
+    CXS_ASSERT(sum == (int64_t)PRODUCERS * ITEMS * (ITEMS + 1) / 2);
+    CXS_ASSERT(max_size <= ch.getCapacity());
+    CXS_ASSERT(!ch.send(std::unique_ptr<int>(new int(0))));
+    CXS_LOG_INFO(g_logger) << "mpmc sum=" << sum << " max_size=" << max_size;
+}
+
+void test_batch() {
+    CXS::Channel<int> ch(64);
+    int64_t sum = 0;
+    size_t batches = 0;
+    {
+        CXS::IOManager iom(2, false, "batch");
+        iom.schedule([&]() {
+            std::vector<int> items;
+            for (int j = 1; j <= ITEMS; ++j) {
+                items.push_back(j);
+            }
+            CXS_ASSERT(ch.send(items) == ITEMS);
+            CXS_ASSERT(items.empty());
+            ch.close();
+        });
+        iom.schedule([&]() {
+            std::vector<int> out;
+            while (ch.recv(out, 32) > 0) {
+                ++batches;
+                for (auto v : out) {
+                    sum += v;
+                }
+                out.clear();
+            }
+        });
+    }
+    CXS_ASSERT(sum == (int64_t)ITEMS * (ITEMS + 1) / 2);
+    CXS_LOG_INFO(g_logger) << "batch sum=" << sum << " batches=" << batches;
+}
+
+// 关闭后剩余数据仍能取出，接收超时
+void test_close_timeout() {
+    bool ok = false;
+    {
+        CXS::IOManager iom(1, false, "close");
+        iom.schedule([&]() {
+            CXS::Channel<std::string> ch(4);
+            CXS_ASSERT(ch.trySend(std::string("a")));
+            ch.close();
+            std::string v;
+            CXS_ASSERT(ch.recv(v) && v == "a");
+            CXS_ASSERT(!ch.recv(v));
+
+            CXS::Channel<int> empty(1);
+            int i = 0;
+            uint64_t begin = CXS::GetCurrentMS();
+            CXS_ASSERT(!empty.recv(i, 20));
+            CXS_ASSERT(CXS::GetCurrentMS() - begin >= 20);
+            CXS_ASSERT(empty.trySend(1) && !empty.trySend(2));
+            ok = empty.recv(i, 20) && i == 1;
+        });
+    }
+    CXS_ASSERT(ok);
+    CXS_LOG_INFO(g_logger) << "close and timeout ok";
+}
+
+// 一个协程等待两个不同类型的通道，不轮询
+void test_select() {
+    CXS::Channel<int> ints(4);
+    CXS::Channel<std::string> strs(4);
+    int got_ints = 0;
+    int got_strs = 0;
+    bool timed_out = false;
+    {
+        CXS::IOManager iom(2, false, "select");
+        iom.schedule([&]() {
+            std::vector<CXS::ChannelBase *> chs = {&ints, &strs};
+            while (true) {
+                int i = CXS::Select(chs);
+                int v = 0;
+                std::string s;
+                if (i == 0 && ints.tryRecv(v)) {
+                    ++got_ints;
+                } else if (i == 1 && strs.tryRecv(s)) {
+                    ++got_strs;
+                }
+                if (ints.isClosed() && strs.isClosed() && ints.size() == 0 && strs.size() == 0) {
+                    break;
+                }
+            }
+            CXS::Channel<int> idle(1);
+            std::vector<CXS::ChannelBase *> idles = {&idle};
+            timed_out = CXS::Select(idles, 20) == -1;
+        });
+        iom.schedule([&]() {
+            for (int j = 0; j < 1000; ++j) {
+                ints.send(j);
+            }
+            ints.close();
+        });
+        iom.schedule([&]() {
+            for (int j = 0; j < 1000; ++j) {
+                strs.send(std::to_string(j));
+            }
+            strs.close();
+        });
+    }
+    CXS_ASSERT(got_ints == 1000 && got_strs == 1000);
+    CXS_ASSERT(timed_out);
+    CXS_LOG_INFO(g_logger) << "select ints=" << got_ints << " strs=" << got_strs;
+}
+
+int main(int argc, char **argv) {
+    CXS::LoggerMgr::GetInstance()->getLogger("system")->setLevel(CXS::LogLevel::ERROR);
+    uint64_t begin = CXS::GetCurrentUS();
+    test_mpmc();
+    test_batch();
+    test_close_timeout();
+    test_select();
+    CXS_LOG_INFO(g_logger) << "all passed in " << (CXS::GetCurrentUS() - begin) / 1000 << "ms";
+    return 0;
+}
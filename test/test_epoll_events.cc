@@ -0,0 +1,186 @@
+#include "../code/log.h"
+#include "../code/config.hpp"
+#include "../code/iomanager.h"
+#include "../code/socket.h"
+#include "../code/address.h"
+#include "../code/util.h"
+#include "../code/fd_manager.h"
+#include "../code/thread.h"
+#include <sys/socket.h>
+
+CXS::Logger::ptr g_logger = CXS_LOG_ROOT();
+
+static const int ROUNDS = 20000;
+static const uint16_t PORT = 8094;
+
+// 模拟keep-alive连接: 客户端发请求，服务端回响应，统计每个请求的epoll系统调用次数
+void echo_server(CXS::Socket::ptr listener) {
+    CXS::Socket::ptr client = listener->accept();
+    CXS_ASSERT(client);
+    char buf[64];
+    while (true) {
+        int rt = client->recv(buf, sizeof(buf));
+        if (rt <= 0) {
+            break;
+        }
+        client->send(buf, rt);
+    }
+    client->close();
+    listener->close();
+}
+
+void echo_client() {
+    CXS::IOManager *iom = CXS::IOManager::GetThis();
+    CXS::Socket::ptr sock = CXS::Socket::CreateTCPSocket();
+    CXS_ASSERT(sock->connect(CXS::IPv4Address::Create("127.0.0.1", PORT)));
+
+    char buf[64] = "ping";
+    CXS::IOManager::EventStats before = iom->getEventStats();
+    uint64_t begin = CXS::GetCurrentUS();
+    for (int i = 0; i < ROUNDS; ++i) {
+        CXS_ASSERT(sock->send(buf, sizeof(buf)) == sizeof(buf));
+        int len = 0;
+        while (len < (int)sizeof(buf)) {
+            int rt = sock->recv(buf + len, sizeof(buf) - len);
+            CXS_ASSERT(rt > 0);
+            len += rt;
+        }
+    }
+    uint64_t used = CXS::GetCurrentUS() - begin;
+    CXS::IOManager::EventStats after = iom->getEventStats();
+    CXS_LOG_INFO(g_logger) << "persistent=" << CXS::Config::Lookup<bool>("iomanager.persistent_events")->getValue()
+                           << " rounds=" << ROUNDS << " us/round=" << (double)used / ROUNDS
+                           << " epoll_ctl/round=" << (double)(after.epoll_ctl - before.epoll_ctl) / ROUNDS
+                           << " epoll_wait/round=" << (double)(after.epoll_wait - before.epoll_wait) / ROUNDS
+                           << " ready_hits=" << (after.ready_hits - before.ready_hits);
+
+    // 接收超时在持久注册模式下同样生效
+    sock->setRecvTimeOut(50);
+    int rt = sock->recv(buf, sizeof(buf));
+    int error = errno;
+    CXS_ASSERT(rt == -1 && error == ETIMEDOUT);
+    sock->close();
+}
+
+// 一次epoll_wait返回大量就绪事件: FANOUT个协程各等待一个socketpair，全部写入后统计全部被唤醒的耗时
+static const int FANOUT = 256;
+static const int FANOUT_ROUNDS = 200;
+static std::atomic<int> s_woken = {0};
+static std::atomic<uint64_t> s_lastWake = {0};
+// 最后一个被唤醒的读协程通过它通知写协程
+static int s_doneFds[2];
+
+void fanout_reader(int fd) {
+    char c;
+    for (int i = 0; i < FANOUT_ROUNDS; ++i) {
+        CXS_ASSERT(read(fd, &c, 1) == 1);
+        if (++s_woken == FANOUT) {
+            s_lastWake = CXS::GetCurrentUS();
+            CXS_ASSERT(write(s_doneFds[1], "x", 1) == 1);
+        }
+    }
+    close(fd);
+}
+
+void fanout_writer(std::vector<int> fds) {
+    uint64_t total = 0;
+    for (int i = 0; i < FANOUT_ROUNDS; ++i) {
+        // 等所有读协程挂起后再一起写入
+        usleep(2000);
+        s_woken = 0;
+        uint64_t begin = CXS::GetCurrentUS();
+        for (int fd : fds) {
+            CXS_ASSERT(write(fd, "x", 1) == 1);
+        }
+        char c;
+        CXS_ASSERT(read(s_doneFds[0], &c, 1) == 1);
+        total += s_lastWake - begin;
+    }
+    for (int fd : fds) {
+        close(fd);
+    }
+    close(s_doneFds[0]);
+    close(s_doneFds[1]);
+    CXS_LOG_INFO(g_logger) << "fanout=" << FANOUT << " rounds=" << FANOUT_ROUNDS
+                           << " us/round=" << (double)total / FANOUT_ROUNDS;
+}
+
+void fanout_bench() {
+    CXS_ASSERT(socketpair(AF_UNIX, SOCK_STREAM, 0, s_doneFds) == 0);
+    CXS::FdMgr::GetInstance()->get(s_doneFds[0], true);
+    CXS::FdMgr::GetInstance()->get(s_doneFds[1], true);
+    std::vector<int> writers;
+    for (int i = 0; i < FANOUT; ++i) {
+        int fds[2];
+        CXS_ASSERT(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+        // 登记到FdManager，设为非阻塞，读时由hook挂起协程
+        CXS::FdMgr::GetInstance()->get(fds[0], true);
+        CXS::FdMgr::GetInstance()->get(fds[1], true);
+        CXS::IOManager::GetThis()->schedule(std::bind(fanout_reader, fds[0]));
+        writers.push_back(fds[1]);
+    }
+    fanout_writer(writers);
+}
+
+// 读一个字节，数据由定时器稍后写入，读协程需要挂起等待
+static void read_later(int rfd, int wfd) {
+    CXS::IOManager::GetThis()->addTimer(10, [wfd]() { CXS_ASSERT(write(wfd, "x", 1) == 1); });
+    char c;
+    CXS_ASSERT(read(rfd, &c, 1) == 1);
+}
+
+// fd在没有hook的线程上关闭后句柄号被复用，上一个fd的持久注册状态不能沿用到新fd上
+void fd_reuse() {
+    int fds[2];
+    CXS_ASSERT(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+    CXS::FdMgr::GetInstance()->get(fds[0], true);
+    CXS::FdMgr::GetInstance()->get(fds[1], true);
+    read_later(fds[0], fds[1]);
+    int old_fd = fds[0];
+    CXS::Thread closer([fds]() {
+        close(fds[0]);
+        close(fds[1]);
+    }, "closer");
+    closer.join();
+
+    // 更小的句柄号可能空闲，一直创建到复用old_fd为止
+    std::vector<int> spare;
+    while (true) {
+        CXS_ASSERT(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+        if (fds[1] == old_fd) {
+            std::swap(fds[0], fds[1]);
+        }
+        if (fds[0] == old_fd) {
+            break;
+        }
+        spare.push_back(fds[0]);
+        spare.push_back(fds[1]);
+    }
+    for (int fd : spare) {
+        close(fd);
+    }
+    CXS::FdMgr::GetInstance()->get(fds[0], true)->setTimeout(SO_RCVTIMEO, 1000);
+    CXS::FdMgr::GetInstance()->get(fds[1], true);
+    read_later(fds[0], fds[1]);
+    CXS_LOG_INFO(g_logger) << "fd " << old_fd << " reused after closed on another thread";
+    close(fds[0]);
+    close(fds[1]);
+}
+
+int main(int argc, char const *argv[]) {
+    CXS::LoggerMgr::GetInstance()->getLogger("system")->setLevel(CXS::LogLevel::INFO);
+    bool persistent = !(argc > 1 && std::string(argv[1]) == "oneshot");
+    CXS::Config::Lookup<bool>("iomanager.persistent_events")->setValue(persistent);
+
+    CXS::IOManager iom(2, false, "events");
+    CXS::Socket::ptr listener = CXS::Socket::CreateTCPSocket();
+    CXS_ASSERT(listener->bind(CXS::IPv4Address::Create("127.0.0.1", PORT)));
+    CXS_ASSERT(listener->listen());
+    iom.schedule(std::bind(echo_server, listener));
+    iom.schedule([]() {
+        echo_client();
+        fd_reuse();
+        fanout_bench();
+    });
+    return 0;
+}
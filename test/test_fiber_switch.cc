@@ -0,0 +1,58 @@
+#include "../code/log.h"
+#include "../code/fiber.hpp"
+#include "../code/util.h"
+#include <sys/time.h>
+
+CXS::Logger::ptr g_logger = CXS_LOG_ROOT();
+
+static uint64_t NowUs() {
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    return tv.tv_sec * 1000 * 1000ul + tv.tv_usec;
+}
+
+// 协程切换微基准: 主协程与子协程之间来回切换，统计单次切换耗时
+void bench_switch(uint64_t rounds) {
+    CXS::Fiber::GetThis();
+    CXS::Fiber *self = nullptr;
+    uint64_t count = 0;
+    double acc = 0.5;
+    CXS::Fiber::ptr fiber(new CXS::Fiber([&self, &count, &acc, rounds]() {
+        for (uint64_t i = 0; i < rounds; ++i) {
+            ++count;
+            acc *= 1.0000001;
+            self->back();
+        }
+    }, 0, true));
+    self = fiber.get();
+
+    uint64_t begin = NowUs();
+    for (uint64_t i = 0; i < rounds; ++i) {
+        fiber->call();
+    }
+    uint64_t used = NowUs() - begin;
+    // 让子协程执行结束
+    fiber->call();
+    CXS_ASSERT(fiber->getState() == CXS::Fiber::TERM);
+    CXS_ASSERT(count == rounds);
+
+    CXS_LOG_INFO(g_logger) << "rounds=" << rounds
+                           << " switches=" << rounds * 2
+                           << " used=" << used << "us"
+                           << " ns/switch=" << (used * 1000.0 / (rounds * 2))
+                           << " acc=" << acc;
+}
+
+int main(int argc, char const *argv[]) {
+    uint64_t rounds = 1000 * 1000;
+    if (argc > 1) {
+        rounds = atoll(argv[1]);
+    }
+#ifdef CXS_FIBER_ASM_CONTEXT
+    CXS_LOG_INFO(g_logger) << "context: asm";
+#else
+    CXS_LOG_INFO(g_logger) << "context: ucontext";
+#endif
+    bench_switch(rounds);
+    return 0;
+}
@@ -0,0 +1,185 @@
+#include "../code/fiber_sync.h"
+#include "../code/iomanager.h"
+#include "../code/log.h"
+#include "../code/macro.h"
+#include "../code/util.h"
+#include <atomic>
+#include <deque>
+#include <unistd.h>
+
+// 协程同步原语: 竞争时挂起协程而不阻塞工作线程
+
+static CXS::Logger::ptr g_logger = CXS_LOG_ROOT();
+
+static const int FIBERS = 16;
+static const int LOOPS = 1000;
+
+// 临界区内让出执行权，制造竞争
+void test_mutex() {
+    CXS::FiberMutex mutex;
+    int count = 0;
+    {
+        CXS::IOManager iom(4, false, "mutex");
+        for (int i = 0; i < FIBERS; ++i) {
+            iom.schedule([&]() {
+                for (int j = 0; j < LOOPS; ++j) {
+                    CXS::FiberMutex::Lock lock(mutex);
+                    int v = count;
+                    if (j % 100 == 0) {
+                        CXS::Fiber::YieldToReady();
+                    }
+                    count = v + 1;
+                }
+            });
+        }
+    }
+    CXS_ASSERT(count == FIBERS * LOOPS);
+    CXS_LOG_INFO(g_logger) << "mutex count=" << count;
+}
+
+// 单线程上持锁的协程睡眠时，等锁的协程挂起，其他协程照常执行
+void test_no_stall() {
+    CXS::FiberMutex mutex;
+    std::atomic<int> progress = {0};
+    std::atomic<bool> locked = {false};
+    int progress_when_locked = -1;
+    {
+        CXS::IOManager iom(1, false, "stall");
+        iom.schedule([&]() {
+            CXS::FiberMutex::Lock lock(mutex);
+            usleep(50 * 1000);
+        });
+        iom.schedule([&]() {
+            CXS::FiberMutex::Lock lock(mutex);
+            locked = true;
+            progress_when_locked = progress;
+        });
+        iom.schedule([&]() {
+            while (!locked) {
+                ++progress;
+                usleep(1000);
+            }
+        });
+    }
+    CXS_ASSERT(progress_when_locked > 10);
+    CXS_LOG_INFO(g_logger) << "no stall progress=" << progress_when_locked;
+}
+
+void test_condition() {
+    CXS::FiberMutex mutex;
+    CXS::FiberCondition cond;
+    std::deque<int> queue;
+    int sum = 0;
+    bool timed_out = false;
+    {
+        CXS::IOManager iom(2, false, "cond");
+        for (int i = 0; i < 4; ++i) {
+            iom.schedule([&]() {
+                for (int j = 0; j < LOOPS; ++j) {
+                    CXS::FiberMutex::Lock lock(mutex);
+                    while (queue.empty()) {
+                        cond.wait(mutex);
+                    }
+                    sum += queue.front();
+                    queue.pop_front();
+                }
+            });
+        }
+        iom.schedule([&]() {
+            for (int j = 0; j < 4 * LOOPS; ++j) {
+                CXS::FiberMutex::Lock lock(mutex);
+                queue.push_back(1);
+                cond.notify();
+            }
+        });
+        iom.schedule([&]() {
+            CXS::FiberMutex m;
+            CXS::FiberCondition c;
+            CXS::FiberMutex::Lock lock(m);
+            uint64_t begin = CXS::GetCurrentMS();
+            timed_out = !c.wait(m, 20) && CXS::GetCurrentMS() - begin >= 20;
+        });
+    }
+    CXS_ASSERT(sum == 4 * LOOPS);
+    CXS_ASSERT(timed_out);
+    CXS_LOG_INFO(g_logger) << "condition sum=" << sum;
+}
+
+void test_semaphore() {
+    CXS::FiberSemaphore sem(3);
+    std::atomic<int> running = {0};
+    std::atomic<int> max_running = {0};
+    bool timed_out = false;
+    {
+        CXS::IOManager iom(4, false, "sem");
+        for (int i = 0; i < FIBERS; ++i) {
+            iom.schedule([&]() {
+                for (int j = 0; j < 10; ++j) {
+                    sem.wait();
+                    int r = ++running;
+                    int m = max_running;
+                    while (r > m && !max_running.compare_exchange_weak(m, r)) {
+                    }
+                    usleep(100);
+                    --running;
+                    sem.notify();
+                }
+            });
+        }
+        iom.schedule([&]() {
+            CXS::FiberSemaphore empty;
+            timed_out = !empty.wait(20) && !empty.tryWait();
+        });
+    }
+    CXS_ASSERT(max_running <= 3);
+    CXS_ASSERT(sem.getCount() == 3);
+    CXS_ASSERT(timed_out);
+    CXS_LOG_INFO(g_logger) << "semaphore max_running=" << max_running;
+}
+
+void test_rwmutex() {
+    CXS::FiberRWMutex mutex;
+    std::atomic<int> readers = {0};
+    std::atomic<int> writers = {0};
+    std::atomic<int> max_readers = {0};
+    int value = 0;
+    {
+        CXS::IOManager iom(4, false, "rw");
+        for (int i = 0; i < FIBERS; ++i) {
+            iom.schedule([&, i]() {
+                for (int j = 0; j < 200; ++j) {
+                    if (i % 4 == 0) {
+                        CXS::FiberRWMutex::WriteLock lock(mutex);
+                        CXS_ASSERT(++writers == 1 && readers == 0);
+                        ++value;
+                        CXS::Fiber::YieldToReady();
+                        --writers;
+                    } else {
+                        CXS::FiberRWMutex::ReadLock lock(mutex);
+                        int r = ++readers;
+                        CXS_ASSERT(writers == 0);
+                        int m = max_readers;
+                        while (r > m && !max_readers.compare_exchange_weak(m, r)) {
+                        }
+                        CXS::Fiber::YieldToReady();
+                        --readers;
+                    }
+                }
+            });
+        }
+    }
+    CXS_ASSERT(value == FIBERS / 4 * 200);
+    CXS_LOG_INFO(g_logger) << "rwmutex value=" << value << " max_readers=" << max_readers;
+}
+
+int main(int argc, char **argv) {
+    CXS::LoggerMgr::GetInstance()->getLogger("system")->setLevel(CXS::LogLevel::ERROR);
+    uint64_t begin = CXS::GetCurrentUS();
+    test_mutex();
+    test_no_stall();
+    test_condition();
+    test_semaphore();
+    test_rwmutex();
+    CXS_LOG_INFO(g_logger) << "all passed in " << (CXS::GetCurrentUS() - begin) / 1000 << "ms";
+    return 0;
+}
@@ -0,0 +1,182 @@
+#include "../code/fiber_sync.h"
+#include "../code/future.h"
+#include "../code/iomanager.h"
+#include "../code/log.h"
+#include "../code/macro.h"
+#include "../code/util.h"
+#include <atomic>
+#include <stdexcept>
+#include <stdlib.h>
+#include <string>
+
+// Scheduler::async返回的Future、then、whenAll/whenAny以及WaitGroup，等待时都只挂起协程
+
+static CXS::Logger::ptr g_logger = CXS_LOG_ROOT();
+
+// 统计堆分配次数
+static std::atomic<uint64_t> s_allocs = {0};
+
+void *operator new(size_t size) {
+    ++s_allocs;
+    void *p = malloc(size ? size : 1);
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void *p) noexcept {
+    free(p);
+}
+
+int fib(int n) {
+    return n < 2 ? n : fib(n - 1) + fib(n - 2);
+}
+
+void test_async() {
+    {
+        CXS::IOManager iom(2, false, "async");
+        iom.schedule([&iom]() {
+            CXS::Future<int> f = iom.async([]() { return fib(20); });
+            CXS_ASSERT(f.get() == 6765);
+
+            CXS::Future<std::string> s = iom.async([]() { return std::string("hello"); })
+                                             .then([](std::string &v) { return v + " world"; });
+            CXS_ASSERT(s.get() == "hello world");
+
+            CXS::Future<void> v = iom.async([]() { CXS::Fiber::YieldToReady(); });
+            CXS::Future<int> after = v.then([]() { return 1; });
+            CXS_ASSERT(after.get() == 1 && v.isReady());
+
+            // 异常沿then传递，在get中重新抛出
+            CXS::Future<int> err = iom.async([]() -> int { throw std::runtime_error("boom"); })
+                                       .then([](int &v) { return v + 1; });
+            bool caught = false;
+            try {
+                err.get();
+            } catch (const std::runtime_error &e) {
+                caught = std::string(e.what()) == "boom";
+            }
+            CXS_ASSERT(caught);
+
+            // 带超时的等待
+            CXS::Future<int> slow = iom.async([]() {
+                usleep(50 * 1000);
+                return 2;
+            });
+            CXS_ASSERT(!slow.wait(10));
+            CXS_ASSERT(slow.get() == 2);
+        });
+    }
+    CXS_LOG_INFO(g_logger) << "async ok";
+}
+
+// 单线程上get挂起调用协程，被等待的任务仍能执行
+void test_single_thread() {
+    int rt = 0;
+    {
+        CXS::IOManager iom(1, false, "single");
+        iom.schedule([&]() {
+            std::vector<CXS::Future<int>> futures;
+            for (int i = 0; i < 100; ++i) {
+                futures.push_back(iom.async([i]() {
+                    CXS::Fiber::YieldToReady();
+                    return i;
+                }));
+            }
+            for (auto &f : futures) {
+                rt += f.get();
+            }
+        });
+    }
+    CXS_ASSERT(rt == 4950);
+    CXS_LOG_INFO(g_logger) << "single thread sum=" << rt;
+}
+
+void test_when() {
+    int sum = 0;
+    size_t first = ~0ull;
+    {
+        CXS::IOManager iom(4, false, "when");
+        iom.schedule([&]() {
+            std::vector<CXS::Future<int>> futures;
+            for (int i = 0; i < 32; ++i) {
+                futures.push_back(iom.async([i]() { return fib(15 + i % 5); }));
+            }
+            CXS::whenAll(futures).get();
+            for (auto &f : futures) {
+                CXS_ASSERT(f.isReady());
+                sum += f.get();
+            }
+
+            std::vector<CXS::Future<int>> race;
+            race.push_back(iom.async([]() {
+                usleep(100 * 1000);
+                return 0;
+            }));
+            race.push_back(iom.async([]() { return 1; }));
+            first = CXS::whenAny(race).get();
+            race[0].get();
+        });
+    }
+    CXS_ASSERT(sum > 0 && first == 1);
+    CXS_LOG_INFO(g_logger) << "whenAll sum=" << sum << " whenAny first=" << first;
+}
+
+void test_wait_group() {
+    std::atomic<int> done = {0};
+    bool all_done = false;
+    {
+        CXS::IOManager iom(4, false, "wg");
+        iom.schedule([&]() {
+            CXS::WaitGroup wg;
+            for (int i = 0; i < 64; ++i) {
+                wg.add();
+                iom.schedule([&]() {
+                    usleep(1000);
+                    ++done;
+                    wg.done();
+                });
+            }
+            wg.wait();
+            all_done = done == 64;
+        });
+    }
+    CXS_ASSERT(all_done);
+    CXS_LOG_INFO(g_logger) << "wait group done=" << done;
+}
+
+// 工作线程内async只有共享状态一次分配(调度队列扩容等偶尔的分配除外)
+void test_allocs() {
+    static const int N = 10000;
+    double per_task = 0;
+    {
+        CXS::IOManager iom(1, false, "allocs");
+        iom.schedule([&]() {
+            std::vector<CXS::Future<int>> futures;
+            futures.reserve(N);
+            uint64_t begin = s_allocs;
+            for (int i = 0; i < N; ++i) {
+                futures.push_back(iom.async([i]() { return i; }));
+            }
+            per_task = (double)(s_allocs - begin) / N;
+            for (auto &f : futures) {
+                f.get();
+            }
+        });
+    }
+    CXS_ASSERT(per_task < 1.5);
+    CXS_LOG_INFO(g_logger) << "allocations per async=" << per_task;
+}
+
+int main(int argc, char **argv) {
+    CXS::LoggerMgr::GetInstance()->getLogger("system")->setLevel(CXS::LogLevel::ERROR);
+    uint64_t begin = CXS::GetCurrentUS();
+    test_async();
+    test_single_thread();
+    test_when();
+    test_wait_group();
+    test_allocs();
+    CXS_LOG_INFO(g_logger) << "all passed in " << (CXS::GetCurrentUS() - begin) / 1000 << "ms";
+    return 0;
+}
@@ -0,0 +1,213 @@
+#include "../http/http_connection.h"
+#include "../http/http_server.h"
+#include "../code/iomanager.h"
+#include "../code/log.h"
+#include "../code/macro.h"
+#include "../code/util.h"
+#include <unistd.h>
+
+static CXS::Logger::ptr g_logger = CXS_LOG_ROOT();
+
+static const uint32_t PORT = 8097;
+
+void log_stats(const char *name, CXS::http::HttpConnectionPool::ptr pool) {
+    auto s = pool->getStats();
+    CXS_LOG_INFO(g_logger) << name << ": requests=" << s.requests << " hits=" << s.hits
+                           << " misses=" << s.misses << " connects=" << s.connects
+                           << " waits=" << s.waits << " wait_us=" << s.wait_us
+                           << " timeouts=" << s.timeouts << " idle=" << s.idle << " total=" << s.total;
+}
+
+// 顺序请求只建一个连接
+void test_reuse() {
+    CXS::http::HttpConnectionPool::ptr pool(
+        new CXS::http::HttpConnectionPool("127.0.0.1", PORT, 4, 10000, 60000, 1000));
+    for (int i = 0; i < 100; ++i) {
+        auto r = pool->doGet("/hello", 1000);
+        CXS_ASSERT(r->result == 0);
+        CXS_ASSERT(r->response->getBody() == "Hello, world!");
+    }
+    auto r = pool->doPost("/echo", 1000, {}, "ping");
+    CXS_ASSERT(r->result == 0 && r->response->getBody() == "ping");
+    log_stats("reuse", pool);
+    auto s = pool->getStats();
+    CXS_ASSERT(s.connects == 1 && s.hits == 100 && s.idle == 1);
+}
+
+// 单个连接处理到max_requests个请求后换新连接
+void test_max_requests() {
+    CXS::http::HttpConnectionPool::ptr pool(
+        new CXS::http::HttpConnectionPool("127.0.0.1", PORT, 4, 10000, 60000, 10));
+    for (int i = 0; i < 25; ++i) {
+        CXS_ASSERT(pool->doGet("/hello", 1000)->result == 0);
+    }
+    log_stats("max_requests", pool);
+    CXS_ASSERT(pool->getStats().connects == 3);
+}
+
+// 调用方显式要求connection: close时不被改成keep-alive，连接用完不放回连接池
+void test_close() {
+    CXS::http::HttpConnectionPool::ptr pool(
+        new CXS::http::HttpConnectionPool("127.0.0.1", PORT, 4, 10000, 60000, 100));
+    for (int i = 0; i < 2; ++i) {
+        auto r = pool->doGet("/conn", 1000, {{"Connection", "close"}});
+        CXS_ASSERT(r->result == 0 && r->response->getBody() == "close");
+    }
+    auto r = pool->doGet("/conn", 1000);
+    CXS_ASSERT(r->result == 0 && r->response->getBody() == "keep-alive");
+    log_stats("close", pool);
+    auto s = pool->getStats();
+    CXS_ASSERT(s.connects == 3 && s.idle == 1);
+}
+
+// GET在同一个连接上流水线发送，POST单独发送
+void test_pipeline() {
+    CXS::http::HttpConnectionPool::ptr pool(
+        new CXS::http::HttpConnectionPool("127.0.0.1", PORT, 4, 10000, 60000, 100));
+    std::vector<CXS::http::HttpRequest::ptr> requests;
+    for (int i = 0; i < 8; ++i) {
+        CXS::http::HttpRequest::ptr req(new CXS::http::HttpRequest);
+        if (i == 5) {
+            req->setMethod(CXS::http::HttpMethod::POST);
+            req->setPath("/echo");
+            req->setBody("body" + std::to_string(i));
+        } else {
+            req->setPath("/user/" + std::to_string(i));
+        }
+        requests.push_back(req);
+    }
+    auto results = pool->doRequests(requests, 1000);
+    for (int i = 0; i < 8; ++i) {
+        CXS_ASSERT(results[i]->result == 0);
+        std::string expect = i == 5 ? "body5" : "user: " + std::to_string(i);
+        CXS_ASSERT(results[i]->response->getBody() == expect);
+    }
+    log_stats("pipeline", pool);
+    CXS_ASSERT(pool->getStats().connects == 1);
+}
+
+// 响应体为chunked编码
+void test_chunked() {
+    auto pool = CXS::http::HttpConnectionPoolMgr::GetInstance()->get("127.0.0.1", PORT);
+    auto r = pool->doGet("/chunked", 1000);
+    CXS_ASSERT(r->result == 0);
+    CXS_ASSERT(r->response->getBody() == std::string(10000, 'c'));
+    CXS_ASSERT(pool == CXS::http::HttpConnectionPoolMgr::GetInstance()->get("127.0.0.1", PORT));
+}
+
+// 请求超时，超时的连接不放回连接池
+void test_timeout() {
+    CXS::http::HttpConnectionPool::ptr pool(
+        new CXS::http::HttpConnectionPool("127.0.0.1", PORT, 4, 10000, 60000, 100));
+    uint64_t begin = CXS::GetCurrentMS();
+    auto r = pool->doGet("/slow", 100);
+    uint64_t used = CXS::GetCurrentMS() - begin;
+    CXS_LOG_INFO(g_logger) << "timeout: " << r->toString() << " used=" << used << "ms";
+    CXS_ASSERT(r->result == (int)CXS::http::HttpResult::Error::TIMEOUT);
+    CXS_ASSERT(used >= 100 && used < 300);
+    CXS_ASSERT(pool->getStats().total == 0);
+    CXS_ASSERT(pool->doGet("/hello", 1000)->result == 0);
+}
+
+// 连接数达到上限时等待其他请求归还连接
+void test_wait() {
+    CXS::http::HttpConnectionPool::ptr pool(
+        new CXS::http::HttpConnectionPool("127.0.0.1", PORT, 2, 10000, 60000, 100));
+    std::shared_ptr<int> done(new int(0));
+    for (int i = 0; i < 6; ++i) {
+        CXS::IOManager::GetThis()->schedule([pool, done]() {
+            CXS_ASSERT(pool->doGet("/wait", 2000)->result == 0);
+            ++*done;
+        });
+    }
+    while (*done < 6) {
+        usleep(10 * 1000);
+    }
+    log_stats("wait", pool);
+    auto s = pool->getStats();
+    CXS_ASSERT(s.connects == 2 && s.waits == 4 && s.total == 2);
+    // 连接池已满时等待超时
+    std::shared_ptr<int> timeouts(new int(0));
+    for (int i = 0; i < 3; ++i) {
+        CXS::IOManager::GetThis()->schedule([pool, done, timeouts]() {
+            if (pool->doGet("/wait", 80)->result == (int)CXS::http::HttpResult::Error::TIMEOUT) {
+                ++*timeouts;
+            }
+            ++*done;
+        });
+    }
+    while (*done < 9) {
+        usleep(10 * 1000);
+    }
+    log_stats("wait timeout", pool);
+    CXS_ASSERT(*timeouts == 1);
+}
+
+void run() {
+    CXS::http::HttpServer::ptr server(new CXS::http::HttpServer(true));
+    CXS::Address::ptr addr = CXS::Address::LookupAny("127.0.0.1:" + std::to_string(PORT));
+    CXS_ASSERT(server->bind(addr));
+    // 连接池中保留的空闲连接由服务端超时关闭，测试结束后进程可以退出
+    server->setTimeout(2000);
+    auto sd = server->getServletDispatch();
+    sd->addServlet("/hello", [](CXS::http::HttpRequest::ptr req, CXS::http::HttpResponse::ptr rsp,
+                                CXS::http::HttpSession::ptr session) {
+        rsp->setBody("Hello, world!");
+        return 0;
+    });
+    sd->addGlobServlet("/user/*", [](CXS::http::HttpRequest::ptr req, CXS::http::HttpResponse::ptr rsp,
+                                     CXS::http::HttpSession::ptr session) {
+        rsp->setBody("user: " + req->getPath().substr(6));
+        return 0;
+    });
+    sd->addServlet("/echo", [](CXS::http::HttpRequest::ptr req, CXS::http::HttpResponse::ptr rsp,
+                               CXS::http::HttpSession::ptr session) {
+        rsp->setBody(req->getBody());
+        return 0;
+    });
+    sd->addServlet("/chunked", [](CXS::http::HttpRequest::ptr req, CXS::http::HttpResponse::ptr rsp,
+                                  CXS::http::HttpSession::ptr session) {
+        session->sendResponseHeader(rsp);
+        std::string data(1000, 'c');
+        for (int i = 0; i < 10; ++i) {
+            session->writeBody(data.c_str(), data.size());
+        }
+        return session->finishBody();
+    });
+    sd->addServlet("/conn", [](CXS::http::HttpRequest::ptr req, CXS::http::HttpResponse::ptr rsp,
+                               CXS::http::HttpSession::ptr session) {
+        rsp->setBody(req->isClose() ? "close" : "keep-alive");
+        return 0;
+    });
+    sd->addServlet("/slow", [](CXS::http::HttpRequest::ptr req, CXS::http::HttpResponse::ptr rsp,
+                               CXS::http::HttpSession::ptr session) {
+        usleep(500 * 1000);
+        rsp->setBody("slow");
+        return 0;
+    });
+    sd->addServlet("/wait", [](CXS::http::HttpRequest::ptr req, CXS::http::HttpResponse::ptr rsp,
+                               CXS::http::HttpSession::ptr session) {
+        usleep(50 * 1000);
+        rsp->setBody("wait");
+        return 0;
+    });
+    server->start();
+
+    test_reuse();
+    test_max_requests();
+    test_pipeline();
+    test_close();
+    test_chunked();
+    test_timeout();
+    test_wait();
+    CXS_LOG_INFO(g_logger) << "all passed";
+    server->stop();
+}
+
+int main(int argc, char **argv) {
+    g_logger->setLevel(CXS::LogLevel::INFO);
+    CXS::LoggerMgr::GetInstance()->getLogger("system")->setLevel(CXS::LogLevel::INFO);
+    CXS::IOManager iom(2);
+    iom.schedule(run);
+    return 0;
+}
@@ -0,0 +1,108 @@
+#include "../http/http_session.h"
+#include "../code/address.h"
+#include "../code/iomanager.h"
+#include "../code/log.h"
+#include "../code/macro.h"
+#include "../code/util.h"
+
+static CXS::Logger::ptr g_logger = CXS_LOG_ROOT();
+
+struct Case {
+    const char *name;
+    size_t body_size;
+    int count;
+};
+
+static const Case s_cases[] = {
+    {"1KB", 1024, 100000},
+    {"1MB", 1024 * 1024, 1000},
+};
+
+// 改造前的发送方式：整条响应先输出到stringstream，再拷贝成string发送
+int send_legacy(CXS::http::HttpSession::ptr session, CXS::http::HttpResponse::ptr rsp) {
+    std::stringstream ss;
+    ss << *rsp;
+    std::string data = ss.str();
+    return session->writeFixSize(data.c_str(), data.size());
+}
+
+void check_header() {
+    CXS::http::HttpResponse rsp(0x11, false);
+    rsp.setHeader("Content-Type", "text/plain");
+    rsp.setBody("hello");
+    std::string out;
+    rsp.serializeHeader(out);
+    CXS_ASSERT(out.compare(0, 17, "HTTP/1.1 200 OK\r\n") == 0);
+    CXS_ASSERT(out.find("date: ") != std::string::npos);
+    CXS_ASSERT(out.find("content-length: 5\r\n") != std::string::npos);
+    CXS_ASSERT(out.find("connection: keep-alive\r\n") != std::string::npos);
+    CXS_ASSERT(out.compare(out.size() - 4, 4, "\r\n\r\n") == 0);
+
+    rsp.setBody("");
+    rsp.setStatus(CXS::http::HttpStatus::NOT_FOUND);
+    out.clear();
+    rsp.serializeHeader(out);
+    CXS_ASSERT(out.compare(0, 24, "HTTP/1.1 404 Not Found\r\n") == 0);
+    CXS_ASSERT(out.find("content-length: 0\r\n") != std::string::npos);
+
+    rsp.setStatus(CXS::http::HttpStatus::NO_CONTENT);
+    out.clear();
+    rsp.serializeHeader(out);
+    CXS_ASSERT(out.find("content-length") == std::string::npos);
+}
+
+void run_server(CXS::Socket::ptr listener) {
+    CXS::Socket::ptr client = listener->accept();
+    CXS_ASSERT(client);
+    CXS::http::HttpSession::ptr session(new CXS::http::HttpSession(client));
+    for (auto &c : s_cases) {
+        CXS::http::HttpResponse::ptr rsp(new CXS::http::HttpResponse(0x11, false));
+        rsp->setHeader("Content-Type", "application/octet-stream");
+        rsp->setBody(std::string(c.body_size, 'x'));
+        for (int mode = 0; mode < 2; ++mode) {
+            uint64_t begin = CXS::GetCurrentUS();
+            for (int i = 0; i < c.count; ++i) {
+                int rt = mode == 0 ? send_legacy(session, rsp) : session->sendResponse(rsp);
+                CXS_ASSERT(rt > 0);
+            }
+            uint64_t used = CXS::GetCurrentUS() - begin;
+            CXS_LOG_INFO(g_logger) << c.name << (mode == 0 ? " stringstream: " : " writev: ")
+                                   << (used ? (uint64_t)c.count * 1000000 / used : 0) << " rsp/s "
+                                   << (used ? (uint64_t)c.count * c.body_size / used : 0) << " MB/s";
+        }
+    }
+    session->close();
+    listener->close();
+}
+
+void run_client(CXS::Address::ptr addr) {
+    CXS::Socket::ptr sock = CXS::Socket::CreateTCP(addr);
+    CXS_ASSERT(sock->connect(addr));
+    std::vector<char> buf(256 * 1024);
+    uint64_t total = 0;
+    while (true) {
+        int rt = sock->recv(&buf[0], buf.size());
+        if (rt <= 0) {
+            break;
+        }
+        total += rt;
+    }
+    CXS_LOG_INFO(g_logger) << "client received " << total << " bytes";
+}
+
+void run() {
+    CXS::Address::ptr addr = CXS::Address::LookupAny("127.0.0.1:8096");
+    CXS::Socket::ptr listener = CXS::Socket::CreateTCP(addr);
+    CXS_ASSERT(listener->bind(addr) && listener->listen());
+    CXS::IOManager::GetThis()->schedule(std::bind(run_server, listener));
+    CXS::IOManager::GetThis()->schedule(std::bind(run_client, addr));
+}
+
+int main(int argc, char **argv) {
+    g_logger->setLevel(CXS::LogLevel::INFO);
+    CXS::LoggerMgr::GetInstance()->getLogger("system")->setLevel(CXS::LogLevel::INFO);
+    check_header();
+    CXS::IOManager iom(2);
+    iom.schedule(run);
+    return 0;
+}
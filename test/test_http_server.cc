@@ -4,11 +4,38 @@
 static CXS::Logger::ptr g_logger = CXS_LOG_ROOT();
 
 void run() {
-    CXS::http::HttpServer::ptr server(new CXS::http::HttpServer);
+    CXS::http::HttpServer::ptr server(new CXS::http::HttpServer(true));
     CXS::Address::ptr addr = CXS::Address::LookupAny("0.0.0.0:8020");
     while (!server->bind(addr)) {
         sleep(2);
     }
+    auto sd = server->getServletDispatch();
+    sd->addServlet("/hello", [](CXS::http::HttpRequest::ptr req, CXS::http::HttpResponse::ptr rsp,
+                                CXS::http::HttpSession::ptr session) {
+        rsp->setBody("Hello, world!");
+        return 0;
+    });
+    sd->addGlobServlet("/user/*", [](CXS::http::HttpRequest::ptr req, CXS::http::HttpResponse::ptr rsp,
+                                     CXS::http::HttpSession::ptr session) {
+        rsp->setBody("user: " + req->getPath().substr(6));
+        return 0;
+    });
+    // 边读请求体边以chunked回写，内存占用与请求体大小无关
+    sd->addServlet("/upload", [](CXS::http::HttpRequest::ptr req, CXS::http::HttpResponse::ptr rsp,
+                                 CXS::http::HttpSession::ptr session) {
+        session->sendResponseHeader(rsp);
+        char buf[4096];
+        int rt = 0;
+        while ((rt = session->readBody(buf, sizeof(buf))) > 0) {
+            session->writeBody(buf, rt);
+        }
+        return session->finishBody();
+    });
+    sd->addPrefixServlet("/echo/", [](CXS::http::HttpRequest::ptr req, CXS::http::HttpResponse::ptr rsp,
+                                      CXS::http::HttpSession::ptr session) {
+        rsp->setBody(req->toString());
+        return 0;
+    });
     server->start();
 }
 int main(int argc, char *argv[]) {
@@ -0,0 +1,194 @@
+#include "../http/http_session.h"
+#include "../code/address.h"
+#include "../code/iomanager.h"
+#include "../code/log.h"
+#include "../code/macro.h"
+#include <unistd.h>
+
+static CXS::Logger::ptr g_logger = CXS_LOG_ROOT();
+
+// 统计read调用次数
+class CountingSession : public CXS::http::HttpSession {
+public:
+    typedef std::shared_ptr<CountingSession> ptr;
+    using CXS::http::HttpSession::HttpSession;
+    using CXS::http::HttpSession::read;
+    int read(void *buffer, size_t length) override {
+        ++reads;
+        return HttpSession::read(buffer, length);
+    }
+    int reads = 0;
+};
+
+static std::string make_request(const std::string &path, size_t cookie_size, const std::string &body = "") {
+    std::string req = "POST " + path + " HTTP/1.1\r\n"
+                      "Host: 127.0.0.1\r\n"
+                      "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko)\r\n"
+                      "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,*/*;q=0.8\r\n"
+                      "Cookie: session=" + std::string(cookie_size, 'c') + "\r\n"
+                      "Content-Length: " + std::to_string(body.size()) + "\r\n\r\n";
+    return req + body;
+}
+
+static void send_all(CXS::Socket::ptr sock, const std::string &data) {
+    size_t offset = 0;
+    while (offset < data.size()) {
+        int rt = sock->send(data.data() + offset, data.size() - offset);
+        CXS_ASSERT(rt > 0);
+        offset += rt;
+    }
+}
+
+void run_client(CXS::Address::ptr addr) {
+    CXS::Socket::ptr sock = CXS::Socket::CreateTCP(addr);
+    CXS_ASSERT(sock->connect(addr));
+    // 普通大小的请求，一次写完
+    send_all(sock, make_request("/a", 1500, "hello"));
+    usleep(20 * 1000);
+    // 请求头在"\r\n\r\n"中间被拆开
+    std::string req = make_request("/b", 100, "world");
+    size_t split = req.find("\r\n\r\n") + 2;
+    send_all(sock, req.substr(0, split));
+    usleep(20 * 1000);
+    send_all(sock, req.substr(split));
+    usleep(20 * 1000);
+    // 超过初始缓冲区的请求头和请求体
+    send_all(sock, make_request("/c", 10000, std::string(20000, 'b')));
+    usleep(20 * 1000);
+    // chunked请求体，块头带扩展，结尾带trailer，分多次发送
+    send_all(sock, "POST /d HTTP/1.1\r\nHost: 127.0.0.1\r\nTransfer-Encoding: chunked\r\n\r\n"
+                   "5;ext=1\r\nhello\r\n");
+    usleep(20 * 1000);
+    send_all(sock, "6\r\n wor");
+    usleep(20 * 1000);
+    send_all(sock, "ld\r\n1F40\r\n" + std::string(8000, 'x') + "\r\n0\r\nX-Trailer: 1\r\n\r\n");
+    // 读服务端的流式chunked响应
+    std::string rsp;
+    char buf[4096];
+    while (rsp.find("0\r\n\r\n") == std::string::npos) {
+        int rt = sock->recv(buf, sizeof(buf));
+        CXS_ASSERT(rt > 0);
+        rsp.append(buf, rt);
+    }
+    CXS_ASSERT(rsp.find("Transfer-Encoding: chunked\r\n") != std::string::npos);
+    CXS_ASSERT(rsp.find("\r\n\r\n6\r\nstream\r\n1388\r\n" + std::string(5000, 'y') + "\r\n0\r\n\r\n")
+               != std::string::npos);
+    // 流水线：三个请求一次发出
+    std::string pipeline;
+    for (int i = 1; i <= 3; ++i) {
+        pipeline += "GET /p" + std::to_string(i) + " HTTP/1.1\r\nHost: 127.0.0.1\r\n\r\n";
+    }
+    send_all(sock, pipeline);
+    rsp.clear();
+    while (rsp.find("p3") == std::string::npos) {
+        int rt = sock->recv(buf, sizeof(buf));
+        CXS_ASSERT(rt > 0);
+        rsp.append(buf, rt);
+    }
+    CXS_ASSERT(rsp.find("p1") < rsp.find("p2") && rsp.find("p2") < rsp.find("p3"));
+    // 流水线上的HEAD响应只有头部，响应体不能混进后面的GET响应
+    send_all(sock, "HEAD /h HTTP/1.1\r\nHost: 127.0.0.1\r\n\r\n"
+                   "GET /h HTTP/1.1\r\nHost: 127.0.0.1\r\n\r\n");
+    rsp.clear();
+    while (rsp.find("Hello, world!") == std::string::npos) {
+        int rt = sock->recv(buf, sizeof(buf));
+        CXS_ASSERT(rt > 0);
+        rsp.append(buf, rt);
+    }
+    size_t second = rsp.find("HTTP/1.1", 1);
+    CXS_ASSERT(rsp.find("HTTP/1.1") == 0 && second != std::string::npos);
+    CXS_ASSERT(rsp.find("content-length: 13\r\n\r\n") < second);
+    CXS_ASSERT(rsp.find("\r\n\r\n") + 4 == second);
+    CXS_ASSERT(rsp.find("Hello, world!") > second);
+    sock->close();
+}
+
+void run_server(CXS::Socket::ptr listener) {
+    CXS::Socket::ptr client = listener->accept();
+    CXS_ASSERT(client);
+    CountingSession::ptr session(new CountingSession(client));
+
+    auto req = session->recvRequest();
+    CXS_ASSERT(req && req->getPath() == "/a" && req->getBody() == "hello");
+    CXS_LOG_INFO(g_logger) << "request /a reads=" << session->reads;
+    CXS_ASSERT(session->reads == 1);
+
+    session->reads = 0;
+    req = session->recvRequest();
+    CXS_ASSERT(req && req->getPath() == "/b" && req->getBody() == "world");
+    CXS_LOG_INFO(g_logger) << "request /b reads=" << session->reads;
+
+    session->reads = 0;
+    req = session->recvRequest();
+    CXS_ASSERT(req && req->getPath() == "/c" && req->getBody() == std::string(20000, 'b'));
+    CXS_ASSERT(req->getHeaders("cookie").size() == 10000 + 8);
+    CXS_LOG_INFO(g_logger) << "request /c reads=" << session->reads;
+
+    // 流式读取chunked请求体，每次最多读100字节
+    session->reads = 0;
+    req = session->recvRequestHeader();
+    CXS_ASSERT(req && req->getPath() == "/d" && session->isChunkedBody());
+    std::string body;
+    char buf[100];
+    int rt = 0;
+    while ((rt = session->readBody(buf, sizeof(buf))) > 0) {
+        body.append(buf, rt);
+    }
+    CXS_ASSERT(rt == 0 && body == "hello world" + std::string(8000, 'x'));
+    CXS_LOG_INFO(g_logger) << "request /d chunked reads=" << session->reads;
+
+    CXS::http::HttpResponse::ptr rsp(new CXS::http::HttpResponse(0x11, false));
+    CXS_ASSERT(session->sendResponseHeader(rsp) > 0);
+    CXS_ASSERT(session->writeBody("stream", 6) > 0);
+    std::string big(5000, 'y');
+    CXS_ASSERT(session->writeBody(big.data(), big.size()) > 0);
+    CXS_ASSERT(session->finishBody() > 0);
+
+    // 一次读到的三个请求依次解析，响应合并发送
+    session->reads = 0;
+    for (int i = 1; i <= 3; ++i) {
+        req = session->recvRequest();
+        CXS_ASSERT(req && req->getPath() == "/p" + std::to_string(i));
+        rsp.reset(new CXS::http::HttpResponse(0x11, false));
+        rsp->setBody("p" + std::to_string(i));
+        if (session->hasBufferedInput()) {
+            session->queueResponse(rsp);
+        } else {
+            session->sendResponse(rsp);
+        }
+    }
+    CXS_LOG_INFO(g_logger) << "pipelined requests reads=" << session->reads;
+    CXS_ASSERT(session->reads == 1);
+
+    for (int i = 0; i < 2; ++i) {
+        req = session->recvRequest();
+        CXS_ASSERT(req && req->getPath() == "/h");
+        rsp.reset(new CXS::http::HttpResponse(0x11, false));
+        rsp->setBody("Hello, world!");
+        if (session->hasBufferedInput()) {
+            session->queueResponse(rsp);
+        } else {
+            session->sendResponse(rsp);
+        }
+    }
+
+    CXS_ASSERT(session->recvRequest() == nullptr);
+    listener->close();
+}
+
+// socket需要在hook生效的线程中创建，才会走协程化的accept/read
+void run() {
+    CXS::Address::ptr addr = CXS::Address::LookupAny("127.0.0.1:8095");
+    CXS::Socket::ptr listener = CXS::Socket::CreateTCP(addr);
+    CXS_ASSERT(listener->bind(addr) && listener->listen());
+    CXS::IOManager::GetThis()->schedule(std::bind(run_server, listener));
+    CXS::IOManager::GetThis()->schedule(std::bind(run_client, addr));
+}
+
+int main(int argc, char **argv) {
+    g_logger->setLevel(CXS::LogLevel::INFO);
+    CXS::LoggerMgr::GetInstance()->getLogger("system")->setLevel(CXS::LogLevel::INFO);
+    CXS::IOManager iom(1);
+    iom.schedule(run);
+    return 0;
+}
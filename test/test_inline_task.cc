@@ -0,0 +1,77 @@
+#include "../code/fiber_sync.h"
+#include "../code/iomanager.h"
+#include "../code/log.h"
+#include "../code/macro.h"
+#include "../code/util.h"
+#include <fcntl.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// 普通回调任务与scheduleInline任务的吞吐(tasks/sec)对比，以及inline回调中让出会被调试检查拦截
+// 用法: test_inline_task [任务数] [线程数]
+
+static CXS::Logger::ptr g_logger = CXS_LOG_ROOT();
+
+static std::atomic<uint64_t> s_sum = {0};
+
+double bench(size_t tasks, size_t threads, bool run_inline) {
+    uint64_t used = 0;
+    {
+        CXS::IOManager iom(threads, false, run_inline ? "inline" : "fiber");
+        iom.schedule([&]() {
+            CXS::WaitGroup wg;
+            wg.add(tasks);
+            uint64_t begin = CXS::GetCurrentUS();
+            for (size_t i = 0; i < tasks; ++i) {
+                auto cb = [&wg, i]() {
+                    s_sum += i;
+                    wg.done();
+                };
+                if (run_inline) {
+                    iom.scheduleInline(cb);
+                } else {
+                    iom.schedule(cb);
+                }
+            }
+            wg.wait();
+            used = CXS::GetCurrentUS() - begin;
+        });
+    }
+    return tasks * 1000000.0 / (used + 1);
+}
+
+// 子进程中inline回调让出，应被断言终止
+bool yield_is_caught() {
+    pid_t pid = fork();
+    if (pid == 0) {
+        int fd = open("/dev/null", O_WRONLY);
+        dup2(fd, STDOUT_FILENO);
+        dup2(fd, STDERR_FILENO);
+        CXS::IOManager iom(1, false, "yield");
+        iom.scheduleInline([]() { CXS::Fiber::YieldToReady(); });
+        sleep(5);
+        _exit(0);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+    return WIFSIGNALED(status) && WTERMSIG(status) == SIGABRT;
+}
+
+int main(int argc, char **argv) {
+    CXS::LoggerMgr::GetInstance()->getLogger("system")->setLevel(CXS::LogLevel::ERROR);
+    size_t tasks = argc > 1 ? atoi(argv[1]) : 1000000;
+    size_t threads = argc > 2 ? atoi(argv[2]) : 1;
+
+    CXS_ASSERT(yield_is_caught());
+
+    double fiber = bench(tasks, threads, false);
+    double inline_run = bench(tasks, threads, true);
+    CXS_ASSERT(s_sum == (uint64_t)tasks * (tasks - 1));
+    CXS_LOG_INFO(g_logger) << "tasks=" << tasks << " threads=" << threads
+                           << " fiber=" << (uint64_t)fiber << " tasks/s"
+                           << " inline=" << (uint64_t)inline_run << " tasks/s"
+                           << " speedup=" << inline_run / fiber;
+    return 0;
+}
@@ -0,0 +1,73 @@
+#include "../code/log.h"
+#include "../code/config.hpp"
+#include "../code/iomanager.h"
+#include "../code/socket.h"
+#include "../code/address.h"
+#include "../code/util.h"
+
+CXS::Logger::ptr g_logger = CXS_LOG_ROOT();
+
+static const int ROUNDS = 20000;
+static const uint16_t PORT = 8093;
+
+// 回显服务端: 只接受一个连接
+void echo_server(CXS::Socket::ptr listener) {
+    CXS::Socket::ptr client = listener->accept();
+    CXS_ASSERT(client);
+    char buf[64];
+    while (true) {
+        int rt = client->recv(buf, sizeof(buf));
+        if (rt <= 0) {
+            break;
+        }
+        client->send(buf, rt);
+    }
+    client->close();
+    listener->close();
+}
+
+// 客户端: ping-pong ROUNDS次，然后测试接收超时
+void echo_client() {
+    CXS::Socket::ptr sock = CXS::Socket::CreateTCPSocket();
+    CXS_ASSERT(sock->connect(CXS::IPv4Address::Create("127.0.0.1", PORT)));
+
+    char buf[64] = "ping";
+    uint64_t begin = CXS::GetCurrentUS();
+    for (int i = 0; i < ROUNDS; ++i) {
+        CXS_ASSERT(sock->send(buf, sizeof(buf)) == sizeof(buf));
+        int len = 0;
+        while (len < (int)sizeof(buf)) {
+            int rt = sock->recv(buf + len, sizeof(buf) - len);
+            CXS_ASSERT(rt > 0);
+            len += rt;
+        }
+    }
+    uint64_t used = CXS::GetCurrentUS() - begin;
+    CXS_LOG_INFO(g_logger) << "backend=" << (CXS::IOManager::GetThis()->hasUring() ? "io_uring" : "epoll")
+                           << " rounds=" << ROUNDS << " used=" << used << "us"
+                           << " us/round=" << (double)used / ROUNDS;
+
+    // 服务端不再回包，接收应超时
+    sock->setRecvTimeOut(100);
+    begin = CXS::GetCurrentMS();
+    int rt = sock->recv(buf, sizeof(buf));
+    int error = errno;
+    CXS_LOG_INFO(g_logger) << "recv timeout rt=" << rt << " errno=" << error
+                           << " used=" << (CXS::GetCurrentMS() - begin) << "ms";
+    CXS_ASSERT(rt == -1 && error == ETIMEDOUT);
+    sock->close();
+}
+
+int main(int argc, char const *argv[]) {
+    CXS::LoggerMgr::GetInstance()->getLogger("system")->setLevel(CXS::LogLevel::INFO);
+    std::string backend = argc > 1 ? argv[1] : "io_uring";
+    CXS::Config::Lookup<std::string>("iomanager.backend")->setValue(backend);
+
+    CXS::IOManager iom(2, false, "uring");
+    CXS::Socket::ptr listener = CXS::Socket::CreateTCPSocket();
+    CXS_ASSERT(listener->bind(CXS::IPv4Address::Create("127.0.0.1", PORT)));
+    CXS_ASSERT(listener->listen());
+    iom.schedule(std::bind(echo_server, listener));
+    iom.schedule(echo_client);
+    return 0;
+}
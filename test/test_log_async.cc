@@ -0,0 +1,98 @@
+#include "../code/log.h"
+#include "../code/config.hpp"
+#include "../code/macro.h"
+#include "../code/thread.h"
+#include "../code/util.h"
+#include <fstream>
+#include <unistd.h>
+
+CXS::Logger::ptr g_logger = CXS_LOG_ROOT();
+
+static const int THREADS = 4;
+static const int COUNT = 50000;
+
+size_t count_lines(const std::string &file) {
+    std::ifstream ifs(file);
+    std::string line;
+    size_t n = 0;
+    while (std::getline(ifs, line)) {
+        ++n;
+    }
+    return n;
+}
+
+// 多线程写同一个logger，返回耗时(ms)
+uint64_t run_threads(CXS::Logger::ptr logger) {
+    uint64_t begin = CXS::GetCurrentMS();
+    std::vector<CXS::Thread::ptr> thrs;
+    for (int i = 0; i < THREADS; ++i) {
+        thrs.push_back(CXS::Thread::ptr(new CXS::Thread([logger]() {
+            for (int j = 0; j < COUNT; ++j) {
+                CXS_LOG_INFO(logger) << "async log test j=" << j;
+            }
+        }, "log_" + std::to_string(i))));
+    }
+    for (auto &i : thrs) {
+        i->join();
+    }
+    return CXS::GetCurrentMS() - begin;
+}
+
+void test_sync() {
+    std::string file = "/tmp/cxs_log_sync.txt";
+    unlink(file.c_str());
+    CXS::Logger::ptr logger = CXS_LOG_NAME("sync");
+    logger->addAppender(CXS::LogAppender::ptr(new CXS::FileLogAppender(file)));
+    uint64_t used = run_threads(logger);
+    logger->clearAppenders();
+    CXS_LOG_INFO(g_logger) << "FileLogAppender used=" << used << "ms lines=" << count_lines(file);
+}
+
+void test_async(CXS::AsyncLogAppender::OverflowPolicy policy) {
+    std::string name = CXS::AsyncLogAppender::PolicyToString(policy);
+    std::string file = "/tmp/cxs_log_async_" + name + ".txt";
+    unlink(file.c_str());
+    CXS::Logger::ptr logger = CXS_LOG_NAME("async_" + name);
+    CXS::AsyncLogAppender::ptr appender(new CXS::AsyncLogAppender(file, 1024, policy));
+    logger->addAppender(appender);
+    uint64_t used = run_threads(logger);
+    appender->flush();
+    CXS::AsyncLogAppender::Stats stats = appender->getStats();
+    size_t lines = count_lines(file);
+    CXS_ASSERT(stats.written == lines);
+    CXS_ASSERT(stats.written + stats.dropped == (uint64_t)THREADS * COUNT);
+    if (policy == CXS::AsyncLogAppender::OverflowPolicy::BLOCK) {
+        CXS_ASSERT(stats.dropped == 0);
+    }
+    logger->clearAppenders();
+    CXS_LOG_INFO(g_logger) << "AsyncLogAppender(" << name << ") used=" << used << "ms"
+                           << " written=" << stats.written
+                           << " dropped=" << stats.dropped
+                           << " blocked=" << stats.blocked;
+}
+
+void test_yaml() {
+    YAML::Node root = YAML::Load(
+        "logs:\n"
+        "  - name: async_yaml\n"
+        "    level: info\n"
+        "    appenders:\n"
+        "      - type: AsyncLogAppender\n"
+        "        file: /tmp/cxs_log_async_yaml.txt\n"
+        "        overflow: sample\n"
+        "        buffer_size: 4096\n"
+        "        sample_rate: 5\n");
+    CXS::Config::LoadFromYaml(root);
+    CXS::Logger::ptr logger = CXS_LOG_NAME("async_yaml");
+    CXS_LOG_INFO(logger) << "hello async yaml";
+    CXS_LOG_INFO(g_logger) << "\n" << logger->toYamlString();
+}
+
+int main(int argc, char const *argv[]) {
+    test_sync();
+    test_async(CXS::AsyncLogAppender::OverflowPolicy::BLOCK);
+    test_async(CXS::AsyncLogAppender::OverflowPolicy::DROP);
+    test_async(CXS::AsyncLogAppender::OverflowPolicy::SAMPLE);
+    test_yaml();
+    return 0;
+}
@@ -0,0 +1,120 @@
+#include "../code/log.h"
+#include "../code/thread.h"
+#include "../code/util.h"
+#include <atomic>
+#include <new>
+#include <stdlib.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// 统计堆分配次数
+static std::atomic<uint64_t> s_alloc_count(0);
+
+// 不内联，避免编译器把new/free当作不匹配的分配释放
+__attribute__((noinline)) static void raw_free(void *p) {
+    free(p);
+}
+
+void *operator new(size_t size) {
+    ++s_alloc_count;
+    void *p = malloc(size ? size : 1);
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void *p) noexcept {
+    raw_free(p);
+}
+
+static const int COUNT = 200000;
+
+CXS::Logger::ptr g_logger = CXS_LOG_ROOT();
+
+void report(const char *name, uint64_t begin_us, uint64_t begin_alloc, int count) {
+    uint64_t used = CXS::GetCurrentUS() - begin_us;
+    uint64_t allocs = s_alloc_count - begin_alloc;
+    CXS_LOG_INFO(g_logger) << name << ": " << used * 1000 / count << "ns/log "
+                           << (used ? (uint64_t)count * 1000000 / used : 0) << " logs/s "
+                           << (double)allocs / count << " allocs/log";
+}
+
+// 改造前每条日志的格式化开销：stringstream + gettid + localtime_r/strftime
+void bench_legacy_format(CXS::Logger::ptr logger) {
+    uint64_t begin = CXS::GetCurrentUS();
+    uint64_t alloc = s_alloc_count;
+    size_t total = 0;
+    for (int i = 0; i < COUNT; ++i) {
+        std::stringstream content;
+        content << "bench log i=" << i;
+        std::stringstream ss;
+        struct tm tm;
+        time_t now = time(0);
+        localtime_r(&now, &tm);
+        char buf[64];
+        strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &tm);
+        ss << buf << '\t' << syscall(SYS_gettid) << '\t' << CXS::Thread::GetName()
+           << '\t' << 0 << "\t[INFO]\t[" << logger->getName() << "]\t"
+           << __FILE__ << ':' << __LINE__ << '\t' << content.str() << std::endl;
+        total += ss.str().size();
+    }
+    report("legacy format", begin, alloc, COUNT);
+}
+
+// 当前的格式化路径，不输出
+void bench_format(CXS::Logger::ptr logger) {
+    CXS::LogFormatter::ptr formatter = logger->getFormatter();
+    std::string buf;
+    uint64_t begin = CXS::GetCurrentUS();
+    uint64_t alloc = s_alloc_count;
+    for (int i = 0; i < COUNT; ++i) {
+        CXS::LogEvent::ptr event = CXS::LogEvent::Create(__FILE__, __LINE__, 0, CXS::GetThreadId(), CXS::GetFiberId(),
+                                                         time(0), logger, CXS::LogLevel::INFO, CXS::Thread::GetName());
+        event->getStringStream() << "bench log i=" << i;
+        buf.clear();
+        formatter->format(buf, logger, CXS::LogLevel::INFO, event);
+        CXS::LogEvent::Recycle(event);
+    }
+    report("format", begin, alloc, COUNT);
+}
+
+// 完整的CXS_LOG_INFO调用，appender输出到/dev/null
+void bench_appender(const char *name, CXS::LogAppender::ptr appender) {
+    CXS::Logger::ptr logger = CXS_LOG_NAME(std::string("bench_") + name);
+    logger->addAppender(appender);
+    uint64_t begin = CXS::GetCurrentUS();
+    uint64_t alloc = s_alloc_count;
+    for (int i = 0; i < COUNT; ++i) {
+        CXS_LOG_INFO(logger) << "bench log i=" << i;
+    }
+    CXS::AsyncLogAppender::ptr async = std::dynamic_pointer_cast<CXS::AsyncLogAppender>(appender);
+    if (async) {
+        async->flush();
+    }
+    report(name, begin, alloc, COUNT);
+    logger->clearAppenders();
+}
+
+// 级别过滤掉的日志
+void bench_filtered() {
+    CXS::Logger::ptr logger = CXS_LOG_NAME("bench_filtered");
+    logger->setLevel(CXS::LogLevel::ERROR);
+    uint64_t begin = CXS::GetCurrentUS();
+    uint64_t alloc = s_alloc_count;
+    for (int i = 0; i < COUNT; ++i) {
+        CXS_LOG_DEBUG(logger) << "bench log i=" << i;
+    }
+    report("filtered", begin, alloc, COUNT);
+}
+
+int main(int argc, char const *argv[]) {
+    g_logger->setLevel(CXS::LogLevel::INFO);
+    CXS::Logger::ptr logger = CXS_LOG_NAME("bench");
+    bench_legacy_format(logger);
+    bench_format(logger);
+    bench_appender("file", CXS::LogAppender::ptr(new CXS::FileLogAppender("/dev/null")));
+    bench_appender("async", CXS::LogAppender::ptr(new CXS::AsyncLogAppender("/dev/null")));
+    bench_filtered();
+    return 0;
+}
@@ -0,0 +1,145 @@
+#include "../code/config.hpp"
+#include "../code/iomanager.h"
+#include "../code/log.h"
+#include "../code/macro.h"
+#include "../code/parallel.h"
+#include "../code/util.h"
+#include <atomic>
+#include <math.h>
+#include <random>
+#include <stdexcept>
+#include <stdlib.h>
+#include <vector>
+
+// parallel_for/parallel_reduce/parallel_sort的正确性，以及与单线程的耗时对比
+// 用法: test_parallel [线程数] [元素数]
+
+static CXS::Logger::ptr g_logger = CXS_LOG_ROOT();
+
+static double work(size_t i) {
+    double v = (double)i;
+    for (int k = 0; k < 20; ++k) {
+        v = sqrt(v + k) * 1.0001;
+    }
+    return v;
+}
+
+template <class F>
+static uint64_t timeit(F f) {
+    uint64_t begin = CXS::GetCurrentUS();
+    f();
+    return CXS::GetCurrentUS() - begin;
+}
+
+void bench(size_t threads, size_t n) {
+    std::vector<double> serial_out(n);
+    std::vector<double> parallel_out(n);
+    std::vector<uint32_t> data(n);
+    std::mt19937 rng(12345);
+    for (auto &i : data) {
+        i = rng();
+    }
+    std::vector<uint32_t> serial_sorted = data;
+    std::vector<uint32_t> parallel_sorted = data;
+
+    uint64_t for_serial = timeit([&]() {
+        for (size_t i = 0; i < n; ++i) {
+            serial_out[i] = work(i);
+        }
+    });
+    double sum_serial = 0;
+    uint64_t reduce_serial = timeit([&]() {
+        double sum = 0;
+        for (size_t i = 0; i < n; ++i) {
+            sum += (double)data[i];
+        }
+        sum_serial = sum;
+    });
+    uint64_t sort_serial = timeit([&]() { std::sort(serial_sorted.begin(), serial_sorted.end()); });
+
+    uint64_t for_parallel = 0;
+    uint64_t reduce_parallel = 0;
+    uint64_t sort_parallel = 0;
+    double sum_parallel = 0;
+    {
+        CXS::IOManager iom(threads, false, "parallel");
+        iom.schedule([&]() {
+            for_parallel = timeit([&]() {
+                CXS::parallel_for(&iom, 0, n, [&](size_t i) { parallel_out[i] = work(i); }, 1024);
+            });
+            reduce_parallel = timeit([&]() {
+                sum_parallel = CXS::parallel_reduce(
+                    &iom, 0, n, 0.0, [&](size_t i) { return (double)data[i]; },
+                    [](double a, double b) { return a + b; }, 4096);
+            });
+            sort_parallel = timeit([&]() { CXS::parallel_sort(&iom, parallel_sorted.begin(), parallel_sorted.end()); });
+        });
+    }
+    CXS_ASSERT(serial_out == parallel_out);
+    CXS_ASSERT(fabs(sum_serial - sum_parallel) <= fabs(sum_serial) * 1e-9);
+    CXS_ASSERT(serial_sorted == parallel_sorted);
+    CXS_LOG_INFO(g_logger) << "threads=" << threads << " n=" << n;
+    CXS_LOG_INFO(g_logger) << "parallel_for    serial=" << for_serial << "us parallel=" << for_parallel
+                           << "us speedup=" << (double)for_serial / (for_parallel + 1);
+    CXS_LOG_INFO(g_logger) << "parallel_reduce serial=" << reduce_serial << "us parallel=" << reduce_parallel
+                           << "us speedup=" << (double)reduce_serial / (reduce_parallel + 1);
+    CXS_LOG_INFO(g_logger) << "parallel_sort   serial=" << sort_serial << "us parallel=" << sort_parallel
+                           << "us speedup=" << (double)sort_serial / (sort_parallel + 1);
+}
+
+// 单线程IOManager上长时间的parallel_for不独占工作线程，打开忙时轮询后期间定时器照常触发
+void test_cooperate() {
+    CXS::Config::Lookup<uint32_t>("iomanager.busy_poll.tasks")->setValue(64);
+    CXS::Config::Lookup<uint64_t>("iomanager.busy_poll.us")->setValue(500);
+    uint64_t begin = 0;
+    uint64_t timer_at = 0;
+    uint64_t loop_us = 0;
+    {
+        CXS::IOManager iom(1, false, "coop");
+        iom.schedule([&]() {
+            begin = CXS::GetCurrentUS();
+            iom.addTimer(5, [&]() { timer_at = CXS::GetCurrentUS() - begin; });
+            CXS::parallel_for(&iom, 0, 2000, [](size_t i) {
+                uint64_t b = CXS::GetCurrentUS();
+                while (CXS::GetCurrentUS() - b < 50) {
+                }
+            });
+            loop_us = CXS::GetCurrentUS() - begin;
+        });
+    }
+    CXS_ASSERT(timer_at > 0 && timer_at < loop_us / 2);
+    CXS_LOG_INFO(g_logger) << "cooperate loop=" << loop_us << "us timer fired at " << timer_at << "us";
+}
+
+// f抛出异常时等所有参与者返回后再抛给调用方，不论抛出的是调用方自己还是被窃取的参与者
+void test_exception(size_t threads) {
+    CXS::IOManager iom(threads, false, "except");
+    for (size_t bad : {(size_t)0, (size_t)999}) {
+        iom.schedule([&iom, bad]() {
+            std::atomic<size_t> done(0);
+            bool caught = false;
+            try {
+                CXS::parallel_for(&iom, 0, 1000, [&](size_t i) {
+                    if (i == bad) {
+                        throw std::runtime_error("bad index");
+                    }
+                    ++done;
+                });
+            } catch (std::runtime_error &e) {
+                caught = true;
+            }
+            CXS_ASSERT(caught && done < 1000);
+            CXS_LOG_INFO(g_logger) << "exception at " << bad << " done=" << done;
+        });
+    }
+}
+
+int main(int argc, char **argv) {
+    CXS::LoggerMgr::GetInstance()->getLogger("system")->setLevel(CXS::LogLevel::ERROR);
+    size_t threads = argc > 1 ? atoi(argv[1]) : 4;
+    size_t n = argc > 2 ? atoi(argv[2]) : (1 << 21);
+    test_cooperate();
+    test_exception(threads);
+    bench(threads, n);
+    return 0;
+}
@@ -16,12 +16,35 @@ void test_fiber() {
     }
 }
 
+static std::atomic<int> s_tasks = {0};
+void spawn(int depth) {
+    ++s_tasks;
+    if (depth <= 0) {
+        return;
+    }
+    // 在工作线程内调度，任务进入本地队列，空闲线程窃取
+    CXS::Scheduler::GetThis()->schedule(std::bind(&spawn, depth - 1));
+    CXS::Scheduler::GetThis()->schedule(std::bind(&spawn, depth - 1));
+}
+
+void test_steal() {
+    CXS::Scheduler sc(4, false, "steal");
+    sc.start();
+    sc.schedule(std::bind(&spawn, 14));
+    sc.stop();
+    CXS::Scheduler::QueueStats stats = sc.getQueueStats();
+    CXS_LOG_INFO(g_logger) << "tasks=" << s_tasks << " steals=" << stats.steals
+                           << " steal_misses=" << stats.steal_misses
+                           << " global_depth=" << stats.global_depth;
+}
+
 int main(int argc, char const *argv[]) {
     CXS_LOG_INFO(g_logger) << "main";
     CXS::Scheduler sc(2, false, "work");
     sc.start();
     sc.schedule(&test_fiber);
     sc.stop();
+    test_steal();
     CXS_LOG_INFO(g_logger) << "over";
     return 0;
 }
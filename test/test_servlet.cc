@@ -0,0 +1,180 @@
+#include "../http/servlet.h"
+#include "../code/log.h"
+#include "../code/macro.h"
+#include "../code/thread.h"
+#include "../code/util.h"
+#include <atomic>
+#include <new>
+#include <stdlib.h>
+
+// 统计堆分配次数
+static std::atomic<uint64_t> s_alloc_count(0);
+
+__attribute__((noinline)) static void raw_free(void *p) {
+    free(p);
+}
+
+void *operator new(size_t size) {
+    ++s_alloc_count;
+    void *p = malloc(size ? size : 1);
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void *p) noexcept {
+    raw_free(p);
+}
+
+static CXS::Logger::ptr g_logger = CXS_LOG_ROOT();
+
+using CXS::http::Servlet;
+using CXS::http::ServletDispatch;
+
+class NamedServlet : public Servlet {
+public:
+    NamedServlet(const std::string &name) :
+        Servlet(name) {}
+    int32_t handle(CXS::http::HttpRequest::ptr request,
+                   CXS::http::HttpResponse::ptr response,
+                   CXS::http::HttpSession::ptr session) override {
+        return 0;
+    }
+};
+
+static Servlet::ptr make(const std::string &name) {
+    return Servlet::ptr(new NamedServlet(name));
+}
+
+static std::string matched(ServletDispatch::ptr sd, const std::string &uri) {
+    return sd->getMatchedServlet(uri)->getName();
+}
+
+void test_match() {
+    ServletDispatch::ptr sd(new ServletDispatch);
+    sd->addServlet("/user/admin/info", make("exact_admin"));
+    sd->addServlet("/user", make("exact_user"));
+    CXS_ASSERT(sd->addGlobServlet("/user/*/info", make("glob_info")));
+    CXS_ASSERT(sd->addGlobServlet("/user/*", make("glob_user")));
+    CXS_ASSERT(sd->addGlobServlet("/file/*/*", make("glob_file")));
+    CXS_ASSERT(!sd->addGlobServlet("/bad/*.html", make("bad")));
+    sd->addPrefixServlet("/static/", make("prefix_static"));
+    sd->addPrefixServlet("/static/img/", make("prefix_img"));
+    sd->addPrefixServlet("/user/", make("prefix_user"));
+    CXS_ASSERT(sd->size() == 8);
+
+    CXS_ASSERT(matched(sd, "/user/admin/info") == "exact_admin");
+    CXS_ASSERT(matched(sd, "/user") == "exact_user");
+    CXS_ASSERT(matched(sd, "/user/bob/info") == "glob_info");
+    CXS_ASSERT(matched(sd, "/user/bob") == "glob_user");
+    CXS_ASSERT(matched(sd, "/user/admin") == "glob_user");
+    CXS_ASSERT(matched(sd, "/user/bob/other") == "prefix_user");
+    CXS_ASSERT(matched(sd, "/file/a/b") == "glob_file");
+    CXS_ASSERT(matched(sd, "/file/a") == "NotFoundServlet");
+    CXS_ASSERT(matched(sd, "/static/index.html") == "prefix_static");
+    CXS_ASSERT(matched(sd, "/static/img/a.png") == "prefix_img");
+    CXS_ASSERT(matched(sd, "/static") == "NotFoundServlet");
+    CXS_ASSERT(matched(sd, "/") == "NotFoundServlet");
+    CXS_ASSERT(matched(sd, "") == "NotFoundServlet");
+
+    CXS_ASSERT(sd->getServlet("/user")->getName() == "exact_user");
+    CXS_ASSERT(sd->getGlobServlet("/user/*")->getName() == "glob_user");
+    CXS_ASSERT(sd->getPrefixServlet("/static/")->getName() == "prefix_static");
+    CXS_ASSERT(!sd->getServlet("/user/*"));
+    CXS_ASSERT(!sd->getServlet("/us"));
+
+    sd->delServlet("/user/admin/info");
+    CXS_ASSERT(matched(sd, "/user/admin/info") == "glob_info");
+    sd->delGlobServlet("/user/*/info");
+    CXS_ASSERT(matched(sd, "/user/admin/info") == "prefix_user");
+    sd->delPrefixServlet("/static/img/");
+    CXS_ASSERT(matched(sd, "/static/img/a.png") == "prefix_static");
+    sd->delServlet("/not/exists");
+    CXS_ASSERT(sd->size() == 5);
+
+    sd->setDefault(make("default"));
+    CXS_ASSERT(matched(sd, "/nothing") == "default");
+    CXS_LOG_INFO(g_logger) << "test_match ok";
+}
+
+static const int ROUTES = 10000;
+static const int LOOKUPS = 1000000;
+
+static std::string route(int i) {
+    return "/api/v" + std::to_string(i % 10) + "/service" + std::to_string(i / 10) + "/method";
+}
+
+void bench_lookup() {
+    ServletDispatch::ptr sd(new ServletDispatch);
+    Servlet::ptr slt = make("bench");
+    uint64_t begin = CXS::GetCurrentUS();
+    for (int i = 0; i < ROUTES; ++i) {
+        sd->addServlet(route(i), slt);
+    }
+    sd->addPrefixServlet("/api/", slt);
+    uint64_t used = CXS::GetCurrentUS() - begin;
+    CXS_LOG_INFO(g_logger) << "register " << ROUTES << " routes used=" << used << "us "
+                           << used * 1000 / ROUTES << "ns/route";
+
+    std::vector<std::string> paths;
+    for (int i = 0; i < 1024; ++i) {
+        paths.push_back(route((i * 7919) % ROUTES));
+    }
+    paths.push_back("/api/v1/unknown");
+    uint64_t alloc = s_alloc_count;
+    begin = CXS::GetCurrentUS();
+    size_t hit = 0;
+    for (int i = 0; i < LOOKUPS; ++i) {
+        hit += sd->getMatchedServlet(paths[i % paths.size()]) == slt;
+    }
+    used = CXS::GetCurrentUS() - begin;
+    uint64_t allocs = s_alloc_count - alloc;
+    CXS_ASSERT(hit == (size_t)LOOKUPS);
+    CXS_ASSERT(allocs == 0);
+    CXS_LOG_INFO(g_logger) << "lookup " << ROUTES << " routes: " << used * 1000 / LOOKUPS << "ns/lookup "
+                           << (double)allocs / LOOKUPS << " allocs/lookup";
+}
+
+// 读者持续查找的同时注册和删除路由
+void test_concurrent() {
+    ServletDispatch::ptr sd(new ServletDispatch);
+    Servlet::ptr fixed = make("fixed");
+    sd->addServlet("/fixed", fixed);
+    std::atomic<bool> stop(false);
+    std::atomic<uint64_t> lookups(0);
+    std::vector<CXS::Thread::ptr> thrs;
+    for (int i = 0; i < 3; ++i) {
+        thrs.push_back(CXS::Thread::ptr(new CXS::Thread([&]() {
+            uint64_t n = 0;
+            while (!stop) {
+                CXS_ASSERT(sd->getMatchedServlet("/fixed") == fixed);
+                sd->getMatchedServlet(route(n % 1000));
+                ++n;
+            }
+            lookups += n;
+        }, "reader_" + std::to_string(i))));
+    }
+    for (int round = 0; round < 5; ++round) {
+        for (int i = 0; i < 1000; ++i) {
+            sd->addServlet(route(i), make("r"));
+        }
+        for (int i = 0; i < 1000; ++i) {
+            sd->delServlet(route(i));
+        }
+    }
+    stop = true;
+    for (auto &i : thrs) {
+        i->join();
+    }
+    CXS_ASSERT(sd->size() == 1);
+    CXS_LOG_INFO(g_logger) << "test_concurrent ok lookups=" << lookups;
+}
+
+int main(int argc, char **argv) {
+    g_logger->setLevel(CXS::LogLevel::INFO);
+    test_match();
+    bench_lookup();
+    test_concurrent();
+    return 0;
+}
@@ -0,0 +1,53 @@
+#include "../code/log.h"
+#include "../code/fiber.hpp"
+#include "../code/scheduler.hpp"
+#include "../code/stack_allocator.h"
+#include "../code/util.h"
+
+CXS::Logger::ptr g_logger = CXS_LOG_ROOT();
+
+void log_stats(const char *name) {
+    CXS::StackAllocator::Stats stats = CXS::StackAllocator::GetStats();
+    CXS_LOG_INFO(g_logger) << name
+                           << " alloc=" << stats.alloc_count
+                           << " reuse=" << stats.reuse_count
+                           << " pool=" << stats.pool_count
+                           << " release=" << stats.release_count
+                           << " pooled_bytes=" << stats.pooled_bytes;
+}
+
+// 单线程反复创建销毁协程，栈应全部来自空闲链表
+void test_reuse() {
+    CXS::Fiber::GetThis();
+    int count = 0;
+    uint64_t begin = CXS::GetCurrentMS();
+    for (int i = 0; i < 100000; ++i) {
+        CXS::Fiber::ptr fiber(new CXS::Fiber([&count]() { ++count; }, 0, true));
+        fiber->call();
+    }
+    CXS_ASSERT(count == 100000);
+    CXS_LOG_INFO(g_logger) << "create/destroy 100000 fibers used=" << (CXS::GetCurrentMS() - begin) << "ms";
+    log_stats("test_reuse");
+}
+
+// 多线程调度，协程栈可能在其他线程释放
+void test_scheduler() {
+    CXS::Scheduler sc(4, false, "stack");
+    sc.start();
+    for (int i = 0; i < 10000; ++i) {
+        sc.schedule([]() {
+            CXS::Fiber::YieldToReady();
+        });
+    }
+    sc.stop();
+    log_stats("test_scheduler");
+}
+
+int main(int argc, char const *argv[]) {
+    g_logger->setLevel(CXS::LogLevel::INFO);
+    CXS::LoggerMgr::GetInstance()->getLogger("system")->setLevel(CXS::LogLevel::INFO);
+    test_reuse();
+    test_scheduler();
+    log_stats("exit");
+    return 0;
+}
@@ -0,0 +1,170 @@
+#include "../http/http_connection.h"
+#include "../http/http_server.h"
+#include "../http/static_servlet.h"
+#include "../code/iomanager.h"
+#include "../code/log.h"
+#include "../code/macro.h"
+#include "../code/util.h"
+#include <fstream>
+#include <stdlib.h>
+#include <unistd.h>
+
+static CXS::Logger::ptr g_logger = CXS_LOG_ROOT();
+
+static const uint32_t PORT = 8098;
+static std::string s_root;
+static std::string s_small;
+static std::string s_large;
+
+void write_file(const std::string &name, const std::string &data) {
+    std::ofstream ofs(s_root + "/" + name, std::ios::binary);
+    ofs.write(data.c_str(), data.size());
+}
+
+CXS::http::HttpResult::ptr request(CXS::http::HttpConnectionPool::ptr pool, const std::string &path,
+                                   const std::map<std::string, std::string> &headers = {},
+                                   CXS::http::HttpMethod method = CXS::http::HttpMethod::GET) {
+    auto r = pool->doRequest(method, path, 5000, headers);
+    CXS_ASSERT(r->result == 0);
+    return r;
+}
+
+void test_basic(CXS::http::HttpConnectionPool::ptr pool) {
+    auto r = request(pool, "/static/small.txt");
+    CXS_ASSERT(r->response->getStatus() == CXS::http::HttpStatus::OK);
+    CXS_ASSERT(r->response->getBody() == s_small);
+    CXS_ASSERT(r->response->getHeader("content-type") == "text/plain; charset=utf-8");
+    CXS_ASSERT(!r->response->getHeader("etag").empty());
+
+    r = request(pool, "/static/small.txt", {}, CXS::http::HttpMethod::HEAD);
+    CXS_ASSERT(r->response->getBody().empty());
+    CXS_ASSERT(r->response->getHeader("content-length") == std::to_string(s_small.size()));
+
+    r = request(pool, "/static/");
+    CXS_ASSERT(r->response->getBody() == "<html>index</html>");
+    CXS_ASSERT(request(pool, "/static/none.txt")->response->getStatus() == CXS::http::HttpStatus::NOT_FOUND);
+    CXS_ASSERT(request(pool, "/static/../test_static_servlet.cc")->response->getStatus()
+               == CXS::http::HttpStatus::FORBIDDEN);
+    CXS_ASSERT(request(pool, "/static/small.txt", {}, CXS::http::HttpMethod::POST)->response->getStatus()
+               == CXS::http::HttpStatus::METHOD_NOT_ALLOWED);
+}
+
+void test_conditional(CXS::http::HttpConnectionPool::ptr pool) {
+    auto r = request(pool, "/static/small.txt");
+    std::string etag = r->response->getHeader("etag");
+    std::string last_modified = r->response->getHeader("last-modified");
+
+    r = request(pool, "/static/small.txt", {{"If-None-Match", "\"x\", " + etag}});
+    CXS_ASSERT(r->response->getStatus() == CXS::http::HttpStatus::NOT_MODIFIED);
+    CXS_ASSERT(r->response->getBody().empty());
+    r = request(pool, "/static/small.txt", {{"If-None-Match", "\"other\""}});
+    CXS_ASSERT(r->response->getStatus() == CXS::http::HttpStatus::OK);
+    r = request(pool, "/static/small.txt", {{"If-Modified-Since", last_modified}});
+    CXS_ASSERT(r->response->getStatus() == CXS::http::HttpStatus::NOT_MODIFIED);
+    r = request(pool, "/static/small.txt", {{"If-Modified-Since", "Thu, 01 Jan 1970 00:00:00 GMT"}});
+    CXS_ASSERT(r->response->getStatus() == CXS::http::HttpStatus::OK);
+}
+
+void test_range(CXS::http::HttpConnectionPool::ptr pool) {
+    auto r = request(pool, "/static/small.txt", {{"Range", "bytes=2-5"}});
+    CXS_ASSERT(r->response->getStatus() == CXS::http::HttpStatus::PARTIAL_CONTENT);
+    CXS_ASSERT(r->response->getBody() == s_small.substr(2, 4));
+    CXS_ASSERT(r->response->getHeader("content-range")
+               == "bytes 2-5/" + std::to_string(s_small.size()));
+
+    r = request(pool, "/static/small.txt", {{"Range", "bytes=-3"}});
+    CXS_ASSERT(r->response->getBody() == s_small.substr(s_small.size() - 3));
+    r = request(pool, "/static/small.txt", {{"Range", "bytes=10-"}});
+    CXS_ASSERT(r->response->getBody() == s_small.substr(10));
+    r = request(pool, "/static/small.txt", {{"Range", "bytes=1000-"}});
+    CXS_ASSERT(r->response->getStatus() == CXS::http::HttpStatus::RANGE_NOT_SATISFIABLE);
+    // 多个区间和If-Range不一致时返回整个文件
+    r = request(pool, "/static/small.txt", {{"Range", "bytes=0-1,4-5"}});
+    CXS_ASSERT(r->response->getStatus() == CXS::http::HttpStatus::OK);
+    r = request(pool, "/static/small.txt", {{"Range", "bytes=0-1"}, {"If-Range", "\"old\""}});
+    CXS_ASSERT(r->response->getBody() == s_small);
+
+    r = request(pool, "/static/large.bin", {{"Range", "bytes=1000000-1999999"}});
+    CXS_ASSERT(r->response->getBody() == s_large.substr(1000000, 1000000));
+}
+
+// 文件被替换后stat缓存过期，重新打开
+void test_modify(CXS::http::HttpConnectionPool::ptr pool) {
+    write_file("change.txt", "version 1");
+    CXS_ASSERT(request(pool, "/static/change.txt")->response->getBody() == "version 1");
+    std::string tmp = s_root + "/change.txt.tmp";
+    std::ofstream(tmp) << "version 2";
+    rename(tmp.c_str(), (s_root + "/change.txt").c_str());
+    usleep(1100 * 1000);
+    CXS_ASSERT(request(pool, "/static/change.txt")->response->getBody() == "version 2");
+}
+
+// sendfile与读入内存再发送的对比，大文件发送时socket写满，sendfile在hook中挂起等待可写
+void bench(CXS::http::HttpConnectionPool::ptr pool) {
+    for (auto path : {"/static/large.bin", "/memory/large.bin"}) {
+        const int count = 200;
+        uint64_t begin = CXS::GetCurrentUS();
+        for (int i = 0; i < count; ++i) {
+            auto r = request(pool, path);
+            CXS_ASSERT(r->response->getBody().size() == s_large.size());
+        }
+        uint64_t used = CXS::GetCurrentUS() - begin;
+        CXS_LOG_INFO(g_logger) << path << ": " << count * 1000000ull / used << " rsp/s "
+                               << (uint64_t)count * s_large.size() / used << " MB/s";
+    }
+}
+
+void run() {
+    char dir[] = "/tmp/test_static_XXXXXX";
+    CXS_ASSERT(mkdtemp(dir));
+    s_root = dir;
+    for (int i = 0; i < 26; ++i) {
+        s_small.push_back('a' + i);
+    }
+    s_large.resize(4 * 1024 * 1024);
+    for (size_t i = 0; i < s_large.size(); ++i) {
+        s_large[i] = (char)(i * 7 + i / 4096);
+    }
+    write_file("small.txt", s_small);
+    write_file("large.bin", s_large);
+    write_file("index.html", "<html>index</html>");
+
+    CXS::http::HttpServer::ptr server(new CXS::http::HttpServer(true));
+    CXS::Address::ptr addr = CXS::Address::LookupAny("127.0.0.1:" + std::to_string(PORT));
+    CXS_ASSERT(server->bind(addr));
+    server->setTimeout(2000);
+    CXS::http::StaticFileServlet::ptr servlet(new CXS::http::StaticFileServlet(s_root, "/static/"));
+    server->getServletDispatch()->addPrefixServlet("/static/", servlet);
+    server->getServletDispatch()->addPrefixServlet("/memory/", [](CXS::http::HttpRequest::ptr req,
+                                                                   CXS::http::HttpResponse::ptr rsp,
+                                                                   CXS::http::HttpSession::ptr session) {
+        std::ifstream ifs(s_root + "/" + req->getPath().substr(8), std::ios::binary);
+        std::string body((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+        rsp->setBody(body);
+        return 0;
+    });
+    server->start();
+
+    CXS::http::HttpConnectionPool::ptr pool(
+        new CXS::http::HttpConnectionPool("127.0.0.1", PORT, 4, 10000, 60000, 10000));
+    test_basic(pool);
+    test_conditional(pool);
+    test_range(pool);
+    test_modify(pool);
+    bench(pool);
+    CXS_LOG_INFO(g_logger) << "cache hits=" << servlet->getCache()->getHits()
+                           << " misses=" << servlet->getCache()->getMisses()
+                           << " size=" << servlet->getCache()->size();
+    CXS_LOG_INFO(g_logger) << "all passed";
+    servlet->getCache()->clear();
+    system(("rm -rf " + s_root).c_str());
+    server->stop();
+}
+
+int main(int argc, char **argv) {
+    g_logger->setLevel(CXS::LogLevel::INFO);
+    CXS::LoggerMgr::GetInstance()->getLogger("system")->setLevel(CXS::LogLevel::ERROR);
+    CXS::IOManager iom(2);
+    iom.schedule(run);
+    return 0;
+}
@@ -0,0 +1,157 @@
+#include "../code/log.h"
+#include "../code/macro.h"
+#include "../code/timer.h"
+#include "../code/util.h"
+#include <set>
+#include <stdlib.h>
+#include <unistd.h>
+
+CXS::Logger::ptr g_logger = CXS_LOG_ROOT();
+
+class TestTimerManager : public CXS::TimerManager {
+public:
+    void onTimerInsertedAtFront() override { ++tickles; }
+    int tickles = 0;
+};
+
+// 驱动时间轮直到没有定时器，相当于IOManager::idle的简化版
+void run_until_empty(TestTimerManager &mgr) {
+    std::vector<std::function<void()>> cbs;
+    while (true) {
+        uint64_t next = mgr.getNextTimer();
+        if (next == ~0ull) {
+            break;
+        }
+        if (next > 0) {
+            usleep(next * 1000);
+        }
+        cbs.clear();
+        mgr.listExpiredTimer(cbs);
+        for (auto &cb : cbs) {
+            cb();
+        }
+    }
+}
+
+// 随机定时器不早于到期时间触发，且延迟在几毫秒内
+void test_correctness() {
+    TestTimerManager mgr;
+    const int N = 2000;
+    int fired = 0;
+    uint64_t max_late = 0;
+    std::vector<CXS::Timer::ptr> timers;
+    for (int i = 0; i < N; ++i) {
+        uint64_t ms = 1 + rand() % 3000;
+        uint64_t expect = CXS::GetCurrentMS() + ms;
+        timers.push_back(mgr.addTimer(ms, [&fired, &max_late, expect]() {
+            uint64_t now = CXS::GetCurrentMS();
+            CXS_ASSERT(now >= expect);
+            max_late = std::max(max_late, now - expect);
+            ++fired;
+        }));
+    }
+    // 取消一半
+    int cancelled = 0;
+    for (int i = 0; i < N; i += 2) {
+        if (timers[i]->cancel()) {
+            ++cancelled;
+        }
+    }
+    int recurring = 0;
+    CXS::Timer::ptr timer;
+    timer = mgr.addTimer(300, [&recurring, &timer]() {
+        if (++recurring == 5) {
+            timer->cancel();
+        }
+    }, true);
+    run_until_empty(mgr);
+    CXS_ASSERT(fired + cancelled == N);
+    CXS_ASSERT(recurring == 5);
+    CXS_LOG_INFO(g_logger) << "fired=" << fired << " cancelled=" << cancelled
+                           << " recurring=" << recurring << " max_late=" << max_late << "ms"
+                           << " tickles=" << mgr.tickles;
+}
+
+// 原来基于std::set的实现，用于对比
+class SetTimerManager {
+public:
+    struct Timer {
+        typedef std::shared_ptr<Timer> ptr;
+        uint64_t next;
+        std::function<void()> cb;
+        struct Comparator {
+            bool operator()(const ptr &lhs, const ptr &rhs) const {
+                if (lhs->next != rhs->next) {
+                    return lhs->next < rhs->next;
+                }
+                return lhs.get() < rhs.get();
+            }
+        };
+    };
+
+    Timer::ptr addTimer(uint64_t ms, std::function<void()> cb) {
+        Timer::ptr timer(new Timer{CXS::GetCurrentMS() + ms, cb});
+        CXS::RWMutex::WriteLock lock(m_mutex);
+        m_timers.insert(timer);
+        return timer;
+    }
+    bool cancel(const Timer::ptr &timer) {
+        CXS::RWMutex::WriteLock lock(m_mutex);
+        return m_timers.erase(timer) > 0;
+    }
+
+private:
+    CXS::RWMutex m_mutex;
+    std::set<Timer::ptr, Timer::Comparator> m_timers;
+};
+
+// 大量定时器插入后全部取消，定时器超时时间在10分钟内随机分布
+void bench_insert_cancel() {
+    const int N = 200000;
+    std::vector<uint64_t> delays(N);
+    for (int i = 0; i < N; ++i) {
+        delays[i] = 1 + rand() % 600000;
+    }
+
+    {
+        TestTimerManager mgr;
+        std::vector<CXS::Timer::ptr> timers;
+        timers.reserve(N);
+        uint64_t begin = CXS::GetCurrentUS();
+        for (int i = 0; i < N; ++i) {
+            timers.push_back(mgr.addTimer(delays[i], []() {}));
+        }
+        uint64_t mid = CXS::GetCurrentUS();
+        for (int i = 0; i < N; ++i) {
+            timers[i]->cancel();
+        }
+        uint64_t end = CXS::GetCurrentUS();
+        CXS_LOG_INFO(g_logger) << "wheel: insert " << (mid - begin) * 1000 / N << "ns/op"
+                               << " cancel " << (end - mid) * 1000 / N << "ns/op";
+    }
+
+    {
+        SetTimerManager mgr;
+        std::vector<SetTimerManager::Timer::ptr> timers;
+        timers.reserve(N);
+        uint64_t begin = CXS::GetCurrentUS();
+        for (int i = 0; i < N; ++i) {
+            timers.push_back(mgr.addTimer(delays[i], []() {}));
+        }
+        uint64_t mid = CXS::GetCurrentUS();
+        for (int i = 0; i < N; ++i) {
+            mgr.cancel(timers[i]);
+        }
+        uint64_t end = CXS::GetCurrentUS();
+        CXS_LOG_INFO(g_logger) << "set:   insert " << (mid - begin) * 1000 / N << "ns/op"
+                               << " cancel " << (end - mid) * 1000 / N << "ns/op";
+    }
+}
+
+int main(int argc, char const *argv[]) {
+    g_logger->setLevel(CXS::LogLevel::INFO);
+    srand(time(0));
+    test_correctness();
+    bench_insert_cancel();
+    return 0;
+}